@@ -0,0 +1,77 @@
+// Measures random registry::get<C>(entity) lookups, which go through the entity location table.
+//
+// Build and run with `make benchmarks && ./bin/benchmarks/entity_lookup_bench [entities]`.
+
+#include <nvkg/ecs/ecs.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+    constexpr int rounds = 50;
+
+    struct position {
+        float x, y, z;
+    };
+
+    struct velocity {
+        float x, y, z;
+    };
+
+    template<typename F>
+    double measure_ns(std::size_t lookups, F&& round) {
+        round(); // warm up
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++) {
+            round();
+        }
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / (static_cast<double>(rounds) * lookups);
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+
+    ecs::registry registry;
+    std::vector<ecs::entity> entities;
+    entities.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        // two archetypes, so lookups don't all land in the same chunks
+        if (i % 2 == 0) {
+            entities.push_back(registry.create<position>({ float(i), 0.0f, 0.0f }));
+        } else {
+            entities.push_back(registry.create<position, velocity>({ float(i), 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }));
+        }
+    }
+
+    std::vector<ecs::entity> sequential = entities;
+    std::vector<ecs::entity> shuffled = entities;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937{ 42 });
+
+    const ecs::registry& const_registry = registry;
+    float sink = 0.0f;
+    const auto lookup = [&](const std::vector<ecs::entity>& order) {
+        return measure_ns(order.size(), [&] {
+            for (const auto& ent : order) {
+                sink += const_registry.get<position>(ent).x;
+            }
+        });
+    };
+
+    const double in_order = lookup(sequential);
+    const double random = lookup(shuffled);
+
+    std::printf("entities: %zu, rounds: %d, time per get<position> in ns\n\n", count, rounds);
+    std::printf("%12s %12s\n", "in order", "random");
+    std::printf("%12.2f %12.2f\n", in_order, random);
+
+    return sink == 0.0f ? 1 : 0;
+}
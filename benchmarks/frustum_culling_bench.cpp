@@ -0,0 +1,121 @@
+// Measures CPU frustum culling of entities with world_bounds: the scalar and SIMD sphere tests over chunk columns and
+// nvkg::frustum_culler on one and on all threads. Spheres are scattered around the camera, roughly a tenth of them
+// ends up visible.
+//
+// Build and run with `make benchmarks && ./bin/benchmarks/frustum_culling_bench [threads]`.
+
+#include <nvkg/Components/culling.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    constexpr int frames = 50;
+
+    template<typename F>
+    double measure(F&& frame) {
+        frame(); // warm up
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            frame();
+        }
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count() / frames;
+    }
+
+    template<typename Cull>
+    std::size_t cull_columns(const ecs::registry& registry, std::vector<std::uint32_t>& indices, Cull&& cull) {
+        std::size_t visible = 0;
+        registry.view<const nvkg::world_bounds&>().each_chunk(
+            [&](std::span<const ecs::entity>, std::span<const nvkg::world_bounds> bounds) {
+                visible += cull(bounds, indices.data());
+            });
+        return visible;
+    }
+
+    // The SIMD path has to find exactly the spheres the scalar reference finds, in the same order
+    bool simd_matches_scalar(const ecs::registry& registry, const nvkg::frustum& planes) {
+        bool matches = true;
+        std::vector<std::uint32_t> scalar, simd;
+        registry.view<const nvkg::world_bounds&>().each_chunk(
+            [&](std::span<const ecs::entity>, std::span<const nvkg::world_bounds> bounds) {
+                scalar.resize(bounds.size());
+                simd.resize(bounds.size());
+                const auto scalar_count = nvkg::cull_spheres_scalar(planes, bounds, scalar.data());
+                const auto simd_count = nvkg::cull_spheres(planes, bounds, simd.data());
+                matches = matches && scalar_count == simd_count
+                    && std::equal(scalar.begin(), scalar.begin() + scalar_count, simd.begin());
+            });
+        return matches;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const std::size_t threads = argc > 1
+        ? std::max<std::size_t>(1, std::strtoul(argv[1], nullptr, 10))
+        : std::max(2u, std::thread::hardware_concurrency());
+
+    nvkg::task_scheduler scheduler(threads - 1);
+
+    const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const auto planes = nvkg::frustum::from_view_projection(projection * view);
+
+    std::printf("threads: %zu, frames: %d, entities culled per ms\n\n", threads, frames);
+    std::printf("%8s %8s %14s %14s %14s %14s\n", "entities", "visible", "scalar", "simd", "culler 1 thr", "culler all");
+
+    for (std::size_t count : {10000, 100000, 1000000}) {
+        ecs::registry registry;
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+        for (std::size_t i = 0; i < count; i++) {
+            registry.create<nvkg::world_bounds>({{position(rng), position(rng), position(rng)}, radius(rng)});
+        }
+
+        if (!simd_matches_scalar(registry, planes)) {
+            std::printf("mismatch: SIMD and scalar culling disagree on %zu entities\n", count);
+            return 1;
+        }
+
+        std::vector<std::uint32_t> indices(count);
+        std::size_t visible = 0;
+        nvkg::frustum_culler culler;
+
+        const double scalar = measure([&] {
+            visible = cull_columns(registry, indices, [&planes](std::span<const nvkg::world_bounds> bounds, std::uint32_t* out) {
+                return nvkg::cull_spheres_scalar(planes, bounds, out);
+            });
+        });
+
+        const double simd = measure([&] {
+            visible = cull_columns(registry, indices, [&planes](std::span<const nvkg::world_bounds> bounds, std::uint32_t* out) {
+                return nvkg::cull_spheres(planes, bounds, out);
+            });
+        });
+
+        const double culler_single = measure([&] { culler.cull(registry, planes); });
+        const double culler_all = measure([&] { culler.cull(registry, planes, &scheduler); });
+
+        if (culler.visible().size() != visible) {
+            std::printf("mismatch: culler found %zu visible entities, columns %zu\n", culler.visible().size(), visible);
+            return 1;
+        }
+
+        const auto per_ms = [count](double ms) { return static_cast<double>(count) / ms; };
+        std::printf("%8zu %8zu %14.0f %14.0f %14.0f %14.0f\n", count, visible,
+            per_ms(scalar), per_ms(simd), per_ms(culler_single), per_ms(culler_all));
+    }
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Compares nvkg::task_scheduler against BS::thread_pool for fine grained per-frame work.
+//
+// Build and run with `make benchmarks && ./bin/benchmarks/task_scheduler_bench [threads]`.
+
+#include <nvkg/Utils/task_scheduler.hpp>
+#include <nvkg/Utils/threadpool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    constexpr int frames = 50;
+
+    // A few hundred nanoseconds of work, roughly one ECS chunk or one small draw
+    inline void work(std::vector<std::uint64_t>& out, std::size_t i) {
+        std::uint64_t x = i + 1;
+        for (int k = 0; k < 64; k++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+        }
+        out[i] = x;
+    }
+
+    template<typename F>
+    double measure(F&& frame) {
+        frame(); // warm up
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            frame();
+        }
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::micro>(end - start).count() / frames;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const std::size_t threads = argc > 1
+        ? std::max<std::size_t>(1, std::strtoul(argv[1], nullptr, 10))
+        : std::max(2u, std::thread::hardware_concurrency());
+
+    // The scheduler caller helps executing tasks, give both the same number of threads doing work
+    BS::thread_pool pool(static_cast<BS::concurrency_t>(threads));
+    nvkg::task_scheduler scheduler(threads - 1);
+
+    std::printf("threads: %zu, frames: %d, time per frame in us\n\n", threads, frames);
+    std::printf("%8s %16s %16s %16s %16s\n", "tasks", "bs push_task", "bs parallelize", "ts task_group", "ts parallel_for");
+
+    for (std::size_t count : {1000, 10000, 100000}) {
+        std::vector<std::uint64_t> out(count);
+
+        const double bs_push = measure([&] {
+            for (std::size_t i = 0; i < count; i++) {
+                pool.push_task([&out, i] { work(out, i); });
+            }
+            pool.wait_for_tasks();
+        });
+
+        const double bs_loop = measure([&] {
+            pool.parallelize_loop(std::size_t{0}, count, [&out](std::size_t first, std::size_t last) {
+                for (auto i = first; i < last; i++) work(out, i);
+            }, count).wait();
+        });
+
+        nvkg::task_scheduler::task_group group(scheduler);
+        const double ts_group = measure([&] {
+            for (std::size_t i = 0; i < count; i++) {
+                group.run([&out, i] { work(out, i); });
+            }
+            group.wait();
+        });
+
+        const double ts_loop = measure([&] {
+            scheduler.parallel_for(0, count, [&out](std::size_t first, std::size_t last) {
+                for (auto i = first; i < last; i++) work(out, i);
+            }, 1);
+        });
+
+        std::printf("%8zu %16.1f %16.1f %16.1f %16.1f\n", count, bs_push, bs_loop, ts_group, ts_loop);
+    }
+
+    return 0;
+}
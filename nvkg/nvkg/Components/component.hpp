@@ -8,6 +8,8 @@
 #include <nvkg/Renderer/Core.hpp>
 #include <nvkg/Renderer/Model/Model.hpp>
 #include <nvkg/Components/sdf_text.hpp>
+#include <nvkg/Components/culling.hpp>
+#include <nvkg/Components/transform.hpp>
 
 namespace nvkg {
     /*
@@ -19,12 +21,6 @@ namespace nvkg {
         material_handle material_;
     };
 
-    struct transform_3d {
-        glm::vec3 position_;
-        glm::vec3 scale_;
-        glm::vec3 rotation_;
-    };
-
     struct transform_2d {
         glm::vec2 position_;
         glm::vec2 scale_;
@@ -53,7 +49,6 @@ namespace nvkg {
     struct instance_data {
         std::vector<transform_3d> instance_data_;
         uint32_t instance_count_;
-        staged_buffer instance_data_buffer_{VK_BUFFER_USAGE_VERTEX_BUFFER_BIT};
     };
 }
 
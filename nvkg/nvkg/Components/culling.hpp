@@ -0,0 +1,370 @@
+#ifndef NVKG_CULLING_HPP
+#define NVKG_CULLING_HPP
+
+#include <nvkg/Renderer/Utils/Math.hpp>
+#include <nvkg/Utils/task_scheduler.hpp>
+#include <nvkg/ecs/ecs.hpp>
+#include <nvkg/ecs/detail/paged_table.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#if defined __SSE2__ || defined _M_X64
+#include <emmintrin.h>
+#define NVKG_CULLING_SSE
+#elif defined __ARM_NEON && defined __aarch64__
+#include <arm_neon.h>
+#define NVKG_CULLING_NEON
+#endif
+
+namespace nvkg {
+
+    struct world_bounds { // bounding sphere in world space, a negative radius is never culled, see frustum_culler
+        glm::vec3 center_{0.0f};
+        float radius_{-1.0f};
+    };
+
+    static_assert(sizeof(world_bounds) == 4 * sizeof(float), "culling loads every sphere into one SIMD register");
+
+    /**
+     * @brief View frustum in structure of arrays layout, plane i is (x_[i], y_[i], z_[i], w_[i]) with the normal
+     * pointing inwards. A default constructed frustum culls nothing.
+     **/
+    struct frustum {
+        std::array<float, 6> x_{}, y_{}, z_{}, w_{};
+
+        frustum() = default;
+
+        explicit frustum(const std::array<glm::vec4, 6>& planes) {
+            for (std::size_t p = 0; p < planes.size(); p++) {
+                x_[p] = planes[p].x;
+                y_[p] = planes[p].y;
+                z_[p] = planes[p].z;
+                w_[p] = planes[p].w;
+            }
+        }
+
+        /**
+         * @brief Extracts the frustum of projection * view, e.g. of CameraNew::matrices.
+         **/
+        static frustum from_view_projection(const glm::mat4& view_projection) {
+            return frustum(Utils::Math::frustum_planes(view_projection));
+        }
+
+        bool contains(const world_bounds& sphere) const {
+            if (sphere.radius_ < 0.0f) {
+                return true;
+            }
+            for (std::size_t p = 0; p < x_.size(); p++) {
+                const auto distance = x_[p] * sphere.center_.x + y_[p] * sphere.center_.y + z_[p] * sphere.center_.z + w_[p];
+                if (distance < -sphere.radius_) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    /**
+     * @brief Returns the world space sphere of an instance drawn by instancing.vert, which scales, then translates.
+     * Same math as indirect_cull.comp.
+     **/
+    inline world_bounds instance_bounds(const bounding_sphere& sphere, const glm::vec3& position, const glm::vec3& scale) {
+        if (sphere.radius_ < 0.0f) {
+            return {};
+        }
+        const glm::vec3 s = glm::abs(scale);
+        return { sphere.center_ * scale + position, sphere.radius_ * std::max(s.x, std::max(s.y, s.z)) };
+    }
+
+    /**
+     * @brief Returns a sphere enclosing both spheres, unbounded if either of them is.
+     **/
+    inline world_bounds merge_bounds(const world_bounds& a, const world_bounds& b) {
+        if (a.radius_ < 0.0f || b.radius_ < 0.0f) {
+            return {};
+        }
+        const float distance = glm::length(b.center_ - a.center_);
+        if (distance + b.radius_ <= a.radius_) {
+            return a;
+        }
+        if (distance + a.radius_ <= b.radius_) {
+            return b;
+        }
+        const float radius = (distance + a.radius_ + b.radius_) * 0.5f;
+        return { a.center_ + (b.center_ - a.center_) * ((radius - a.radius_) / distance), radius };
+    }
+
+    /**
+     * @brief Tests spheres against a frustum one at a time. Reference for cull_spheres().
+     **/
+    inline std::size_t cull_spheres_scalar(const frustum& planes, std::span<const world_bounds> spheres, std::uint32_t* visible) {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < spheres.size(); i++) {
+            visible[count] = static_cast<std::uint32_t>(i);
+            count += planes.contains(spheres[i]);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Tests spheres against a frustum, four at a time with SSE2 or NEON. Four consecutive spheres are loaded as
+     * four registers and transposed into x, y, z and radius registers, so every plane test handles four spheres and
+     * the visible indices are appended without branches.
+     *
+     * @param planes - frustum to test against.
+     * @param spheres - spheres to test, a negative radius is always visible.
+     * @param visible - receives the indices of visible spheres in order, needs room for spheres.size() indices.
+     * @returns the number of visible spheres.
+     **/
+    inline std::size_t cull_spheres(const frustum& planes, std::span<const world_bounds> spheres, std::uint32_t* visible) {
+        std::size_t count = 0;
+        std::size_t i = 0;
+
+#if defined NVKG_CULLING_SSE || defined NVKG_CULLING_NEON
+        const float* data = reinterpret_cast<const float*>(spheres.data());
+        const auto append = [&count, visible](std::size_t first, unsigned mask) {
+            for (unsigned lane = 0; lane < 4; lane++) {
+                visible[count] = static_cast<std::uint32_t>(first + lane);
+                count += (mask >> lane) & 1u;
+            }
+        };
+#endif
+
+#if defined NVKG_CULLING_SSE
+        __m128 px[6], py[6], pz[6], pw[6];
+        for (std::size_t p = 0; p < 6; p++) {
+            px[p] = _mm_set1_ps(planes.x_[p]);
+            py[p] = _mm_set1_ps(planes.y_[p]);
+            pz[p] = _mm_set1_ps(planes.z_[p]);
+            pw[p] = _mm_set1_ps(planes.w_[p]);
+        }
+        const __m128 zero = _mm_setzero_ps();
+
+        for (; i + 4 <= spheres.size(); i += 4) {
+            __m128 x = _mm_loadu_ps(data + 4 * i);
+            __m128 y = _mm_loadu_ps(data + 4 * i + 4);
+            __m128 z = _mm_loadu_ps(data + 4 * i + 8);
+            __m128 r = _mm_loadu_ps(data + 4 * i + 12);
+            _MM_TRANSPOSE4_PS(x, y, z, r);
+
+            const __m128 negative_radius = _mm_sub_ps(zero, r);
+            __m128 in_all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (std::size_t p = 0; p < 6; p++) {
+                const __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+                    _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+                in_all = _mm_and_ps(in_all, _mm_cmpge_ps(distance, negative_radius));
+            }
+            const __m128 inside = _mm_or_ps(_mm_cmplt_ps(r, zero), in_all);
+
+            append(i, static_cast<unsigned>(_mm_movemask_ps(inside)));
+        }
+#elif defined NVKG_CULLING_NEON
+        float32x4_t px[6], py[6], pz[6], pw[6];
+        for (std::size_t p = 0; p < 6; p++) {
+            px[p] = vdupq_n_f32(planes.x_[p]);
+            py[p] = vdupq_n_f32(planes.y_[p]);
+            pz[p] = vdupq_n_f32(planes.z_[p]);
+            pw[p] = vdupq_n_f32(planes.w_[p]);
+        }
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const uint32x4_t lane_bits = {1u, 2u, 4u, 8u};
+
+        for (; i + 4 <= spheres.size(); i += 4) {
+            // deinterleaves into x, y, z and radius of four spheres
+            const float32x4x4_t s = vld4q_f32(data + 4 * i);
+
+            const float32x4_t negative_radius = vnegq_f32(s.val[3]);
+            uint32x4_t in_all = vdupq_n_u32(~0u);
+            for (std::size_t p = 0; p < 6; p++) {
+                const float32x4_t distance = vfmaq_f32(vfmaq_f32(vfmaq_f32(pw[p], px[p], s.val[0]), py[p], s.val[1]), pz[p], s.val[2]);
+                in_all = vandq_u32(in_all, vcgeq_f32(distance, negative_radius));
+            }
+            const uint32x4_t inside = vorrq_u32(vcltq_f32(s.val[3], zero), in_all);
+
+            append(i, vaddvq_u32(vandq_u32(inside, lane_bits)));
+        }
+#endif
+
+        for (; i < spheres.size(); i++) {
+            visible[count] = static_cast<std::uint32_t>(i);
+            count += planes.contains(spheres[i]);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Frustum culling of entities with world_bounds and of instance transforms.
+     *
+     * cull() runs cull_spheres() over the world_bounds column of every matching chunk, chunks are distributed across
+     * the task scheduler and write the visible indices into their own slice of a shared index array, which is
+     * compacted into the visible entity list afterwards. cull_instances() does the same for blocks of instances.
+     * Buffers are kept between calls, so culling does not allocate once they are large enough.
+     *
+     * Usage:
+     *
+     *      const auto planes = nvkg::frustum::from_view_projection(camera.matrices.perspective * camera.matrices.view);
+     *      culler.cull(registry, planes, scheduler);
+     *      for (auto entity : culler.visible()) { ... }
+     **/
+    class frustum_culler {
+        public:
+
+        /**
+         * Number of instances culled by one task of cull_instances().
+         **/
+        static constexpr std::size_t instance_block = 1024;
+
+        /**
+         * @brief Culls all entities with world_bounds.
+         *
+         * @param registry - registry owning the entities.
+         * @param planes - frustum to cull against.
+         * @param scheduler - scheduler to spread chunks across, nullptr culls on the calling thread.
+         **/
+        void cull(const ecs::registry& registry, const frustum& planes, task_scheduler* scheduler = nullptr) {
+            chunks_.clear();
+            std::size_t total = 0;
+            registry.view<const world_bounds&>().each_chunk(
+                [this, &total](std::span<const ecs::entity> entities, std::span<const world_bounds> bounds) {
+                    chunks_.push_back({entities, bounds, total, 0});
+                    total += bounds.size();
+                });
+
+            indices_.resize(total);
+            const auto cull_chunks = [this, &planes](std::size_t first, std::size_t last) {
+                for (auto c = first; c < last; c++) {
+                    auto& chunk = chunks_[c];
+                    chunk.visible_ = cull_spheres(planes, chunk.bounds_, indices_.data() + chunk.offset_);
+                }
+            };
+            if (scheduler != nullptr && chunks_.size() > 1) {
+                scheduler->parallel_for(0, chunks_.size(), cull_chunks, 1);
+            } else {
+                cull_chunks(0, chunks_.size());
+            }
+
+            pass_++;
+            visible_.clear();
+            for (const auto& chunk : chunks_) {
+                for (std::size_t i = 0; i < chunk.visible_; i++) {
+                    const auto entity = chunk.entities_[indices_[chunk.offset_ + i]];
+                    visible_.push_back(entity);
+                    visible_pass_.ensure(entity.id()) = pass_;
+                }
+            }
+            tested_ = total;
+        }
+
+        /**
+         * @brief Returns the entities that passed the last cull(), in chunk order.
+         **/
+        std::span<const ecs::entity> visible() const { return visible_; }
+
+        /**
+         * @brief Returns true if entity passed the last cull(). Entities without world_bounds were not tested and
+         * never pass.
+         **/
+        bool is_visible(ecs::entity entity) const {
+            return visible_pass_.contains(entity.id()) && visible_pass_[entity.id()] == pass_;
+        }
+
+        /**
+         * @brief Returns the number of entities tested by the last cull().
+         **/
+        std::size_t tested() const { return tested_; }
+
+        /**
+         * @brief Culls instances of a model, every instance needs position_ and scale_ members like transform_3d.
+         *
+         * @param planes - frustum to cull against.
+         * @param model - model space bounds of the instanced model.
+         * @param instances - instances to cull.
+         * @param scheduler - scheduler to spread blocks of instance_block instances across, nullptr culls on the
+         * calling thread.
+         * @returns ascending indices of the visible instances, valid until the next call.
+         **/
+        template<typename Instance>
+        std::span<const std::uint32_t> cull_instances(const frustum& planes, const bounding_sphere& model,
+            std::span<const Instance> instances, task_scheduler* scheduler = nullptr) {
+            const std::size_t blocks = (instances.size() + instance_block - 1) / instance_block;
+            spheres_.resize(instances.size());
+            instance_indices_.resize(instances.size());
+            block_visible_.resize(blocks);
+
+            const auto cull_blocks = [&](std::size_t first, std::size_t last) {
+                for (auto b = first; b < last; b++) {
+                    const auto begin = b * instance_block;
+                    const auto end = std::min(instances.size(), begin + instance_block);
+                    for (auto i = begin; i < end; i++) {
+                        spheres_[i] = instance_bounds(model, instances[i].position_, instances[i].scale_);
+                    }
+
+                    const auto count = cull_spheres(planes, std::span(spheres_).subspan(begin, end - begin), instance_indices_.data() + begin);
+                    for (std::size_t i = 0; i < count; i++) {
+                        instance_indices_[begin + i] += static_cast<std::uint32_t>(begin);
+                    }
+                    block_visible_[b] = count;
+                }
+            };
+            if (scheduler != nullptr && blocks > 1) {
+                scheduler->parallel_for(0, blocks, cull_blocks, 1);
+            } else {
+                cull_blocks(0, blocks);
+            }
+
+            // blocks only move towards the front, so copying forward is safe
+            std::size_t count = 0;
+            for (std::size_t b = 0; b < blocks; b++) {
+                const auto first = instance_indices_.begin() + static_cast<std::ptrdiff_t>(b * instance_block);
+                std::copy(first, first + static_cast<std::ptrdiff_t>(block_visible_[b]), instance_indices_.begin() + static_cast<std::ptrdiff_t>(count));
+                count += block_visible_[b];
+            }
+            return std::span<const std::uint32_t>(instance_indices_.data(), count);
+        }
+
+        private:
+
+        struct chunk_range {
+            std::span<const ecs::entity> entities_;
+            std::span<const world_bounds> bounds_;
+            std::size_t offset_;  // first index of the chunk's slice of indices_
+            std::size_t visible_; // visible indices written to the slice
+        };
+
+        std::vector<chunk_range> chunks_;
+        std::vector<std::uint32_t> indices_;
+        std::vector<ecs::entity> visible_;
+
+        // pass_ of the last cull() an entity passed, indexed by entity ID
+        ecs::detail::paged_table<std::uint32_t> visible_pass_;
+        std::uint32_t pass_{0};
+        std::size_t tested_{0};
+
+        std::vector<world_bounds> spheres_;
+        std::vector<std::uint32_t> instance_indices_;
+        std::vector<std::size_t> block_visible_;
+    };
+
+    /**
+     * @brief Returns a sphere enclosing all instances of a model, see instance_bounds().
+     **/
+    template<typename Instance>
+    world_bounds enclosing_bounds(const bounding_sphere& model, std::span<const Instance> instances) {
+        if (instances.empty() || model.radius_ < 0.0f) {
+            return {};
+        }
+        auto bounds = instance_bounds(model, instances[0].position_, instances[0].scale_);
+        for (std::size_t i = 1; i < instances.size(); i++) {
+            bounds = merge_bounds(bounds, instance_bounds(model, instances[i].position_, instances[i].scale_));
+        }
+        return bounds;
+    }
+}
+
+#endif
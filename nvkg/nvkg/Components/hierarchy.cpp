@@ -0,0 +1,223 @@
+#include <nvkg/Components/hierarchy.hpp>
+#include <nvkg/Renderer/Core.hpp>
+#include <nvkg/Renderer/Utils/Math.hpp>
+
+#include <algorithm>
+
+namespace nvkg {
+
+    void transform_hierarchy::set_parent(ecs::registry& registry, ecs::entity child, ecs::entity parent_entity) {
+        NVKG_ASSERT(child != parent_entity, "An entity can't be its own parent!");
+
+        // walk up from the new parent, reaching child would close a cycle. A chain without cycles has at most one step
+        // per parent component, the bound stops the walk on a cycle set up through the registry, which rebuild() skips
+        auto steps = registry.view<const parent&>().count();
+        for (auto ancestor = parent_entity; steps > 0 && registry.alive(ancestor) && registry.has<parent>(ancestor); ancestor = registry.get<parent>(ancestor).entity_, steps--) {
+            NVKG_ASSERT(registry.get<parent>(ancestor).entity_ != child, "Parent relation would form a cycle!");
+        }
+
+        registry.set<parent>(child, parent{parent_entity});
+        structure_dirty_ = true;
+    }
+
+    void transform_hierarchy::clear_parent(ecs::registry& registry, ecs::entity child) {
+        registry.remove<parent>(child);
+        structure_dirty_ = true;
+    }
+
+    void transform_hierarchy::update(ecs::registry& registry, task_scheduler* scheduler) {
+        // entities joining or leaving the hierarchy change the member count, parent components set through the
+        // registry mark their chunks changed
+        const auto members = registry.view<const transform_3d&, const world_transform&>().count();
+        const auto parents_changed = registry.view<const parent&>().changed_since(last_tick_).count() > 0;
+
+        if (structure_dirty_ || members != member_count_ || parents_changed || !gather_changed(registry)) {
+            rebuild(registry);
+        }
+
+        propagate(scheduler);
+        write_back(registry);
+
+        // accept changes stamped with the current tick next time, they may happen after this update
+        last_tick_ = registry.tick() - 1;
+    }
+
+    void transform_hierarchy::rebuild(ecs::registry& registry) {
+        index_.clear();
+
+        // collect members in chunk order
+        std::vector<ecs::entity> members;
+        std::vector<glm::mat4> locals;
+        registry.view<const transform_3d&, const world_transform&>().each_chunk(
+            [&](std::span<const ecs::entity> entities, std::span<const transform_3d> transforms, std::span<const world_transform>) {
+                for (std::size_t i = 0; i < entities.size(); i++) {
+                    members.push_back(entities[i]);
+                    locals.push_back(Utils::Math::calc_transform_3d(transforms[i].position_, transforms[i].rotation_, transforms[i].scale_));
+                    index_.ensure(entities[i].id()) = static_cast<std::uint32_t>(members.size());
+                }
+            });
+
+        const auto member_index = [&](ecs::entity ent) -> std::uint32_t {
+            if (!index_.contains(ent.id()) || index_[ent.id()] == 0 || members[index_[ent.id()] - 1] != ent) {
+                return no_parent;
+            }
+            return index_[ent.id()] - 1;
+        };
+
+        // members whose parent is not a member (e.g. destroyed) are treated as roots
+        std::vector<std::uint32_t> parent_of(members.size(), no_parent);
+        registry.view<const parent&>().each_chunk(
+            [&](std::span<const ecs::entity> entities, std::span<const parent> parents) {
+                for (std::size_t i = 0; i < entities.size(); i++) {
+                    const auto child = member_index(entities[i]);
+                    if (child != no_parent) {
+                        parent_of[child] = member_index(parents[i].entity_);
+                    }
+                }
+            });
+
+        // children of every member, grouped by a counting sort
+        std::vector<std::uint32_t> child_offsets(members.size() + 1, 0);
+        for (auto p : parent_of) {
+            if (p != no_parent) {
+                child_offsets[p + 1]++;
+            }
+        }
+        for (std::size_t i = 1; i < child_offsets.size(); i++) {
+            child_offsets[i] += child_offsets[i - 1];
+        }
+        std::vector<std::uint32_t> children(child_offsets.back());
+        {
+            auto cursor = child_offsets;
+            for (std::uint32_t i = 0; i < parent_of.size(); i++) {
+                if (parent_of[i] != no_parent) {
+                    children[cursor[parent_of[i]]++] = i;
+                }
+            }
+        }
+
+        // breadth first order, every level follows the previous one
+        std::vector<std::uint32_t> order;
+        std::vector<std::uint32_t> node_of(members.size(), no_parent);
+        order.reserve(members.size());
+        level_offsets_.assign(1, 0);
+        for (std::uint32_t i = 0; i < parent_of.size(); i++) {
+            if (parent_of[i] == no_parent) {
+                node_of[i] = static_cast<std::uint32_t>(order.size());
+                order.push_back(i);
+            }
+        }
+        while (level_offsets_.back() != order.size()) {
+            const auto first = level_offsets_.back();
+            const auto last = static_cast<std::uint32_t>(order.size());
+            level_offsets_.push_back(last);
+            for (auto n = first; n < last; n++) {
+                for (auto c = child_offsets[order[n]]; c < child_offsets[order[n] + 1]; c++) {
+                    node_of[children[c]] = static_cast<std::uint32_t>(order.size());
+                    order.push_back(children[c]);
+                }
+            }
+        }
+
+        if (order.size() != members.size()) {
+            logger::debug(logger::Level::Warning) << "Transform hierarchy contains a cycle, " << members.size() - order.size() << " entities are skipped";
+        }
+
+        entities_.resize(order.size());
+        parents_.resize(order.size());
+        local_.resize(order.size());
+        world_.resize(order.size());
+        dirty_.assign(order.size(), 1);
+        index_.clear();
+        for (std::size_t n = 0; n < order.size(); n++) {
+            const auto m = order[n];
+            entities_[n] = members[m];
+            parents_[n] = parent_of[m] == no_parent ? no_parent : node_of[parent_of[m]];
+            local_[n] = locals[m];
+            index_.ensure(members[m].id()) = static_cast<std::uint32_t>(n + 1);
+        }
+
+        member_count_ = members.size();
+        structure_dirty_ = false;
+    }
+
+    bool transform_hierarchy::gather_changed(ecs::registry& registry) {
+        bool known = true;
+        registry.view<const transform_3d&>().changed_since(last_tick_).each_chunk(
+            [&](std::span<const ecs::entity> entities, std::span<const transform_3d> transforms) {
+                for (std::size_t i = 0; i < entities.size() && known; i++) {
+                    const auto id = entities[i].id();
+                    if (!index_.contains(id) || index_[id] == 0) {
+                        // a new member that replaced a destroyed one without changing the member count
+                        known = !registry.has<world_transform>(entities[i]);
+                        continue;
+                    }
+                    const auto n = index_[id] - 1;
+                    if (entities_[n] != entities[i]) {
+                        known = false;
+                        continue;
+                    }
+                    local_[n] = Utils::Math::calc_transform_3d(transforms[i].position_, transforms[i].rotation_, transforms[i].scale_);
+                    dirty_[n] = 1;
+                }
+            });
+        return known;
+    }
+
+    void transform_hierarchy::propagate(task_scheduler* scheduler) {
+        const auto propagate_range = [this](std::size_t first, std::size_t last) {
+            for (auto n = first; n < last; n++) {
+                const auto p = parents_[n];
+                if (p == no_parent) {
+                    if (dirty_[n]) {
+                        world_[n] = local_[n];
+                    }
+                } else if (dirty_[n] |= dirty_[p]) {
+                    world_[n] = world_[p] * local_[n];
+                }
+            }
+        };
+
+        // parents live in the previous level, so the nodes of a level are independent of each other
+        for (std::size_t level = 0; level < depth(); level++) {
+            const std::size_t first = level_offsets_[level];
+            const std::size_t last = level_offsets_[level + 1];
+            if (scheduler != nullptr && last - first > propagate_grain) {
+                scheduler->parallel_for(first, last, propagate_range, propagate_grain);
+            } else {
+                propagate_range(first, last);
+            }
+        }
+    }
+
+    void transform_hierarchy::write_back(ecs::registry& registry) {
+        if (std::none_of(dirty_.begin(), dirty_.end(), [](std::uint8_t d) { return d != 0; })) {
+            return;
+        }
+
+        // mutable access stamps the chunk it reaches as changed, so chunks are scanned through a const view and only
+        // dirty nodes are written through registry.get, which leaves chunks without dirty nodes unstamped. Walking in
+        // chunk order keeps the lookups sequential
+        registry.view<const transform_3d&, const world_transform&>().each_chunk(
+            [&](std::span<const ecs::entity> entities, std::span<const transform_3d>, std::span<const world_transform>) {
+                for (std::size_t i = 0; i < entities.size(); i++) {
+                    const auto id = entities[i].id();
+                    if (!index_.contains(id) || index_[id] == 0) {
+                        continue; // skipped as part of a cycle
+                    }
+                    const auto n = index_[id] - 1;
+                    if (dirty_[n]) {
+                        registry.get<world_transform>(entities[i]).matrix_ = world_[n];
+                    }
+                }
+            });
+
+        std::fill(dirty_.begin(), dirty_.end(), 0);
+    }
+
+    transform_3d to_world(const world_transform& world, const transform_3d& local) {
+        const auto& m = world.matrix_;
+        const glm::vec3 scale(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+        return { glm::vec3(m * glm::vec4(local.position_, 1.0f)), local.scale_ * scale, local.rotation_ };
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef NVKG_HIERARCHY_HPP
+#define NVKG_HIERARCHY_HPP
+
+#include <nvkg/Components/transform.hpp>
+#include <nvkg/Utils/task_scheduler.hpp>
+#include <nvkg/ecs/detail/paged_table.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace nvkg {
+
+    /**
+     * @brief Parent/child relationships between entities with transform_3d and world_transform components.
+     *
+     * Relationships are stored as parent components on the children, the hierarchy keeps a flattened copy of them
+     * sorted breadth first: roots first, then all children of roots, then their children and so on. Every depth level
+     * is a contiguous range of the node arrays and a node's parent always lives in the previous level, so world
+     * matrices are propagated level by level over contiguous arrays, each level split across the task scheduler,
+     * instead of chasing parents through registry lookups.
+     *
+     * Local matrices are only recomputed for chunks whose transform_3d changed since the last update, a dirty flag is
+     * inherited by all descendants and only dirty world matrices are written back to world_transform.
+     *
+     * The renderer places the instances of shared_render_mesh entities with a world_transform relative to it, see
+     * to_world(), so instanced meshes follow their parents.
+     *
+     * Usage:
+     *
+     *      auto body = registry.create<nvkg::transform_3d, nvkg::world_transform>(...);
+     *      auto arm = registry.create<nvkg::transform_3d, nvkg::world_transform>(...);
+     *      hierarchy.set_parent(registry, arm, body);
+     *      ...
+     *      hierarchy.update(registry, scheduler); // once per frame, before rendering
+     **/
+    class transform_hierarchy {
+        public:
+
+        /**
+         * Marks nodes without a parent.
+         **/
+        static constexpr std::uint32_t no_parent = UINT32_MAX;
+
+        /**
+         * @brief Attaches child to parent_entity. Both need transform_3d and world_transform components and the
+         * relation must not form a cycle.
+         *
+         * @param registry - registry owning both entities.
+         * @param child - entity to attach.
+         * @param parent_entity - new parent of child.
+         **/
+        void set_parent(ecs::registry& registry, ecs::entity child, ecs::entity parent_entity);
+
+        /**
+         * @brief Detaches child from its parent, it becomes a root.
+         *
+         * @param registry - registry owning the entity.
+         * @param child - entity to detach.
+         **/
+        void clear_parent(ecs::registry& registry, ecs::entity child);
+
+        /**
+         * @brief Forces a rebuild of the node arrays on the next update. Creating or destroying entities and changing
+         * parent components through the registry are detected, call this after changes that are not, e.g. removing a
+         * parent component directly.
+         **/
+        void invalidate() { structure_dirty_ = true; }
+
+        /**
+         * @brief Recomputes world matrices of nodes whose transform_3d or one of whose ancestors' transform_3d changed
+         * and writes them to their world_transform components. Must not run concurrently with other registry writes.
+         *
+         * @param registry - registry owning the hierarchy entities.
+         * @param scheduler - scheduler to spread large levels across, nullptr propagates on the calling thread.
+         **/
+        void update(ecs::registry& registry, task_scheduler* scheduler = nullptr);
+
+        /**
+         * @brief Returns the number of nodes.
+         **/
+        std::size_t size() const { return entities_.size(); }
+
+        /**
+         * @brief Returns the number of depth levels, 0 for an empty hierarchy.
+         **/
+        std::size_t depth() const { return level_offsets_.empty() ? 0 : level_offsets_.size() - 1; }
+
+        /**
+         * @brief Returns node entities in breadth first order, valid until the next update.
+         **/
+        std::span<const ecs::entity> entities() const { return entities_; }
+
+        /**
+         * @brief Returns world matrices in the order of entities(), valid until the next update.
+         **/
+        std::span<const glm::mat4> world_matrices() const { return world_; }
+
+        private:
+
+        // Maximum number of nodes of a level processed by a single task, levels up to this size run on the caller
+        static constexpr std::size_t propagate_grain = 1024;
+
+        void rebuild(ecs::registry& registry);
+        bool gather_changed(ecs::registry& registry);
+        void propagate(task_scheduler* scheduler);
+        void write_back(ecs::registry& registry);
+
+        // Node arrays in breadth first order, level d spans [level_offsets_[d], level_offsets_[d + 1])
+        std::vector<ecs::entity> entities_;
+        std::vector<std::uint32_t> parents_;
+        std::vector<glm::mat4> local_;
+        std::vector<glm::mat4> world_;
+        std::vector<std::uint8_t> dirty_;
+        std::vector<std::uint32_t> level_offsets_;
+
+        // Node index + 1 of every entity ID, 0 for entities that are not nodes
+        ecs::detail::paged_table<std::uint32_t, ecs::entity_location_page_size> index_;
+
+        // Number of entities with transform_3d and world_transform at the last rebuild, includes skipped ones
+        std::size_t member_count_{0};
+
+        ecs::change_tick_t last_tick_{0};
+        bool structure_dirty_{true};
+    };
+
+    /**
+     * @brief Places an instance given relative to an entity in world space. Instances are drawn scaled and translated
+     * only, so the rotation of world moves the instance but doesn't rotate it.
+     *
+     * @param world - world transform of the entity owning the instance.
+     * @param local - instance relative to the entity.
+     **/
+    transform_3d to_world(const world_transform& world, const transform_3d& local);
+}
+
+#endif
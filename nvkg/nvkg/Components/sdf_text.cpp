@@ -156,35 +156,34 @@ namespace nvkg {
         });
     }
 
-    void sdf_text::update_model_mesh(std::string text, std::unique_ptr<nvkg::Model>& model, uint32_t start_index) {
-        std::vector<Vertex2D> vertices;
-        std::vector<uint32_t> indices;
+    void sdf_text::update_model_mesh(const std::string& text, std::unique_ptr<nvkg::Model>& model, uint32_t start_index) {
+        // text is updated every frame, keep the buffers so this does not allocate once they fit the longest text
+        static thread_local std::vector<Vertex2D> vertices;
+        static thread_local std::vector<uint32_t> indices;
+        vertices.clear();
+        indices.clear();
 
         uint32_t indice_offset = 0;
         float previous_stride_x = 0;
 
         for (uint32_t i = 0; i < text.size(); i++) {
-            vi_2d* mesh = &chars_[text[i]];
+            // find instead of operator[], which would insert an empty mesh for unknown characters
+            auto mesh = chars_.find(text[i]);
 
-            std::vector<uint32_t> tmp_i = mesh->indices;
+            if (mesh != chars_.end()) {
+                for(auto index : mesh->second.indices) {
+                    indices.push_back(index + indice_offset);
+                }
 
-            for(auto& i : tmp_i) {
-                i += indice_offset;
-            }
-
-            indice_offset += 4;
+                for(auto vertex : mesh->second.vertices) {
+                    vertex.position.x += previous_stride_x;
+                    vertices.push_back(vertex);
+                }
 
-            indices.insert(indices.end(), tmp_i.begin(), tmp_i.end());
-            
-            std::vector<Vertex2D> tmp_v = mesh->vertices;
-
-            for(auto& v : tmp_v) {
-                v.position.x += previous_stride_x;
+                indice_offset += 4;
             }
 
             previous_stride_x += (float)sdf_text::font_chars_[(int)text[i]].xadvance / 46.f;
-
-            vertices.insert(vertices.end(), tmp_v.begin(), tmp_v.end());
         }
 
         model->update_mesh({
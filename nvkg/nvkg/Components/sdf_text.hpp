@@ -15,7 +15,7 @@ namespace nvkg {
 
             static std::unique_ptr<nvkg::Model> generate_text(std::string text);
 
-            static void update_model_mesh(std::string text, std::unique_ptr<nvkg::Model>& model, uint32_t start_index = 0);
+            static void update_model_mesh(const std::string& text, std::unique_ptr<nvkg::Model>& model, uint32_t start_index = 0);
 
             static void generate_text_old(std::string text, std::unique_ptr<nvkg::Model>& model);
 
@@ -0,0 +1,28 @@
+#ifndef NVKG_TRANSFORM_HPP
+#define NVKG_TRANSFORM_HPP
+
+#include <nvkg/Renderer/Utils/Math.hpp>
+#include <nvkg/ecs/ecs.hpp>
+
+namespace nvkg {
+    /*
+    * Transform components, kept apart from component.hpp so code that only places entities doesn't depend on the
+    * renderer
+    */
+
+    struct transform_3d {
+        glm::vec3 position_;
+        glm::vec3 scale_;
+        glm::vec3 rotation_;
+    };
+
+    struct parent { // attaches an entity with transform_3d to another one, see transform_hierarchy
+        ecs::entity entity_;
+    };
+
+    struct world_transform { // transform_3d composed with the transforms of all parents, see transform_hierarchy
+        glm::mat4 matrix_{1.0f};
+    };
+}
+
+#endif
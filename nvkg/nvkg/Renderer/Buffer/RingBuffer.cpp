@@ -0,0 +1,99 @@
+#include <nvkg/Renderer/Buffer/RingBuffer.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace nvkg {
+
+    namespace {
+        VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        void release(Buffer::Buffer& buffer) {
+            vkUnmapMemory(device().device(), buffer.bufferMemory);
+            Buffer::destroy_buffer(buffer);
+        }
+    }
+
+    frame_ring_buffer::frame_ring_buffer(VkDeviceSize frame_capacity, VkBufferUsageFlags usage, bool growable)
+        : usage_(usage), growable_(growable) {
+        create(frame_capacity);
+    }
+
+    frame_ring_buffer::~frame_ring_buffer() {
+        for(auto& retired : retired_) {
+            release(retired.buffer_);
+        }
+        release(buffer_);
+    }
+
+    void frame_ring_buffer::create(VkDeviceSize frame_capacity) {
+        frame_capacity_ = frame_capacity;
+
+        Buffer::create_buffer(
+            frame_capacity_ * SwapChain::MAX_FRAMES_IN_FLIGHT,
+            usage_,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            OUT buffer_.buffer,
+            OUT buffer_.bufferMemory
+        );
+        buffer_.size = frame_capacity_ * SwapChain::MAX_FRAMES_IN_FLIGHT;
+
+        void* mapped = nullptr;
+        NVKG_ASSERT(vkMapMemory(device().device(), buffer_.bufferMemory, 0, VK_WHOLE_SIZE, 0, OUT &mapped) == VK_SUCCESS,
+            "Failed to map ring buffer memory");
+        mapped_ = static_cast<std::byte*>(mapped);
+    }
+
+    void frame_ring_buffer::begin_frame(uint32_t frame_index) {
+        NVKG_ASSERT(frame_index < SwapChain::MAX_FRAMES_IN_FLIGHT, "Frame index " << frame_index << " is out of range");
+
+        frame_count_++;
+        std::erase_if(retired_, [this](retired_buffer& retired) {
+            if(frame_count_ - retired.frame_ < SwapChain::MAX_FRAMES_IN_FLIGHT) return false;
+            release(retired.buffer_);
+            return true;
+        });
+
+        frame_index_ = frame_index;
+        head_ = frame_index_ * frame_capacity_;
+    }
+
+    void frame_ring_buffer::grow(VkDeviceSize size, VkDeviceSize alignment) {
+        // frames in flight and this frame's earlier allocations still use the old buffer
+        retired_.push_back({buffer_, frame_count_});
+        create(std::bit_ceil(std::max(frame_capacity_ * 2, size + alignment)));
+        head_ = frame_index_ * frame_capacity_;
+
+        logger::debug(logger::Level::Info) << "Grew ring buffer to " << frame_capacity_ << " bytes per frame";
+    }
+
+    frame_ring_buffer::allocation frame_ring_buffer::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+        auto offset = align_up(head_, alignment);
+        if(offset + size > (frame_index_ + 1) * frame_capacity_) {
+            NVKG_ASSERT(growable_, "Ring buffer is out of space, " << size << " bytes requested with "
+                << frame_capacity_ - used() << " of " << frame_capacity_ << " bytes left");
+            grow(size, alignment);
+            offset = align_up(head_, alignment);
+        }
+
+        head_ = offset + size;
+        return { buffer_.buffer, offset, mapped_ + offset };
+    }
+
+    frame_ring_buffer::allocation frame_ring_buffer::push(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+        auto allocation = allocate(size, alignment);
+        std::memcpy(allocation.data_, data, size);
+        return allocation;
+    }
+
+    frame_ring_buffer::allocation frame_ring_buffer::at(uint32_t frame_index, VkDeviceSize offset) const {
+        NVKG_ASSERT(frame_index < SwapChain::MAX_FRAMES_IN_FLIGHT, "Frame index " << frame_index << " is out of range");
+        NVKG_ASSERT(offset < frame_capacity_, "Offset " << offset << " is outside of the frame's region");
+
+        const auto region_offset = frame_index * frame_capacity_ + offset;
+        return { buffer_.buffer, region_offset, mapped_ + region_offset };
+    }
+}
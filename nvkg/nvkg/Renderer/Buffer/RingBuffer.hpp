@@ -0,0 +1,112 @@
+#pragma once
+
+#include <nvkg/Renderer/Core.hpp>
+#include <nvkg/Renderer/Buffer/Buffer.hpp>
+#include <nvkg/Renderer/Swapchain/Swapchain.hpp>
+
+#include <vector>
+
+namespace nvkg {
+
+    /**
+     * @brief Host visible buffer for data written every frame, e.g. uniforms and instance transforms.
+     *
+     * The buffer is split into one region per frame in flight and mapped once for its whole lifetime. Every frame
+     * allocations are handed out linearly from the region of that frame, which the GPU stopped reading once the
+     * frame's fence was waited for, so writing never races with frames in flight and never maps memory. Allocations
+     * are addressed by their offset, to be used as vertex buffer offsets or dynamic descriptor offsets.
+     *
+     * A growable ring replaces its buffer by a larger one when a frame runs out of space, allocations made before stay
+     * valid and the old buffer is destroyed once no frame in flight uses it. Descriptors can't follow the buffer, so
+     * rings referenced by descriptors have to be fixed size.
+     *
+     * Usage:
+     *
+     *      ring.begin_frame(frame_index);  // after waiting for the frame's fence
+     *      auto allocation = ring.push(&data, sizeof(data), alignment);
+     *      vkCmdBindVertexBuffers(command_buffer, 1, 1, &allocation.buffer_, &allocation.offset_);
+     **/
+    class frame_ring_buffer {
+        public:
+
+            struct allocation {
+                VkBuffer buffer_{VK_NULL_HANDLE};
+                VkDeviceSize offset_{0}; // from the start of buffer_
+                void* data_{nullptr};    // mapped memory at offset_
+            };
+
+            /**
+             * @param frame_capacity - bytes available to every frame, a power of two keeps every region aligned.
+             * @param usage - usage of the buffer, e.g. VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT.
+             * @param growable - whether the buffer is replaced by a larger one when a frame runs out of space,
+             * fixed size rings assert instead.
+             **/
+            frame_ring_buffer(VkDeviceSize frame_capacity, VkBufferUsageFlags usage, bool growable);
+            ~frame_ring_buffer();
+
+            frame_ring_buffer(const frame_ring_buffer&) = delete;
+            frame_ring_buffer& operator=(const frame_ring_buffer&) = delete;
+
+            /**
+             * @brief Starts allocating from the region of frame_index, dropping all allocations made in it before.
+             * The GPU has to be done with the frame that last used the region.
+             *
+             * @param frame_index - index of the frame in flight, less than SwapChain::MAX_FRAMES_IN_FLIGHT.
+             **/
+            void begin_frame(uint32_t frame_index);
+
+            /**
+             * @brief Allocates size bytes in the current frame's region.
+             *
+             * @param size - bytes to allocate.
+             * @param alignment - alignment of the offset, a power of two.
+             **/
+            allocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+            /**
+             * @brief Allocates size bytes in the current frame's region and copies data into them.
+             **/
+            allocation push(const void* data, VkDeviceSize size, VkDeviceSize alignment);
+
+            /**
+             * @brief Returns the memory at offset from the start of frame_index's region, for data kept at the same place
+             * in every region instead of being pushed every frame. Such rings must not use allocate() or push().
+             *
+             * @param frame_index - index of the frame in flight, less than SwapChain::MAX_FRAMES_IN_FLIGHT.
+             * @param offset - offset from the start of the region, less than frame_capacity().
+             **/
+            allocation at(uint32_t frame_index, VkDeviceSize offset) const;
+
+            VkBuffer buffer() const { return buffer_.buffer; }
+            VkDeviceSize frame_capacity() const { return frame_capacity_; }
+
+            /**
+             * @brief Returns the bytes allocated in the current frame, including alignment padding.
+             **/
+            VkDeviceSize used() const { return head_ - frame_index_ * frame_capacity_; }
+
+        private:
+
+            void create(VkDeviceSize frame_capacity);
+            void grow(VkDeviceSize size, VkDeviceSize alignment);
+
+            struct retired_buffer {
+                Buffer::Buffer buffer_;
+                uint64_t frame_; // frame_count_ when retired
+            };
+
+            Buffer::Buffer buffer_{};
+            std::byte* mapped_{nullptr};
+
+            VkDeviceSize frame_capacity_;
+            VkBufferUsageFlags usage_;
+            bool growable_;
+
+            uint32_t frame_index_{0};
+            VkDeviceSize head_{0};
+
+            // frames begun so far, old buffers are released MAX_FRAMES_IN_FLIGHT frames after being retired
+            uint64_t frame_count_{0};
+            std::vector<retired_buffer> retired_;
+    };
+}
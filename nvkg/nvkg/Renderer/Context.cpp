@@ -13,7 +13,7 @@ namespace nvkg {
 
         DescriptorPool::add_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10);
         DescriptorPool::add_pool_size(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10);
-        DescriptorPool::add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10);
+        DescriptorPool::add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 16);
         DescriptorPool::add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 10);
         DescriptorPool::add_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10);
 
@@ -28,6 +28,10 @@ namespace nvkg {
     }
 
     Context::~Context() {
+        for(auto& td : thread_data_) {
+            vkDestroyCommandPool(device().device(), td.command_pool_, nullptr);
+        }
+
         DescriptorPool::destroy_pool();
 
         MaterialManager::cleanup();
@@ -39,9 +43,9 @@ namespace nvkg {
             logger::debug(logger::Level::Warning) << "Detected less than 4 threads on the system. Performance may be impacted!";
             logger::debug(logger::Level::Warning) << "You may provide a custom thread count via the Context constructor";
         }
-        uint32_t tc = (thread_count >= 1) ? thread_count : (std::thread::hardware_concurrency());
-        thread_pool_ = std::make_unique<BS::thread_pool>(tc);
-        logger::debug(logger::Level::Info) << "Creating thread pool with " << tc << " threads...";
+        // the thread waiting on scheduled work helps executing it, so one worker less keeps thread_count threads busy
+        scheduler_ = std::make_unique<task_scheduler>(thread_count > 1 ? thread_count - 1 : 1);
+        logger::debug(logger::Level::Info) << "Creating task scheduler with " << thread_count << " threads...";
 
         thread_data_.resize(thread_count); // TODO maybe not allocate all threads to rendering
         thread_command_buffer_collector.resize(thread_count); // one command buffer per thread data, therefore we can prevent per frame reallocation
@@ -59,10 +63,10 @@ namespace nvkg {
             );
 
             VkCommandBufferAllocateInfo secondary_cmd_buffer_alloc_info = initializers::command_buffer_allocate_info(
-                thread_data_[i].command_pool_, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+                thread_data_[i].command_pool_, VK_COMMAND_BUFFER_LEVEL_SECONDARY, SwapChain::MAX_FRAMES_IN_FLIGHT);
 
-            NVKG_ASSERT(vkAllocateCommandBuffers(device().device(), &secondary_cmd_buffer_alloc_info, &thread_data_[i].command_buffer_) == VK_SUCCESS,
-                "Failed to allocate secondary command buffer");
+            NVKG_ASSERT(vkAllocateCommandBuffers(device().device(), &secondary_cmd_buffer_alloc_info, OUT thread_data_[i].command_buffers_.data()) == VK_SUCCESS,
+                "Failed to allocate secondary command buffers");
         }
     }
 
@@ -83,15 +87,48 @@ namespace nvkg {
         inheritance_info.renderPass = swapchain.get_render_pass()->get();
         inheritance_info.framebuffer = swapchain.get_frame_buffer(current_image_index);
 
-        /// Multithreaded render code
+        if(!record_in_parallel()) {
+            renderer_->record(commandBuffer, 0, 1);
+            return;
+        }
 
         VkCommandBufferBeginInfo cmd_bf_begin_info = initializers::command_buffer_begin_info();
-        cmd_bf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        cmd_bf_begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
         cmd_bf_begin_info.pInheritanceInfo = &inheritance_info;
 
-        /// End multithreaded cender code
+        // draw lists and uniforms were prepared in start_frame, the registry is only read while recording. Every
+        // partition records into the secondary of its own thread data for this frame in flight, so no command pool is
+        // used by two tasks at once
+        scheduler_->parallel_for(0, thread_data_.size(), [&](std::size_t first, std::size_t last) {
+            for(auto partition = first; partition < last; partition++) {
+                record_secondary(partition, cmd_bf_begin_info);
+            }
+        });
+
+        for(std::size_t i = 0; i < thread_data_.size(); i++) {
+            thread_command_buffer_collector[i] = thread_data_[i].command_buffers_[current_frame_index];
+        }
 
-        renderer_->render(commandBuffer, camera_, registry_);
+        vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(thread_command_buffer_collector.size()), thread_command_buffer_collector.data());
+    }
+
+    void Context::record_secondary(std::size_t partition, const VkCommandBufferBeginInfo& begin_info) {
+        VkCommandBuffer secondary = thread_data_[partition].command_buffers_[current_frame_index];
+
+        NVKG_ASSERT(vkBeginCommandBuffer(OUT secondary, &begin_info) == VK_SUCCESS,
+            "Failed to begin recording secondary command buffer");
+
+        // dynamic state is not inherited from the primary command buffer
+        VkViewport viewport = initializers::viewport(swapchain.get_width(), swapchain.get_height(), 0.0f, 1.0f);
+        VkRect2D scissor = initializers::rect2D(swapchain.get_width(), swapchain.get_height(), 0, 0);
+
+        vkCmdSetViewport(secondary, 0, 1, &viewport);
+        vkCmdSetScissor(secondary, 0, 1, &scissor);
+
+        renderer_->record(secondary, partition, thread_data_.size());
+
+        NVKG_ASSERT(vkEndCommandBuffer(OUT secondary) == VK_SUCCESS,
+            "Failed to record secondary command buffer!");
     }
 
     void Context::recreate_swapchain() {
@@ -128,11 +165,22 @@ namespace nvkg {
         frame_time_ = std::chrono::duration<float, std::chrono::seconds::period>(new_time_ - current_time_).count();
         current_time_ = new_time_;
 
+        // stamp this frame's component changes with a new tick, then propagate transforms changed since the last one
+        registry_.advance_tick();
+        {
+            mem_profiler::scope profile(mem_profiler::tag::ecs);
+            hierarchy_.update(registry_, scheduler_.get());
+        }
+
         if(!start_frame()) return;
-                
-        render_frame();
 
-        end_frame();
+        {
+            mem_profiler::scope profile(mem_profiler::tag::renderer);
+            render_frame();
+            end_frame();
+        }
+
+        mem_profiler::end_frame();
 
         if(Input::mouse_button_down(GLFW_MOUSE_BUTTON_LEFT)) {
             auto pos = Input::get_cursor_pos();
@@ -168,6 +216,12 @@ namespace nvkg {
 
         NVKG_ASSERT(vkBeginCommandBuffer(OUT commandBuffer, &cmd_buffer_begin_info) == VK_SUCCESS,
             "Failed to begin recording command buffer");
+
+        // compute work like GPU culling has to be recorded before the render pass begins
+        renderer_->prepare(camera_, registry_, current_frame_index, scheduler_.get());
+        MaterialManager::upload_uniforms(current_frame_index);
+        upload_semaphore_ = uploads().flush(commandBuffer, current_frame_index);
+        renderer_->cull(commandBuffer);
         
         begin_swapchain_renderpass(commandBuffer);
         
@@ -184,7 +238,7 @@ namespace nvkg {
         NVKG_ASSERT(vkEndCommandBuffer(OUT commandBuffer) == VK_SUCCESS,
             "Failed to record command buffer!");
 
-        auto result = swapchain.submit_command_buffers(&commandBuffer, &current_image_index);
+        auto result = swapchain.submit_command_buffers(&commandBuffer, &current_image_index, upload_semaphore_);
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window.resized()) {
             window.reset_resize();
@@ -207,13 +261,21 @@ namespace nvkg {
         clear_values[0].color = clearValue;
         clear_values[1].depthStencil = {1.0f, 0};
 
+        // secondary command buffers can't be mixed with inline commands in the same subpass
+        const VkSubpassContents contents = record_in_parallel() ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+
         RenderPass::Begin(swapchain.get_render_pass()->get(),
                           OUT commandBuffer,
                           swapchain.get_frame_buffer(current_image_index),
                           {0,0},
                           swapchain.get_swapchain_extent(),
                           clear_values,
-                          clear_value_count);
+                          clear_value_count,
+                          contents);
+
+        if(contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+            return;
+        }
 
         VkViewport viewport = initializers::viewport(swapchain.get_width(), swapchain.get_height(), 0.0f, 1.0f);
         VkRect2D scissor = initializers::rect2D(swapchain.get_width(), swapchain.get_height(), 0, 0);
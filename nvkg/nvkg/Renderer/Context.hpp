@@ -2,20 +2,23 @@
 #define NVKG_CONTEXT_HPP
 
 #include <nvkg/Renderer/Device/VulkanDevice.hpp>
+#include <nvkg/Renderer/Device/UploadManager.hpp>
 #include <nvkg/Renderer/Swapchain/Swapchain.hpp>
 #include <nvkg/Renderer/Pipeline/Pipeline.hpp>
 #include <nvkg/Renderer/Material/Material.hpp>
 #include <nvkg/Renderer/Renderer/Renderer.hpp>
 #include <nvkg/Renderer/DescriptorPool/DescriptorPool.hpp>
+#include <nvkg/Components/hierarchy.hpp>
 #include <nvkg/Input/Input.hpp>
 
+#include <array>
 #include <chrono>
 
 namespace nvkg {
 
     struct thread_data {
         VkCommandPool command_pool_;
-        VkCommandBuffer command_buffer_;
+        std::array<VkCommandBuffer, SwapChain::MAX_FRAMES_IN_FLIGHT> command_buffers_; // one secondary per frame in flight
     };
 
     class Context {
@@ -51,11 +54,15 @@ namespace nvkg {
 
             ecs::registry& get_registry() { return registry_; }
 
+            transform_hierarchy& get_hierarchy() { return hierarchy_; }
+
+            Renderer& get_renderer() { return *renderer_; }
+
             float get_aspect_ratio() const { return swapchain.extent_aspect_ratio(); }
 
             bool frame_started() { return is_frame_started; }
 
-            std::unique_ptr<BS::thread_pool> thread_pool_;
+            std::unique_ptr<task_scheduler> scheduler_;
 
         private:
             static std::vector<VkCommandBuffer> command_buffers;
@@ -76,6 +83,9 @@ namespace nvkg {
             void end_swapchain_renderpass(VkCommandBuffer commandBuffer);
 
             void render_frame();
+            void record_secondary(std::size_t partition, const VkCommandBufferBeginInfo& begin_info);
+
+            bool record_in_parallel() const { return scheduler_ && !thread_data_.empty(); }
 
             nvkg::Window& window;
             
@@ -86,12 +96,14 @@ namespace nvkg {
             uint32_t current_image_index;
             bool is_frame_started{false};
             int current_frame_index{0};
+            VkSemaphore upload_semaphore_{VK_NULL_HANDLE}; // uploads the current frame waits on
 
             std::chrono::time_point<std::chrono::high_resolution_clock> new_time_, current_time_ = std::chrono::high_resolution_clock::now();
             float frame_time_ = 0.0f;
             std::pair<double, double> old_cursor_pos;
 
             ecs::registry registry_;
+            transform_hierarchy hierarchy_;
             std::shared_ptr<CameraNew> camera_;
     };
 }
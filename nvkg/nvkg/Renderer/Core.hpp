@@ -5,7 +5,7 @@
 #include <nvkg/Utils/mem_profiler.hpp>
 #include <nvkg/Utils/logger.hpp>
 #include <nvkg/ecs/ecs.hpp>
-#include <nvkg/Utils/threadpool.hpp> //TODO replace with own 
+#include <nvkg/Utils/task_scheduler.hpp>
 
 #include <volk/volk.h>
 #include <iostream>
@@ -0,0 +1,372 @@
+#include <nvkg/Renderer/Device/UploadManager.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace nvkg {
+
+    namespace {
+        VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        void release(Buffer::Buffer& buffer) {
+            vkUnmapMemory(device().device(), buffer.bufferMemory);
+            Buffer::destroy_buffer(buffer);
+        }
+
+        void memory_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+            VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = src_access;
+            barrier.dstAccessMask = dst_access;
+            vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+    }
+
+    upload_manager::upload_manager() {
+        const auto families = device().find_phys_queue_families();
+        graphics_family_ = families.graphics_family_;
+        transfer_family_ = families.transfer_family_;
+        transfer_queue_ = device().transfer_queue();
+
+        VkCommandPoolCreateInfo pool_info = initializers::command_pool_create_info();
+        pool_info.queueFamilyIndex = transfer_family_;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        NVKG_ASSERT(vkCreateCommandPool(device().device(), &pool_info, nullptr, OUT &command_pool_) == VK_SUCCESS,
+            "Failed to create upload command pool!");
+
+        VkSemaphoreCreateInfo semaphore_info{};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        for(auto& semaphore : semaphores_) {
+            NVKG_ASSERT(vkCreateSemaphore(device().device(), &semaphore_info, nullptr, OUT &semaphore) == VK_SUCCESS,
+                "Failed to create upload semaphore!");
+        }
+
+        logger::debug(logger::Level::Info) << "Uploading on queue family " << transfer_family_
+            << (has_transfer_queue() ? " (dedicated transfer)" : " (graphics)");
+    }
+
+    upload_manager::~upload_manager() {
+        for(auto& b : in_flight_) {
+            vkWaitForFences(device().device(), 1, &b->fence_, VK_TRUE, UINT64_MAX);
+        }
+
+        const auto destroy = [](std::unique_ptr<batch>& b) {
+            for(auto& chunk : b->staging_) {
+                release(chunk.buffer_);
+            }
+            vkDestroyFence(device().device(), b->fence_, nullptr);
+        };
+
+        if(frame_batch_) destroy(frame_batch_);
+        for(auto* batches : {&stream_batches_, &in_flight_}) {
+            std::for_each(batches->begin(), batches->end(), destroy);
+        }
+        std::for_each(free_.begin(), free_.end(), destroy);
+
+        for(auto semaphore : semaphores_) {
+            vkDestroySemaphore(device().device(), semaphore, nullptr);
+        }
+        // frees the command buffers of all batches
+        vkDestroyCommandPool(device().device(), command_pool_, nullptr);
+    }
+
+    std::unique_ptr<upload_manager::batch> upload_manager::acquire_batch() {
+        std::unique_ptr<batch> b;
+        if(free_.empty()) {
+            b = std::make_unique<batch>();
+
+            VkCommandBufferAllocateInfo alloc_info = initializers::command_buffer_allocate_info(command_pool_, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+            NVKG_ASSERT(vkAllocateCommandBuffers(device().device(), &alloc_info, OUT &b->command_buffer_) == VK_SUCCESS,
+                "Failed to allocate upload command buffer!");
+
+            VkFenceCreateInfo fence_info{};
+            fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            NVKG_ASSERT(vkCreateFence(device().device(), &fence_info, nullptr, OUT &b->fence_) == VK_SUCCESS,
+                "Failed to create upload fence!");
+        } else {
+            b = std::move(free_.back());
+            free_.pop_back();
+        }
+
+        b->ticket_ = next_ticket_++;
+
+        VkCommandBufferBeginInfo begin_info = initializers::command_buffer_begin_info();
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(OUT b->command_buffer_, &begin_info);
+
+        return b;
+    }
+
+    upload_manager::batch& upload_manager::recording_batch(VkDeviceSize size, bool stream) {
+        if(!stream) {
+            if(!frame_batch_) frame_batch_ = acquire_batch();
+            return *frame_batch_;
+        }
+
+        // uploads larger than the budget get a batch of their own
+        if(stream_batches_.empty() || (stream_batches_.back()->bytes_ > 0 && stream_batches_.back()->bytes_ + size > stream_budget_)) {
+            stream_batches_.push_back(acquire_batch());
+        }
+        return *stream_batches_.back();
+    }
+
+    std::pair<VkBuffer, VkDeviceSize> upload_manager::stage(batch& b, const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+        if(b.staging_.empty() || align_up(b.head_, alignment) + size > b.staging_.back().buffer_.size) {
+            staging_chunk chunk{};
+            chunk.buffer_.size = std::max(staging_chunk_bytes, size);
+            Buffer::create_buffer(chunk.buffer_.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                OUT chunk.buffer_.buffer, OUT chunk.buffer_.bufferMemory);
+
+            void* mapped = nullptr;
+            NVKG_ASSERT(vkMapMemory(device().device(), chunk.buffer_.bufferMemory, 0, VK_WHOLE_SIZE, 0, OUT &mapped) == VK_SUCCESS,
+                "Failed to map staging memory");
+            chunk.mapped_ = static_cast<std::byte*>(mapped);
+
+            b.staging_.push_back(chunk);
+            b.head_ = 0;
+        }
+
+        auto& chunk = b.staging_.back();
+        const auto offset = align_up(b.head_, alignment);
+        std::memcpy(chunk.mapped_ + offset, data, size);
+        b.head_ = offset + size;
+        b.bytes_ += size;
+
+        return { chunk.buffer_.buffer, offset };
+    }
+
+    upload_manager::ticket upload_manager::upload_buffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dst_offset, bool stream) {
+        std::scoped_lock lock(mutex_);
+
+        auto& b = recording_batch(size, stream);
+        const auto [src, src_offset] = stage(b, data, size, 4);
+
+        VkBufferCopy region{};
+        region.srcOffset = src_offset;
+        region.dstOffset = dst_offset;
+        region.size = size;
+        vkCmdCopyBuffer(b.command_buffer_, src, dst, 1, &region);
+
+        if(has_transfer_queue()) {
+            VkBufferMemoryBarrier release{};
+            release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            release.srcQueueFamilyIndex = transfer_family_;
+            release.dstQueueFamilyIndex = graphics_family_;
+            release.buffer = dst;
+            release.offset = dst_offset;
+            release.size = size;
+            vkCmdPipelineBarrier(b.command_buffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0, 0, nullptr, 1, &release, 0, nullptr);
+
+            auto acquire = release;
+            acquire.srcAccessMask = 0;
+            acquire.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            b.buffer_acquires_.push_back(acquire);
+        }
+
+        return b.ticket_;
+    }
+
+    upload_manager::ticket upload_manager::upload_image(VkImage dst, const void* data, VkDeviceSize size,
+        std::span<const VkBufferImageCopy> regions, VkImageSubresourceRange subresource_range, VkImageLayout old_layout, bool stream) {
+        std::scoped_lock lock(mutex_);
+
+        auto& b = recording_batch(size, stream);
+        // offsets into a buffer copied to an image have to be a multiple of 4 and of the texel block size
+        const auto [src, src_offset] = stage(b, data, size, 16);
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = old_layout;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = dst;
+        barrier.subresourceRange = subresource_range;
+        vkCmdPipelineBarrier(b.command_buffer_, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        std::vector<VkBufferImageCopy> staged_regions(regions.begin(), regions.end());
+        for(auto& region : staged_regions) {
+            region.bufferOffset += src_offset;
+        }
+        vkCmdCopyBufferToImage(b.command_buffer_, src, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(staged_regions.size()), staged_regions.data());
+
+        // the transition to the shader read layout doubles as release to the graphics queue family
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        if(has_transfer_queue()) {
+            barrier.srcQueueFamilyIndex = transfer_family_;
+            barrier.dstQueueFamilyIndex = graphics_family_;
+        }
+        vkCmdPipelineBarrier(b.command_buffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        if(has_transfer_queue()) {
+            auto acquire = barrier;
+            acquire.srcAccessMask = 0;
+            acquire.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            b.image_acquires_.push_back(acquire);
+        }
+
+        return b.ticket_;
+    }
+
+    void upload_manager::update_buffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dst_offset) {
+        std::scoped_lock lock(mutex_);
+
+        const auto* bytes = static_cast<const std::byte*>(data);
+        updates_.push_back({dst, dst_offset, std::vector<std::byte>(bytes, bytes + size)});
+    }
+
+    void upload_manager::submit(std::unique_ptr<batch> b, VkSemaphore signal) {
+        vkEndCommandBuffer(b->command_buffer_);
+
+        VkSubmitInfo submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &b->command_buffer_;
+        submit_info.signalSemaphoreCount = signal != VK_NULL_HANDLE ? 1 : 0;
+        submit_info.pSignalSemaphores = &signal;
+
+        NVKG_ASSERT(vkQueueSubmit(transfer_queue_, 1, &submit_info, b->fence_) == VK_SUCCESS,
+            "Failed to submit upload command buffer");
+
+        buffer_acquires_.insert(buffer_acquires_.end(), b->buffer_acquires_.begin(), b->buffer_acquires_.end());
+        image_acquires_.insert(image_acquires_.end(), b->image_acquires_.begin(), b->image_acquires_.end());
+        b->buffer_acquires_.clear();
+        b->image_acquires_.clear();
+
+        in_flight_.push_back(std::move(b));
+    }
+
+    void upload_manager::retire_completed() {
+        std::erase_if(in_flight_, [this](std::unique_ptr<batch>& b) {
+            if(vkGetFenceStatus(device().device(), b->fence_) != VK_SUCCESS) return false;
+
+            vkResetFences(device().device(), 1, &b->fence_);
+
+            // keep one regular chunk for the next batch, chunks of large uploads are released
+            const auto keep = std::find_if(b->staging_.begin(), b->staging_.end(),
+                [](const staging_chunk& chunk) { return chunk.buffer_.size == staging_chunk_bytes; });
+            for(auto it = b->staging_.begin(); it != b->staging_.end(); ++it) {
+                if(it != keep) release(it->buffer_);
+            }
+            if(keep != b->staging_.end()) {
+                // assign() must not read from the vector it overwrites
+                const staging_chunk kept = *keep;
+                b->staging_.assign(1, kept);
+            } else {
+                b->staging_.clear();
+            }
+            b->head_ = 0;
+            b->bytes_ = 0;
+
+            free_.push_back(std::move(b));
+            return true;
+        });
+    }
+
+    VkSemaphore upload_manager::flush(VkCommandBuffer command_buffer, uint32_t frame_index) {
+        NVKG_ASSERT(frame_index < SwapChain::MAX_FRAMES_IN_FLIGHT, "Frame index " << frame_index << " is out of range");
+
+        std::scoped_lock lock(mutex_);
+
+        retire_completed();
+
+        std::unique_ptr<batch> stream;
+        if(!stream_batches_.empty() && stream_batches_.front()->bytes_ > 0) {
+            stream = std::move(stream_batches_.front());
+            stream_batches_.pop_front();
+        }
+
+        // signaling on the last submission covers everything submitted to the queue before it
+        VkSemaphore signal = VK_NULL_HANDLE;
+        if(stream || frame_batch_) {
+            signal = semaphores_[frame_index];
+            if(stream) submit(std::move(stream), frame_batch_ ? VK_NULL_HANDLE : signal);
+            if(frame_batch_) submit(std::move(frame_batch_), signal);
+        }
+
+        if(!buffer_acquires_.empty() || !image_acquires_.empty()) {
+            vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                0, nullptr,
+                static_cast<uint32_t>(buffer_acquires_.size()), buffer_acquires_.data(),
+                static_cast<uint32_t>(image_acquires_.size()), image_acquires_.data());
+            buffer_acquires_.clear();
+            image_acquires_.clear();
+        }
+
+        if(!updates_.empty()) {
+            update_ring_.begin_frame(frame_index);
+
+            // earlier frames on the graphics queue may still read the buffers
+            memory_barrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, 0);
+
+            for(const auto& update : updates_) {
+                const auto allocation = update_ring_.push(update.data_.data(), update.data_.size(), 4);
+
+                VkBufferCopy region{};
+                region.srcOffset = allocation.offset_;
+                region.dstOffset = update.dst_offset_;
+                region.size = update.data_.size();
+                vkCmdCopyBuffer(command_buffer, allocation.buffer_, update.dst_, 1, &region);
+            }
+
+            memory_barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT);
+            updates_.clear();
+        }
+
+        return signal;
+    }
+
+    bool upload_manager::is_complete(ticket t) {
+        std::scoped_lock lock(mutex_);
+
+        retire_completed();
+
+        const auto has_ticket = [t](const std::unique_ptr<batch>& b) { return b->ticket_ == t; };
+        if(frame_batch_ && frame_batch_->ticket_ == t) return false;
+        return std::none_of(stream_batches_.begin(), stream_batches_.end(), has_ticket)
+            && std::none_of(in_flight_.begin(), in_flight_.end(), has_ticket);
+    }
+
+    void upload_manager::wait(ticket t) {
+        std::scoped_lock lock(mutex_);
+
+        const auto has_ticket = [t](const std::unique_ptr<batch>& b) { return b->ticket_ == t; };
+
+        if(frame_batch_ && frame_batch_->ticket_ == t) {
+            submit(std::move(frame_batch_));
+        } else if(std::any_of(stream_batches_.begin(), stream_batches_.end(), has_ticket)) {
+            // streamed batches go out in order
+            bool submitted = false;
+            while(!submitted) {
+                submitted = has_ticket(stream_batches_.front());
+                submit(std::move(stream_batches_.front()));
+                stream_batches_.pop_front();
+            }
+        }
+
+        const auto it = std::find_if(in_flight_.begin(), in_flight_.end(), has_ticket);
+        if(it == in_flight_.end()) return;
+
+        vkWaitForFences(device().device(), 1, &(*it)->fence_, VK_TRUE, UINT64_MAX);
+        retire_completed();
+    }
+
+    upload_manager& uploads() {
+        static upload_manager uploads_;
+        return uploads_;
+    }
+}
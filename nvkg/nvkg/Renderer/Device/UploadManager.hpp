@@ -0,0 +1,168 @@
+#pragma once
+
+#include <nvkg/Renderer/Core.hpp>
+#include <nvkg/Renderer/Device/VulkanDevice.hpp>
+#include <nvkg/Renderer/Buffer/Buffer.hpp>
+#include <nvkg/Renderer/Buffer/RingBuffer.hpp>
+#include <nvkg/Renderer/Swapchain/Swapchain.hpp>
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace nvkg {
+
+    /**
+     * @brief Batches host to device copies instead of submitting and idling the queue once per copy.
+     *
+     * Uploads into resources the GPU doesn't use yet, e.g. freshly created vertex buffers and textures, are written to
+     * staging memory right away and recorded into a batch, which runs on a dedicated transfer queue family when the
+     * device has one. flush() submits the batches once per frame and returns a semaphore for the frame's submission
+     * to wait on, ownership of the uploaded resources is handed back to the graphics queue family by barriers
+     * recorded into the frame's command buffer. Batches are tracked by fences, so the CPU never waits for a copy
+     * unless asked to by wait().
+     *
+     * Updates of resources frames in flight may still read are recorded into the frame's command buffer instead,
+     * ordered after all earlier frames on the graphics queue.
+     *
+     * Streamed uploads only go out with up to stream_budget() bytes per frame so loading assets doesn't stall frames,
+     * the returned ticket tells when the resource may be used. The engine's own loaders don't stream, textures and
+     * models are used right after loading, streaming needs the caller to hold back draws until is_complete().
+     *
+     * Recording is thread safe. flush() and wait() submit to the queues and have to be called from the render thread.
+     * Resources have to outlive their pending uploads.
+     **/
+    class upload_manager {
+        public:
+
+            using ticket = uint64_t;
+
+            upload_manager();
+            ~upload_manager();
+
+            upload_manager(const upload_manager&) = delete;
+            upload_manager& operator=(const upload_manager&) = delete;
+
+            /**
+             * @brief Copies data into a buffer the GPU doesn't use yet. The buffer needs VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+             *
+             * @param stream - whether the copy is subject to the stream budget, unstreamed copies go out with the next
+             * frame.
+             * @returns ticket of the copy for is_complete() and wait().
+             **/
+            ticket upload_buffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dst_offset = 0, bool stream = false);
+
+            /**
+             * @brief Copies data into an image the GPU doesn't use yet and transitions it to
+             * VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+             *
+             * @param regions - regions to copy, buffer offsets are relative to data.
+             * @param old_layout - layout of the image before the copy, its contents are discarded.
+             * @param stream - whether the copy is subject to the stream budget.
+             * @returns ticket of the copy for is_complete() and wait().
+             **/
+            ticket upload_image(VkImage dst, const void* data, VkDeviceSize size, std::span<const VkBufferImageCopy> regions,
+                VkImageSubresourceRange subresource_range, VkImageLayout old_layout, bool stream = false);
+
+            /**
+             * @brief Copies data into a buffer frames in flight may still read, the copy is recorded into the next
+             * frame's command buffer and visible to all commands recorded after flush().
+             **/
+            void update_buffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dst_offset = 0);
+
+            /**
+             * @brief Submits pending uploads, at most stream_budget() bytes of them streamed, and records the pending
+             * updates and ownership transfers into command_buffer. Has to be called once per frame after waiting for
+             * the frame's fence and before recording commands that use uploaded resources.
+             *
+             * @param frame_index - index of the frame in flight, less than SwapChain::MAX_FRAMES_IN_FLIGHT.
+             * @returns semaphore the frame's submission has to wait on, VK_NULL_HANDLE when nothing was submitted.
+             **/
+            VkSemaphore flush(VkCommandBuffer command_buffer, uint32_t frame_index);
+
+            /**
+             * @brief Returns whether the copy of a ticket finished on the GPU, without blocking.
+             **/
+            bool is_complete(ticket t);
+
+            /**
+             * @brief Submits all uploads up to ticket t and blocks until they finished, for resources needed right away.
+             * Their ownership transfers are still recorded by the next flush().
+             **/
+            void wait(ticket t);
+
+            void set_stream_budget(VkDeviceSize bytes_per_frame) { stream_budget_ = bytes_per_frame; }
+            VkDeviceSize stream_budget() const { return stream_budget_; }
+
+            bool has_transfer_queue() const { return transfer_family_ != graphics_family_; }
+
+        private:
+
+            struct staging_chunk {
+                Buffer::Buffer buffer_;
+                std::byte* mapped_;
+            };
+
+            struct batch {
+                VkCommandBuffer command_buffer_{VK_NULL_HANDLE};
+                VkFence fence_{VK_NULL_HANDLE};
+                ticket ticket_{0};
+
+                std::vector<staging_chunk> staging_;
+                VkDeviceSize head_{0}; // in the last staging chunk
+                VkDeviceSize bytes_{0};
+
+                // acquires on the graphics queue family matching the releases recorded into the batch
+                std::vector<VkBufferMemoryBarrier> buffer_acquires_;
+                std::vector<VkImageMemoryBarrier> image_acquires_;
+            };
+
+            struct pending_update {
+                VkBuffer dst_;
+                VkDeviceSize dst_offset_;
+                std::vector<std::byte> data_;
+            };
+
+            batch& recording_batch(VkDeviceSize size, bool stream);
+            std::unique_ptr<batch> acquire_batch();
+            std::pair<VkBuffer, VkDeviceSize> stage(batch& b, const void* data, VkDeviceSize size, VkDeviceSize alignment);
+
+            void submit(std::unique_ptr<batch> b, VkSemaphore signal = VK_NULL_HANDLE);
+            void retire_completed();
+
+            // Initial size of staging chunks, larger uploads get a chunk of their own
+            static constexpr VkDeviceSize staging_chunk_bytes = 8 * 1024 * 1024;
+            static constexpr VkDeviceSize update_ring_bytes = 256 * 1024;
+
+            uint32_t graphics_family_;
+            uint32_t transfer_family_;
+            VkQueue transfer_queue_;
+            VkCommandPool command_pool_;
+
+            std::mutex mutex_;
+            ticket next_ticket_{1};
+
+            std::unique_ptr<batch> frame_batch_;
+            std::deque<std::unique_ptr<batch>> stream_batches_; // oldest first, the last one is still recorded
+            std::deque<std::unique_ptr<batch>> in_flight_;      // submitted, in submission order
+            std::vector<std::unique_ptr<batch>> free_;
+
+            // acquires of submitted batches, recorded into the command buffer of the next flush
+            std::vector<VkBufferMemoryBarrier> buffer_acquires_;
+            std::vector<VkImageMemoryBarrier> image_acquires_;
+
+            std::vector<pending_update> updates_;
+            frame_ring_buffer update_ring_{update_ring_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true};
+
+            // one per frame in flight, the frame's fence guarantees the previous wait on it executed
+            std::array<VkSemaphore, SwapChain::MAX_FRAMES_IN_FLIGHT> semaphores_;
+
+            VkDeviceSize stream_budget_{4 * 1024 * 1024};
+    };
+
+    upload_manager& uploads();
+}
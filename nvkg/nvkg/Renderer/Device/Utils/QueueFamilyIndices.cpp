@@ -35,6 +35,21 @@ namespace nvkg::QueueFamilyIndices {
                 break;
             }
         }
+
+        // a transfer only family runs uploads alongside graphics work, images can only be copied to arbitrary
+        // offsets and extents with a transfer granularity of one texel
+        indices.transfer_family_ = indices.graphics_family_;
+        for (size_t i = 0; i < queueFamilyCount; i++) {
+            VkQueueFamilyProperties queueFamily = queueFamilies[i];
+            VkExtent3D granularity = queueFamily.minImageTransferGranularity;
+
+            if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT)
+                && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+                && granularity.width == 1 && granularity.height == 1 && granularity.depth == 1) {
+                indices.transfer_family_ = i;
+                break;
+            }
+        }
         return indices;
     }
 }
\ No newline at end of file
@@ -12,6 +12,7 @@ namespace nvkg::QueueFamilyIndices {
         uint32_t graphics_family_;
         uint32_t present_family_;
         uint32_t compute_family;
+        uint32_t transfer_family_;      // graphics_family_ when there is no dedicated transfer family
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
     };
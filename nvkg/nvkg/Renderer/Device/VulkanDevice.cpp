@@ -107,7 +107,7 @@ namespace nvkg {
 	void vulkan_device_impl::create_logical_device() {
 		QueueFamilyIndices::QueueFamilyIndices indices = QueueFamilyIndices::find_queue_families(physical_device_, surface_);
 
-		std::set<uint32_t> uniqueQueueFamilies = {indices.graphics_family_, indices.present_family_};
+		std::set<uint32_t> uniqueQueueFamilies = {indices.graphics_family_, indices.present_family_, indices.transfer_family_};
 		VkDeviceQueueCreateInfo queueCreateInfos[uniqueQueueFamilies.size()];
 
 		float queuePriority = 1.0f;
@@ -123,8 +123,15 @@ namespace nvkg {
 			index++;
 		}
 
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physical_device_, OUT &supportedFeatures);
+
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+		draw_indirect_first_instance_ = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+
+		logger::debug(logger::Level::Info) << "drawIndirectFirstInstance: " << draw_indirect_first_instance_;
 
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -149,6 +156,7 @@ namespace nvkg {
 		vkGetDeviceQueue(device_, indices.graphics_family_, 0, OUT &graphics_queue_);
 		vkGetDeviceQueue(device_, indices.compute_family, 0, OUT &compute_queue_);
 		vkGetDeviceQueue(device_, indices.present_family_, 0, OUT &present_queue_);
+		vkGetDeviceQueue(device_, indices.transfer_family_, 0, OUT &transfer_queue_);
 
 		volkLoadDevice(device_);
 	}
@@ -222,8 +230,16 @@ namespace nvkg {
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
 
-		vkQueueSubmit(graphics_queue_, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphics_queue_);
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		VkFence fence;
+		vkCreateFence(device_, &fenceInfo, nullptr, OUT &fence);
+
+		// waits for these commands only, not for everything submitted to the graphics queue
+		vkQueueSubmit(graphics_queue_, 1, &submitInfo, fence);
+		vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
+		vkDestroyFence(device_, fence, nullptr);
 
 		vkFreeCommandBuffers(device_, command_pool_, 1, OUT &commandBuffer);
 	}
@@ -76,8 +76,13 @@ namespace nvkg {
 			VkQueue graphics_queue() { return graphics_queue_; }
 			VkQueue present_queue() { return present_queue_; }
 			VkQueue compute_queue() { return compute_queue_; }
+			VkQueue transfer_queue() { return transfer_queue_; }
 
 			size_t get_device_alignment() { return properties.limits.minUniformBufferOffsetAlignment; }
+			size_t get_storage_alignment() { return properties.limits.minStorageBufferOffsetAlignment; }
+
+			// optional feature used by GPU driven rendering, enabled on device creation when supported
+			bool draw_indirect_first_instance() const { return draw_indirect_first_instance_; }
 			SwapChainSupportDetails::SwapChainSupportDetails get_swapchain_support() { return SwapChainSupportDetails::QuerySupport(physical_device_, surface_); }
 			
 			uint32_t find_mem_type(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -114,7 +119,9 @@ namespace nvkg {
 			VkDevice device_;
 			VkSurfaceKHR surface_;
 
-			VkQueue graphics_queue_, present_queue_, compute_queue_;
+			VkQueue graphics_queue_, present_queue_, compute_queue_, transfer_queue_;
+
+			bool draw_indirect_first_instance_ = false;
 
 			const std::array<const char*, 1> validation_layers = { "VK_LAYER_KHRONOS_validation" };
 			const std::array<const char*, 2> device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_SHADER_DRAW_PARAMETERS_EXTENSION_NAME };
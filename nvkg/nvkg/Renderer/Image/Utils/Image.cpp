@@ -1,4 +1,5 @@
 #include <nvkg/Renderer/Image/Utils/Image.hpp>
+#include <nvkg/Renderer/Device/UploadManager.hpp>
 
 VkImageView Image::create_image_view(VkDevice device,
                                    VkImage image,
@@ -153,8 +154,6 @@ namespace nvkg {
     }
 
     void VulkanImage::update_and_transfer(void *data, VkDeviceSize size_in_bytes) {
-        auto buf = device().begin_single_time_commands();
-
         VkImageSubresourceRange subresource_range = {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
             .baseMipLevel = 0,
@@ -162,16 +161,6 @@ namespace nvkg {
             .layerCount = this->array_layers,
         };
 
-        transform_img_layout(buf, image, subresource_range, initial_layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-        // move host data to transfer buffer
-        allocate_transfer_mem(size_in_bytes);
-        void *mapped_data;
-        vkMapMemory(device().device(), staging_memory_, 0, size_in_bytes, 0, &mapped_data);
-        memcpy(mapped_data, data, size_in_bytes);
-        vkUnmapMemory(device().device(), staging_memory_);
-        mapped_data = nullptr;
-
         const auto &format_info = format_info_table_.at(format);
 		const uint32_t block_size = format_info.block_size;
 		const uint32_t block_width = format_info.block_extent.width;
@@ -206,14 +195,8 @@ namespace nvkg {
 			}
 		}
 
-		vkCmdCopyBufferToImage(buf, staging_buffer_, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                               static_cast<uint32_t>(buffer_copy_regions.size()), buffer_copy_regions.data());
-
-        transform_img_layout(buf, image, subresource_range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        device().end_single_time_commands(buf);
-
-        vkDestroyBuffer(device().device(), staging_buffer_, nullptr);
-        vkFreeMemory(device().device(), staging_memory_, nullptr);
+		// staged and copied with the next batch of uploads, which also transitions the image for sampling
+		uploads().upload_image(image, data, size_in_bytes, buffer_copy_regions, subresource_range, initial_layout);
     }
 
     void VulkanImage::transform_img_layout(VkCommandBuffer command_buffer, VkImage image, VkImageSubresourceRange subresource_range,
@@ -224,30 +207,6 @@ namespace nvkg {
 		vkCmdPipelineBarrier(command_buffer, old_stage, new_stage, 0, 0, nullptr, 0, nullptr, 1, &memory_barrier);
     }
 
-    void VulkanImage::allocate_transfer_mem(VkDeviceSize size_in_bytes) {
-        VkBufferCreateInfo buffer_create_info = {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .flags = 0,
-            .size = size_in_bytes,
-            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        };
-
-		vkCreateBuffer(device().device(), &buffer_create_info, nullptr, &staging_buffer_);
-
-		VkMemoryRequirements memory_requirements = {};
-		vkGetBufferMemoryRequirements(device().device(), staging_buffer_, &memory_requirements);
-
-        VkMemoryAllocateInfo memory_alloc_info = {
-            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            .allocationSize = memory_requirements.size,
-            .memoryTypeIndex = device().find_mem_type(memory_requirements.memoryTypeBits,  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
-        };
-        
-		vkAllocateMemory(device().device(), &memory_alloc_info, nullptr, &staging_memory_);
-		vkBindBufferMemory(device().device(), staging_buffer_, staging_memory_, 0);
-    }
-
     VkImageMemoryBarrier VulkanImage::det_access_masks(VkImage image, VkImageSubresourceRange subresource_range, VkImageLayout old_layout, VkImageLayout new_layout) {
         VkImageMemoryBarrier memory_barrier = {};
         memory_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
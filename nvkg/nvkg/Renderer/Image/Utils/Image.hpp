@@ -72,8 +72,6 @@ namespace nvkg {
 
 
     private:
-        VkBuffer staging_buffer_ = VK_NULL_HANDLE; // freed after staging
-		VkDeviceMemory staging_memory_ = VK_NULL_HANDLE; // freed after staging
 		VkDeviceMemory image_memory_ = VK_NULL_HANDLE;
 
         std::unordered_map<VkFormat, FormatInfo> format_info_table_ = {
@@ -105,8 +103,6 @@ namespace nvkg {
             { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_SPARSE_BINDING_BIT | VK_QUEUE_PROTECTED_BIT },
         };
 
-        void allocate_transfer_mem(VkDeviceSize size_in_bytes);
-
         void transform_img_layout(VkCommandBuffer command_buffer, VkImage image, VkImageSubresourceRange subresource_range,
                         VkImageLayout old_layout, VkImageLayout new_layout);
 
@@ -3,8 +3,25 @@
 #include <nvkg/Renderer/Swapchain/Swapchain.hpp>
 #include <nvkg/Renderer/Utils/Descriptor.hpp>
 
+#include <cstring>
+
 namespace nvkg {
 
+    namespace {
+        // buffer resources are bound with offsets into the uniform ring that change every frame
+        VkDescriptorType dynamic_descriptor_type(VkDescriptorType type) {
+            switch(type) {
+                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+                default: return type;
+            }
+        }
+
+        VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
     /* MaterialManager */
 
     std::vector<std::unique_ptr<Material>> MaterialManager::materials_ = []{
@@ -21,14 +38,24 @@ namespace nvkg {
 
     material_id MaterialManager::next_id_ = 0;
 
+    std::unique_ptr<frame_ring_buffer> MaterialManager::uniform_ring_ = nullptr;
+
+    std::vector<MaterialManager::uniform_range> MaterialManager::uniform_ranges_ = []{
+        return std::vector<MaterialManager::uniform_range>();
+    }();
+
+    VkDeviceSize MaterialManager::uniform_head_ = 0;
+
     const material_handle MaterialManager::create(const material_config mc) {
         if (!recycled_ids_.empty()) {
             auto id = recycled_ids_.back();
             recycled_ids_.pop_back();
             materials_[id].reset(new Material(mc));
+            materials_[id]->uniform_offset_ = reserve_uniforms(id, materials_[id]->buffer_size);
             return material_handle{ id, generations_[id] };
         }
         materials_.emplace_back(new Material(mc));
+        materials_.back()->uniform_offset_ = reserve_uniforms(next_id_, materials_.back()->buffer_size);
         auto handle = material_handle{ next_id_++ };
         generations_.emplace_back();
         return handle;
@@ -60,6 +87,41 @@ namespace nvkg {
 
     const void MaterialManager::cleanup() noexcept {
         materials_.clear();
+        uniform_ring_.reset();
+        uniform_ranges_.clear();
+        uniform_head_ = 0;
+    }
+
+    frame_ring_buffer& MaterialManager::uniform_ring() {
+        if(!uniform_ring_) {
+            uniform_ring_ = std::make_unique<frame_ring_buffer>(uniform_ring_bytes,
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false);
+        }
+        return *uniform_ring_;
+    }
+
+    VkDeviceSize MaterialManager::reserve_uniforms(material_id id, VkDeviceSize size) {
+        if(size == 0) return 0;
+
+        if(id < uniform_ranges_.size() && size <= uniform_ranges_[id].size_) return uniform_ranges_[id].offset_;
+
+        const auto alignment = std::max(device().get_device_alignment(), device().get_storage_alignment());
+        const auto offset = align_up(uniform_head_, alignment);
+        NVKG_ASSERT(offset + size <= uniform_ring_bytes, "Uniform ring is out of space, " << size << " bytes requested with "
+            << uniform_ring_bytes - uniform_head_ << " of " << uniform_ring_bytes << " bytes left");
+
+        uniform_head_ = offset + size;
+        if(id >= uniform_ranges_.size()) uniform_ranges_.resize(id + 1);
+        uniform_ranges_[id] = { offset, size };
+        return offset;
+    }
+
+    void MaterialManager::upload_uniforms(uint32_t frame_index) {
+        const auto& ring = uniform_ring();
+
+        for(auto& material : materials_) {
+            if(material) material->upload_uniforms(ring, frame_index);
+        }
     }
 
     /* Material */
@@ -90,9 +152,6 @@ namespace nvkg {
         pipeline.destroy();
         
         vkDestroyPipelineLayout(device().device(), pipeline_layout, nullptr);
-        
-        if(buffer_size > 0)
-            Buffer::destroy_buffer(buffer);
 
         for(auto& [stage, shader] : shaders) {
             shader.reset();
@@ -100,7 +159,8 @@ namespace nvkg {
     }
 
     void Material::bind(VkCommandBuffer commandBuffer) {
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, descriptor_sets.size(), descriptor_sets.data(), 0, nullptr);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, descriptor_sets.size(), descriptor_sets.data(),
+            dynamic_offsets_.size(), dynamic_offsets_.data());
     
         pipeline.bind(commandBuffer);
     }
@@ -269,10 +329,10 @@ namespace nvkg {
                     img_counter++;
 
                 } else {
-                    //storage/uniform
+                    //storage/uniform, the offset into the uniform ring is passed when binding
                     descriptor_buffer_infos[buf_counter] = {
-                        .buffer = buffer.buffer,
-                        .offset = prop.offset,
+                        .buffer = MaterialManager::uniform_ring().buffer(),
+                        .offset = 0,
                         .range = prop.size * prop.dyn_count,
                     };
 
@@ -294,6 +354,35 @@ namespace nvkg {
         }
 
         vkUpdateDescriptorSets(device().device(), static_cast<uint32_t>(write_sets.size()), write_sets.data(), 0, NULL);
+
+        // dynamic offsets are consumed in set order, then in binding order within a set
+        for(const auto& [k, v] : resources_per_set) {
+            std::vector<const ShaderResource*> buffers;
+            for(const auto& prop : v) {
+                if(prop.type != VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) buffers.push_back(&prop);
+            }
+            std::sort(buffers.begin(), buffers.end(), [](const ShaderResource* lhs, const ShaderResource* rhs) { return lhs->binding < rhs->binding; });
+
+            for(const auto* prop : buffers) {
+                resource_offsets_.push_back(prop->offset);
+            }
+        }
+        dynamic_offsets_.assign(resource_offsets_.begin(), resource_offsets_.end());
+    }
+
+    void Material::upload_uniforms(const frame_ring_buffer& ring, uint32_t frame_index) {
+        if(buffer_size == 0) return;
+
+        const auto allocation = ring.at(frame_index, uniform_offset_);
+        const auto frame_bit = 1u << frame_index;
+        if(dirty_frames_ & frame_bit) {
+            std::memcpy(allocation.data_, uniform_data_.data(), buffer_size);
+            dirty_frames_ &= ~frame_bit;
+        }
+
+        for(std::size_t i = 0; i < resource_offsets_.size(); i++) {
+            dynamic_offsets_[i] = static_cast<uint32_t>(allocation.offset_ + resource_offsets_[i]);
+        }
     }
 
     void Material::set_shader_props(const std::unique_ptr<ShaderModule>& shader, uint64_t& offset, uint16_t& res_counter) {
@@ -313,6 +402,7 @@ namespace nvkg {
             map_index = ((map_index & index_mask) | (res_counter << 8)) | ((map_index & set_mask) | res.set);
 
             res.offset = offset;
+            res.type = dynamic_descriptor_type(res.type);
 
             resources_per_set[map_index].push_back(res);
 
@@ -326,7 +416,9 @@ namespace nvkg {
         for(const auto& [k, v] : resources_per_set) {
             for(auto& prop : v) {
                 if(prop.id == id) {
-                    Buffer::copy_data(buffer, dataSize, data, prop.offset);
+                    NVKG_ASSERT(prop.offset + dataSize <= buffer_size, "Uniform data exceeds the size of the resource");
+                    std::memcpy(uniform_data_.data() + prop.offset, data, dataSize);
+                    dirty_frames_ = ~0u;
                     return;
                 }
             }
@@ -362,7 +454,9 @@ namespace nvkg {
             if(v.empty()) continue;
             for(auto& prop : v) {
                 if(prop.id == id) {
-                    Buffer::copy_data(buffer, dataSize, data, prop.offset);
+                    NVKG_ASSERT(prop.offset + dataSize <= buffer_size, "Uniform data exceeds the size of the resource");
+                    std::memcpy(uniform_data_.data() + prop.offset, data, dataSize);
+                    dirty_frames_ = ~0u;
                     return;
                 }
             }
@@ -381,15 +475,7 @@ namespace nvkg {
             set_shader_props(shader, OUT offset, counter);
         }
 
-        if(buffer_size > 0) {
-            Buffer::create_buffer(
-                buffer_size,
-                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                OUT buffer.buffer,
-                OUT buffer.bufferMemory
-            );
-        }
+        uniform_data_.resize(buffer_size);
 
         logger::debug() << "Retrieved " << resources_per_set.size() << " resources from shaders";
 
@@ -3,6 +3,7 @@
 #include <nvkg/Renderer/Core.hpp>
 #include <nvkg/Renderer/Pipeline/Pipeline.hpp>
 #include <nvkg/Renderer/Buffer/Buffer.hpp>
+#include <nvkg/Renderer/Buffer/RingBuffer.hpp>
 #include <nvkg/Renderer/Shader/Shader.hpp>
 #include <nvkg/Renderer/DescriptorPool/DescriptorPool.hpp>
 #include <nvkg/Renderer/Texture/TextureManager.hpp>
@@ -91,8 +92,40 @@ namespace nvkg {
             /// @brief destructs all materials. called at program close 
             static const void cleanup() noexcept;
 
+            /// @brief writes the uniform data of materials changed since the frame's region was last written into it and
+            /// points every material at the region. has to be called once per frame after the last set_uniform_data and
+            /// before the frame's command buffers are recorded
+            /// @param frame_index index of the frame in flight
+            static void upload_uniforms(uint32_t frame_index);
+
         private:
 
+            friend Material;
+
+            /// @brief uniform and storage buffer data of all materials, bound with dynamic offsets. created with the
+            /// first material, fixed size since material descriptors point to it
+            static frame_ring_buffer& uniform_ring();
+
+            /// @brief reserves the place of a material's uniform data in every region of the uniform ring. a recycled
+            /// id keeps the place of the material it had before if the data fits
+            /// @param id material id
+            /// @param size bytes of uniform data
+            /// @return offset from the start of a region
+            static VkDeviceSize reserve_uniforms(material_id id, VkDeviceSize size);
+
+            static constexpr VkDeviceSize uniform_ring_bytes = 256 * 1024;
+
+            static std::unique_ptr<frame_ring_buffer> uniform_ring_;
+
+            struct uniform_range {
+                VkDeviceSize offset_{0};
+                VkDeviceSize size_{0};
+            };
+
+            // places reserved in the uniform ring indexed by material id, and the end of the last one
+            static std::vector<uniform_range> uniform_ranges_;
+            static VkDeviceSize uniform_head_;
+
             static std::vector<material_id> recycled_ids_;
             static std::vector<material_generation> generations_;
             static material_id next_id_;
@@ -114,6 +147,11 @@ namespace nvkg {
 
             ~Material();
 
+            /**
+             * @brief Sets the data of a uniform or storage buffer. The data is kept on the CPU and written into the
+             * uniform ring by MaterialManager::upload_uniforms(), so frames in flight keep reading their own copy. Each
+             * region of the ring is written once per change, not every frame.
+             **/
             void set_uniform_data(Utils::StringId id, VkDeviceSize dataSize, const void* data);
             void set_uniform_data(const char* name, VkDeviceSize dataSize, const void* data);
 
@@ -135,12 +173,24 @@ namespace nvkg {
             void prepare_desc_set_layouts();
             void prepare_pipeline();
             void setup_descriptor_sets();
+            void upload_uniforms(const frame_ring_buffer& ring, uint32_t frame_index);
 
             std::map<VkShaderStageFlagBits, std::unique_ptr<ShaderModule>> shaders;
 
-            Buffer::Buffer buffer { VK_NULL_HANDLE };
+            // uniform and storage buffer data of all resources, uploaded to the uniform ring when changed
+            std::vector<std::byte> uniform_data_{};
             uint64_t buffer_size = 0;
 
+            // place of uniform_data_ in every region of the uniform ring, and one bit per frame in flight whose region
+            // doesn't hold the current data yet
+            VkDeviceSize uniform_offset_ = 0;
+            uint32_t dirty_frames_ = ~0u;
+
+            // offsets of buffer resources in uniform_data_ and their dynamic offsets of the current frame, both in
+            // the order bind() has to pass dynamic offsets in
+            std::vector<uint64_t> resource_offsets_{};
+            std::vector<uint32_t> dynamic_offsets_{};
+
             /*  
             * Holds all shader resources as internal properties
             * First 8 bits are continuous index, last 8 bits are actual descriptor set
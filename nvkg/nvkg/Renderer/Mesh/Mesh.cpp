@@ -24,9 +24,6 @@ namespace nvkg {
         vertex_count_ = meshData.vertexCount;
         index_count_ = meshData.indexCount;
 
-        vertex_buffer_.init_staging_buffer(meshData.vertexSize * meshData.vertexCount);
-        index_buffer_.init_staging_buffer(sizeof(uint32_t) * meshData.indexCount);
-
         has_vertex_buffer_ = meshData.vertexCount > 0;
 
         if(has_vertex_buffer_) vertex_buffer_.create_buffer(meshData.vertices, (meshData.vertexSize * meshData.vertexCount));
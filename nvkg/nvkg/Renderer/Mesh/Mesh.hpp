@@ -2,6 +2,7 @@
 
 #include <nvkg/Renderer/Core.hpp>
 #include <nvkg/Renderer/Buffer/Buffer.hpp>
+#include <nvkg/Renderer/Device/UploadManager.hpp>
 #include <nvkg/Renderer/Pipeline/PipelineConfig.hpp>
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -29,8 +30,11 @@ namespace nvkg {
     bool operator==(const Vertex& left, const Vertex& right);
     bool operator==(const Vertex2D& left, const Vertex2D& right);
 
+    /**
+     * @brief Device local buffer filled through the upload manager, the data is copied with the next frame.
+     **/
     struct staged_buffer {
-        Buffer::Buffer staging_buffer_, buffer_;
+        Buffer::Buffer buffer_;
         VkBufferUsageFlagBits buffer_usage_;
 
         staged_buffer(VkBufferUsageFlagBits buffer_usage) {
@@ -38,24 +42,15 @@ namespace nvkg {
         }
 
         ~staged_buffer() {
-            Buffer::destroy_buffer(staging_buffer_);
             Buffer::destroy_buffer(buffer_);
         }
 
-        void init_staging_buffer(VkDeviceSize size) {
-            Buffer::create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-                staging_buffer_.buffer, staging_buffer_.bufferMemory);
-        }
-
         void create_buffer(const void* data, std::size_t size) {
             if(size == 0) {
                 logger::debug(logger::Level::Error) << "Tried creating buffer with zero data";
                 return;
             }
 
-            Buffer::copy_data(staging_buffer_, size, data);
-
             Buffer::create_buffer(
                 size,
                 buffer_usage_ | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
@@ -65,17 +60,17 @@ namespace nvkg {
                 OUT buffer_.bufferMemory
             );
 
-            Buffer::copy_buffer(staging_buffer_.buffer, buffer_.buffer, size);
+            uploads().upload_buffer(buffer_.buffer, data, size);
         }
 
+        // frames in flight may still read the buffer, the copy is ordered after them
         void update(const void* data, std::size_t size) {
             if(size == 0) {
                 logger::debug(logger::Level::Error) << "Tried updating buffer with zero data";
                 return;
             } 
 
-            Buffer::copy_data(staging_buffer_, size, data);
-            Buffer::copy_buffer(staging_buffer_.buffer, buffer_.buffer, size);
+            uploads().update_buffer(buffer_.buffer, data, size);
         }
     };
 
@@ -38,6 +38,7 @@ namespace nvkg {
     Model::~Model() {}
 
     void Model::LoadModelFromFile(const char* filePath) {
+        mem_profiler::scope profile(mem_profiler::tag::assets);
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
@@ -91,6 +92,21 @@ namespace nvkg {
             }
         }
 
+        // sphere around the centre of the bounding box, not minimal but cheap
+        if (!objVertices.empty()) {
+            glm::vec3 min = objVertices[0].position, max = objVertices[0].position;
+            for (const auto& vertex : objVertices) {
+                min = glm::min(min, vertex.position);
+                max = glm::max(max, vertex.position);
+            }
+
+            bounds_.center_ = (min + max) * 0.5f;
+            bounds_.radius_ = 0.0f;
+            for (const auto& vertex : objVertices) {
+                bounds_.radius_ = glm::max(bounds_.radius_, glm::length(vertex.position - bounds_.center_));
+            }
+        }
+
         mesh_.load_vertices(
             {
                 sizeof(Vertex),
@@ -4,6 +4,7 @@
 #include <nvkg/Renderer/Utils/Hash.hpp>
 #include <nvkg/Renderer/Mesh/Mesh.hpp>
 #include <nvkg/Renderer/Material/Material.hpp>
+#include <nvkg/Renderer/Utils/Math.hpp>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #define GLM_FORCE_RADIANS
@@ -42,12 +43,19 @@ namespace nvkg {
             uint32_t get_index_count() { return mesh_.get_index_count(); }
             uint32_t get_vertex_count() { return mesh_.get_vertex_count(); }
 
+            /**
+             * @brief Returns the bounds used for culling. Computed for models loaded from file, models created from
+             * mesh data are unbounded until set_bounds() is called.
+             **/
+            const bounding_sphere& get_bounds() const { return bounds_; }
+            void set_bounds(const bounding_sphere& bounds) { bounds_ = bounds; }
+
             Mesh mesh_;
 
         private:
 
             void LoadModelFromFile(const char* filePath);
 
-            
+            bounding_sphere bounds_{};
     };
 }
@@ -64,6 +64,26 @@ namespace nvkg {
             == VK_SUCCESS, "Failed to create graphics pipeline!")
     }
 
+    void Pipeline::create_compute_pipeline(const PipelineConfig::ShaderConfig& shader, VkPipelineLayout pipeline_layout) {
+
+        NVKG_ASSERT(pipeline_layout != VK_NULL_HANDLE, "Cannot create compute pipeline without a valid layout!");
+        NVKG_ASSERT(shader.stage == VK_SHADER_STAGE_COMPUTE_BIT, "Compute pipelines need a compute shader!");
+
+        shader_modules[0] = shader.shader_module;
+        shader_module_count = 1;
+        bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+
+        VkComputePipelineCreateInfo pipelineCI{};
+        pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineCI.stage = PipelineConfig::create_shader_stage(shader.stage, shader.shader_module);
+        pipelineCI.layout = pipeline_layout;
+        pipelineCI.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineCI.basePipelineIndex = -1;
+
+        NVKG_ASSERT(vkCreateComputePipelines(device().device(), VK_NULL_HANDLE, 1, &pipelineCI, nullptr, OUT &pipeline)
+            == VK_SUCCESS, "Failed to create compute pipeline!")
+    }
+
     void Pipeline::clear() {
         for (size_t i = 0; i < shader_module_count; i++) {
             vkDestroyShaderModule(device().device(), shader_modules[i], nullptr);
@@ -78,7 +98,7 @@ namespace nvkg {
     }
 
     void Pipeline::bind(VkCommandBuffer commandBuffer) {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        vkCmdBindPipeline(commandBuffer, bind_point, pipeline);
     }
 
     PipelineInit Pipeline::default_pipeline_init() {
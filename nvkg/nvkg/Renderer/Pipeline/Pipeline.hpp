@@ -180,11 +180,17 @@ namespace nvkg {
                 const PipelineInit& p_config
             );
 
+            void create_compute_pipeline(
+                const PipelineConfig::ShaderConfig& shader,
+                VkPipelineLayout pipeline_layout
+            );
+
         private:
 
             static constexpr size_t MAX_SHADER_MODULES = 2;
 
             VkPipeline pipeline;
+            VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
 
             VkShaderModule shader_modules[MAX_SHADER_MODULES];
             size_t shader_module_count = 0; 
@@ -11,7 +11,7 @@ namespace nvkg {
     }
 
     void RenderPass::Begin(VkRenderPass renderPass, VkCommandBuffer commandBuffer, VkFramebuffer frameBuffer, VkOffset2D offset, VkExtent2D extent,
-                      VkClearValue *clearValues, uint32_t clearValueCount) {
+                      VkClearValue *clearValues, uint32_t clearValueCount, VkSubpassContents contents) {
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         renderPassInfo.renderPass = renderPass;
@@ -23,7 +23,7 @@ namespace nvkg {
         renderPassInfo.clearValueCount = clearValueCount;
         renderPassInfo.pClearValues = clearValues;
 
-        vkCmdBeginRenderPass(OUT commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBeginRenderPass(OUT commandBuffer, &renderPassInfo, contents);
     }
 
     void RenderPass::End(VkCommandBuffer commandBuffer) {
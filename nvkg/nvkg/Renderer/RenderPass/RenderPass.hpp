@@ -144,6 +144,7 @@ namespace nvkg {
          * @param extent The size of the rendered area.
          * @param clearValues A list of clear values. When a frame is cleared, Vulkan will fill the space with the colors specified here
          * @param clearValueCount The number of clear values provided
+         * @param contents Whether the first subpass is recorded inline or executed from secondary command buffers
          */
         static void Begin(VkRenderPass renderPass,
                           VkCommandBuffer commandBuffer,
@@ -151,7 +152,8 @@ namespace nvkg {
                           VkOffset2D offset,
                           VkExtent2D extent,
                           VkClearValue* clearValues,
-                          uint32_t clearValueCount);
+                          uint32_t clearValueCount,
+                          VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 
         /**
          * @brief Ends the RenderPass. Calling this will consolidate all the rendering data into the RenderPass and allow
@@ -0,0 +1,330 @@
+#include <nvkg/Renderer/Renderer/IndirectRenderer.hpp>
+#include <nvkg/Renderer/Utils/Math.hpp>
+#include <nvkg/Renderer/Device/UploadManager.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace nvkg {
+
+    namespace {
+        // Creates a device local buffer holding data, copied before the frame's culling runs
+        void upload(Buffer::Buffer& dst, VkBufferUsageFlags usage, const void* data, VkDeviceSize size) {
+            Buffer::create_buffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                OUT dst.buffer, OUT dst.bufferMemory);
+            dst.size = size;
+
+            uploads().upload_buffer(dst.buffer, data, size);
+        }
+
+        void create_device_local(Buffer::Buffer& dst, VkBufferUsageFlags usage, VkDeviceSize size) {
+            Buffer::create_buffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, OUT dst.buffer, OUT dst.bufferMemory);
+            dst.size = size;
+        }
+
+        void memory_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+            VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = src_access;
+            barrier.dstAccessMask = dst_access;
+            vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+    }
+
+    indirect_renderer::~indirect_renderer() {
+        if(!initialized_) return;
+
+        // no frame is in flight anymore once the renderer is destroyed
+        retire_buffers();
+        release_retired(true);
+
+        pipeline_->destroy();
+        vkDestroyPipelineLayout(device().device(), pipeline_layout_, nullptr);
+        vkDestroyDescriptorSetLayout(device().device(), set_layout_, nullptr);
+    }
+
+    void indirect_renderer::init() {
+        static_assert(sizeof(cull_instance) == 48, "cull_instance has to match the std430 layout of indirect_cull.comp");
+        static_assert(sizeof(transform_3d) == 9 * sizeof(float), "visible instances are written as 9 floats");
+
+        ShaderModule shader("indirect_cull.comp");
+
+        std::array<VkDescriptorSetLayoutBinding, 4> bindings;
+        for(uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i] = descriptors::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, i);
+        }
+
+        VkDescriptorSetLayoutCreateInfo layout_info = descriptors::descriptor_set_layout_create_info(bindings.data(), bindings.size());
+        NVKG_ASSERT(vkCreateDescriptorSetLayout(device().device(), &layout_info, nullptr, OUT &set_layout_) == VK_SUCCESS,
+            "Failed to create culling descriptor set layout");
+
+        VkPushConstantRange push_constant_range { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(frustum_push_constant) };
+        PipelineConfig::create_pipeline_layout(device().device(), OUT &pipeline_layout_, &set_layout_, 1, &push_constant_range, 1);
+
+        pipeline_ = std::make_unique<Pipeline>();
+        pipeline_->create_compute_pipeline({ VK_SHADER_STAGE_COMPUTE_BIT, shader.shader_module }, pipeline_layout_);
+
+        std::array<VkDescriptorSetLayout, SwapChain::MAX_FRAMES_IN_FLIGHT> set_layouts;
+        set_layouts.fill(set_layout_);
+        VkDescriptorSetAllocateInfo alloc_info = descriptors::descriptor_set_allocate_info(DescriptorPool::get_descr_pool(), set_layouts.data(), set_layouts.size());
+        NVKG_ASSERT(vkAllocateDescriptorSets(device().device(), &alloc_info, OUT sets_.data()) == VK_SUCCESS,
+            "Failed to allocate culling descriptor sets");
+
+        initialized_ = true;
+    }
+
+    void indirect_renderer::prepare(const CameraNew& camera, ecs::registry& registry, uint32_t frame_index) {
+        NVKG_ASSERT(frame_index < SwapChain::MAX_FRAMES_IN_FLIGHT, "Frame index " << frame_index << " is out of range");
+        if(!initialized_) init();
+
+        frame_count_++;
+        release_retired(false);
+
+        // components accessed mutably stamp their chunks, so edited instance data is picked up here
+        const auto members = registry.view<const shared_render_mesh&, const instance_data&>().count();
+        if(members != member_count_ || !update_changed(registry)) {
+            rebuild(registry);
+        }
+
+        // the frame's fence was waited for, so its descriptor set can point to the current buffers
+        frame_index_ = frame_index;
+        if(!groups_.empty() && set_generations_[frame_index] != generation_) {
+            write_descriptor_set(sets_[frame_index]);
+            set_generations_[frame_index] = generation_;
+        }
+
+        frustum_.planes_ = Utils::Math::frustum_planes(camera.matrices.perspective * camera.matrices.view);
+
+        // accept changes stamped with the current tick next time, they may happen after this call
+        last_tick_ = registry.tick() - 1;
+    }
+
+    bool indirect_renderer::update_changed(ecs::registry& registry) {
+        const auto& const_registry = std::as_const(registry);
+        changed_ranges_.clear();
+
+        // a changed mesh may move its entity to another group
+        bool known = true;
+        registry.view<const shared_render_mesh&>().changed_since(last_tick_).each_chunk(
+            [&](std::span<const ecs::entity> entities, std::span<const shared_render_mesh>) {
+                known = known && (entities.empty() || !const_registry.has<instance_data>(entities[0]));
+            });
+        if(!known) return false;
+
+        // instance data and world transforms are written in place, unless the instance count changed
+        const auto mark = [&](std::span<const ecs::entity> entities, std::span<const instance_data> instances) {
+            for(std::size_t i = 0; i < entities.size() && known; i++) {
+                const auto id = entities[i].id();
+                if(!range_index_.contains(id) || range_index_[id] == 0 || ranges_[range_index_[id] - 1].entity_ != entities[i]) {
+                    known = false; // replaced a destroyed entity without changing the member count
+                    break;
+                }
+                const auto r = range_index_[id] - 1;
+                const auto count = std::min<std::size_t>(instances[i].instance_count_, instances[i].instance_data_.size());
+                known = count == ranges_[r].count_;
+                changed_ranges_.push_back(r);
+            }
+        };
+        registry.view<const shared_render_mesh&, const instance_data&>().changed_since(last_tick_).each_chunk(
+            [&](std::span<const ecs::entity> entities, std::span<const shared_render_mesh>, std::span<const instance_data> instances) {
+                mark(entities, instances);
+            });
+        registry.view<const shared_render_mesh&, const instance_data&, const world_transform&>().changed_since(last_tick_).each_chunk(
+            [&](std::span<const ecs::entity> entities, std::span<const shared_render_mesh>, std::span<const instance_data> instances, std::span<const world_transform>) {
+                mark(entities, instances);
+            });
+        if(!known) return false;
+
+        std::sort(changed_ranges_.begin(), changed_ranges_.end());
+        changed_ranges_.erase(std::unique(changed_ranges_.begin(), changed_ranges_.end()), changed_ranges_.end());
+
+        // adjacent ranges are adjacent in the instance buffer, every run of them becomes one update
+        for(std::size_t first = 0; first < changed_ranges_.size();) {
+            auto last = first + 1;
+            while(last < changed_ranges_.size() && changed_ranges_[last] == changed_ranges_[last - 1] + 1) last++;
+
+            const auto& first_range = ranges_[changed_ranges_[first]];
+            const auto& last_range = ranges_[changed_ranges_[last - 1]];
+            changed_instances_.resize(last_range.first_ + last_range.count_ - first_range.first_);
+            for(auto i = first; i < last; i++) {
+                const auto& range = ranges_[changed_ranges_[i]];
+                const auto* world = const_registry.has<world_transform>(range.entity_) ? &const_registry.get<world_transform>(range.entity_) : nullptr;
+                write_instances(range, const_registry.get<instance_data>(range.entity_), world,
+                    changed_instances_.data() + (range.first_ - first_range.first_));
+            }
+
+            if(!changed_instances_.empty()) {
+                uploads().update_buffer(instances_.buffer, changed_instances_.data(), sizeof(cull_instance) * changed_instances_.size(),
+                    sizeof(cull_instance) * first_range.first_);
+            }
+            first = last;
+        }
+        return true;
+    }
+
+    void indirect_renderer::write_instances(const instance_range& range, const instance_data& instances,
+        const world_transform* world, cull_instance* out) {
+        for(uint32_t i = 0; i < range.count_; i++) {
+            // instances of entities with a world_transform are relative to the entity
+            const auto t = world ? to_world(*world, instances.instance_data_[i]) : instances.instance_data_[i];
+            out[i] = {t.position_, range.group_, t.scale_, 0.0f, t.rotation_, 0.0f};
+        }
+    }
+
+    void indirect_renderer::rebuild(ecs::registry& registry) {
+        struct entry {
+            ecs::entity entity_;
+            const shared_render_mesh* mesh_;
+            const instance_data* instances_;
+            const world_transform* world_;
+        };
+
+        std::vector<entry> entries;
+        registry.each([&](const ecs::entity& e, const shared_render_mesh& srm, const instance_data& id) {
+            entries.push_back({e, &srm, &id, registry.has<world_transform>(e) ? &std::as_const(registry).get<world_transform>(e) : nullptr});
+        });
+
+        // entities sharing model and material become one group
+        std::sort(entries.begin(), entries.end(), [](const entry& lhs, const entry& rhs) {
+            if(lhs.mesh_->material_ != rhs.mesh_->material_) return lhs.mesh_->material_ < rhs.mesh_->material_;
+            return lhs.mesh_->model_.get() < rhs.mesh_->model_.get();
+        });
+
+        groups_.clear();
+        ranges_.clear();
+        range_index_.clear();
+        std::vector<cull_instance> instances;
+        std::vector<glm::vec4> bounds;
+
+        for(const auto& e : entries) {
+            if(groups_.empty() || groups_.back().material_ != e.mesh_->material_ || groups_.back().model_ != e.mesh_->model_) {
+                groups_.push_back({e.mesh_->model_, e.mesh_->material_, static_cast<uint32_t>(instances.size()), 0});
+
+                const auto& sphere = e.mesh_->model_->get_bounds();
+                bounds.emplace_back(sphere.center_, sphere.radius_);
+            }
+
+            const auto count = std::min<std::size_t>(e.instances_->instance_count_, e.instances_->instance_data_.size());
+            const instance_range range{e.entity_, static_cast<uint32_t>(groups_.size() - 1), static_cast<uint32_t>(instances.size()), static_cast<uint32_t>(count)};
+            instances.resize(instances.size() + count);
+            write_instances(range, *e.instances_, e.world_, instances.data() + range.first_);
+
+            ranges_.push_back(range);
+            range_index_.ensure(e.entity_.id()) = static_cast<uint32_t>(ranges_.size());
+            groups_.back().instance_count_ += static_cast<uint32_t>(count);
+        }
+
+        std::vector<VkDrawIndexedIndirectCommand> commands(groups_.size());
+        for(std::size_t g = 0; g < groups_.size(); g++) {
+            commands[g] = { groups_[g].model_->get_index_count(), 0, 0, 0, groups_[g].first_instance_ };
+        }
+
+        // frames in flight may still use the buffers, their descriptor sets are pointed to the new ones when their
+        // frame comes up again
+        retire_buffers();
+        generation_++;
+
+        member_count_ = entries.size();
+        frustum_.instance_count_ = static_cast<uint32_t>(instances.size());
+
+        if(instances.empty()) {
+            groups_.clear();
+            return;
+        }
+
+        upload(instances_, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instances.data(), sizeof(cull_instance) * instances.size());
+        upload(bounds_, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, bounds.data(), sizeof(glm::vec4) * bounds.size());
+        upload(command_template_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, commands.data(), sizeof(VkDrawIndexedIndirectCommand) * commands.size());
+
+        create_device_local(commands_,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            sizeof(VkDrawIndexedIndirectCommand) * groups_.size());
+        create_device_local(visible_,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            sizeof(transform_3d) * instances.size());
+    }
+
+    void indirect_renderer::retire_buffers() {
+        retired_buffers retired{{}, frame_count_};
+        std::size_t i = 0;
+        for(auto* buffer : {&instances_, &bounds_, &command_template_, &commands_, &visible_}) {
+            retired.buffers_[i++] = *buffer;
+            *buffer = {};
+        }
+        retired_.push_back(retired);
+    }
+
+    void indirect_renderer::release_retired(bool all) {
+        std::erase_if(retired_, [this, all](retired_buffers& retired) {
+            if(!all && frame_count_ - retired.frame_ < SwapChain::MAX_FRAMES_IN_FLIGHT) return false;
+            for(auto& buffer : retired.buffers_) {
+                Buffer::destroy_buffer(buffer);
+            }
+            return true;
+        });
+    }
+
+    void indirect_renderer::write_descriptor_set(VkDescriptorSet set) {
+        std::array<VkDescriptorBufferInfo, 4> buffer_infos = {{
+            { instances_.buffer, 0, VK_WHOLE_SIZE },
+            { bounds_.buffer, 0, VK_WHOLE_SIZE },
+            { commands_.buffer, 0, VK_WHOLE_SIZE },
+            { visible_.buffer, 0, VK_WHOLE_SIZE },
+        }};
+
+        std::array<VkWriteDescriptorSet, 4> write_sets;
+        for(uint32_t i = 0; i < write_sets.size(); i++) {
+            write_sets[i] = descriptors::write_descriptor_set(set, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, i, &buffer_infos[i]);
+        }
+
+        vkUpdateDescriptorSets(device().device(), static_cast<uint32_t>(write_sets.size()), write_sets.data(), 0, nullptr);
+    }
+
+    void indirect_renderer::cull(VkCommandBuffer command_buffer) const {
+        if(groups_.empty()) return;
+
+        // the previous frame may still read the draw commands and visible instances
+        memory_barrier(command_buffer,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0);
+
+        VkBufferCopy region { 0, 0, command_template_.size };
+        vkCmdCopyBuffer(command_buffer, command_template_.buffer, commands_.buffer, 1, &region);
+
+        memory_barrier(command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        pipeline_->bind(command_buffer);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1, &sets_[frame_index_], 0, nullptr);
+        vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(frustum_push_constant), &frustum_);
+        vkCmdDispatch(command_buffer, (frustum_.instance_count_ + workgroup_size - 1) / workgroup_size, 1, 1);
+
+        memory_barrier(command_buffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    }
+
+    void indirect_renderer::record(VkCommandBuffer command_buffer, std::size_t first, std::size_t last) const {
+        if(first >= last) return;
+
+        VkDeviceSize offsets[1] = { 0 };
+        vkCmdBindVertexBuffers(command_buffer, INSTANCE_BUFFER_BIND_ID, 1, &visible_.buffer, offsets);
+
+        const material_handle* bound = nullptr;
+        for(std::size_t g = first; g < last; g++) {
+            const auto& group = groups_[g];
+            if(bound == nullptr || *bound != group.material_) {
+                MaterialManager::get(group.material_)->bind(command_buffer);
+                bound = &group.material_;
+            }
+            group.model_->bind(command_buffer, VERTEX_BUFFER_BIND_ID);
+
+            // groups without visible instances draw zero instances
+            const VkDeviceSize command_offset = g * sizeof(VkDrawIndexedIndirectCommand);
+            vkCmdDrawIndexedIndirect(command_buffer, commands_.buffer, command_offset, 1, sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+}
@@ -0,0 +1,170 @@
+#ifndef NVKG_INDIRECT_RENDERER_HPP
+#define NVKG_INDIRECT_RENDERER_HPP
+
+#include <nvkg/Renderer/Core.hpp>
+#include <nvkg/Renderer/Model/Model.hpp>
+#include <nvkg/Renderer/Camera/Camera.hpp>
+#include <nvkg/Components/component.hpp>
+#include <nvkg/Components/hierarchy.hpp>
+#include <nvkg/Renderer/Swapchain/Swapchain.hpp>
+#include <nvkg/ecs/detail/paged_table.hpp>
+
+#include <array>
+#include <span>
+#include <vector>
+
+namespace nvkg {
+
+    /**
+     * @brief GPU driven rendering of shared_render_mesh entities with instance_data.
+     *
+     * Instances of all entities are uploaded once into a single storage buffer, instances of entities with a
+     * world_transform are placed relative to it, see to_world(). When instance_data or world_transform components
+     * change, only the instance ranges of the changed entities are updated in place. The buffers are rebuilt when
+     * entities join or leave, a shared_render_mesh changes or an entity's instance count changes. Entities sharing a
+     * model and material form a draw group.
+     *
+     * Every frame a compute shader frustum culls all instances against the model bounds, appends the visible ones to
+     * their group's range of a compacted instance buffer and counts them in the group's VkDrawIndexedIndirectCommand.
+     * Each group is then drawn with one indirect draw of its command, a group without visible instances draws zero
+     * instances. Groups have their own vertex and index buffers, so they can't be merged into one multi-draw, but the
+     * CPU cost of a frame depends on the number of groups, not on the number of instances.
+     *
+     * Usage:
+     *
+     *      indirect.prepare(camera, registry);      // before the render pass
+     *      indirect.cull(command_buffer);           // outside of the render pass
+     *      indirect.record(command_buffer, 0, indirect.groups().size()); // inside the render pass
+     **/
+    class indirect_renderer {
+        public:
+
+            struct draw_group {
+                std::shared_ptr<Model> model_;
+                material_handle material_;
+                uint32_t first_instance_;
+                uint32_t instance_count_;
+            };
+
+            indirect_renderer() = default;
+            ~indirect_renderer();
+
+            indirect_renderer(const indirect_renderer&) = delete;
+            indirect_renderer& operator=(const indirect_renderer&) = delete;
+
+            /**
+             * @brief Returns true if the device supports the features needed, i.e. indirect draws with a first instance.
+             **/
+            static bool supported() { return device().draw_indirect_first_instance(); }
+
+            /**
+             * @brief Updates instances whose shared_render_mesh, instance_data or world_transform components changed since
+             * the last call and the frustum from the camera. Has to be called once per frame after waiting for the
+             * frame's fence, buffers replaced by a rebuild are destroyed once no frame in flight uses them.
+             *
+             * @param camera - camera to cull against.
+             * @param registry - registry owning the entities to draw.
+             * @param frame_index - index of the frame in flight, less than SwapChain::MAX_FRAMES_IN_FLIGHT.
+             **/
+            void prepare(const CameraNew& camera, ecs::registry& registry, uint32_t frame_index);
+
+            /**
+             * @brief Records the culling pass. Has to be recorded outside of a render pass, before record().
+             *
+             * @param command_buffer - primary command buffer of the frame.
+             **/
+            void cull(VkCommandBuffer command_buffer) const;
+
+            /**
+             * @brief Records the indirect draws of groups [first, last) inside the swapchain render pass.
+             *
+             * @param command_buffer - command buffer to record to.
+             * @param first - first group to draw.
+             * @param last - one past the last group to draw.
+             **/
+            void record(VkCommandBuffer command_buffer, std::size_t first, std::size_t last) const;
+
+            /**
+             * @brief Returns the draw groups, sorted by material.
+             **/
+            std::span<const draw_group> groups() const { return groups_; }
+
+        private:
+
+            // Layout of the Instances buffer of indirect_cull.comp (std430)
+            struct cull_instance {
+                glm::vec3 position_;
+                uint32_t group_;
+                glm::vec3 scale_;
+                float pad0_;
+                glm::vec3 rotation_;
+                float pad1_;
+            };
+
+            struct frustum_push_constant {
+                std::array<glm::vec4, 6> planes_;
+                uint32_t instance_count_;
+            };
+
+            // Instances of one entity, ranges are stored in group order so consecutive ranges are adjacent in the
+            // instance buffer
+            struct instance_range {
+                ecs::entity entity_;
+                uint32_t group_;
+                uint32_t first_;
+                uint32_t count_;
+            };
+
+            static constexpr uint32_t workgroup_size = 64;
+
+            void init();
+            void rebuild(ecs::registry& registry);
+            bool update_changed(ecs::registry& registry);
+            static void write_instances(const instance_range& range, const instance_data& instances,
+                const world_transform* world, cull_instance* out);
+            void retire_buffers();
+            void release_retired(bool all);
+            void write_descriptor_set(VkDescriptorSet set);
+
+            struct retired_buffers {
+                std::array<Buffer::Buffer, 5> buffers_;
+                uint64_t frame_; // frame_count_ when retired
+            };
+
+            std::vector<draw_group> groups_;
+            std::vector<instance_range> ranges_;
+            // range index + 1 of every entity ID, 0 for entities that are not drawn
+            ecs::detail::paged_table<uint32_t, ecs::entity_location_page_size> range_index_;
+            std::vector<uint32_t> changed_ranges_; // scratch of update_changed()
+            std::vector<cull_instance> changed_instances_;
+
+            Buffer::Buffer instances_{};        // cull_instance per instance
+            Buffer::Buffer bounds_{};           // model space bounding sphere per group
+            Buffer::Buffer command_template_{}; // draw commands with zero instances, copied to commands_ every frame
+            Buffer::Buffer commands_{};         // VkDrawIndexedIndirectCommand per group
+            Buffer::Buffer visible_{};          // transform_3d per visible instance, grouped
+
+            frustum_push_constant frustum_{};
+
+            VkDescriptorSetLayout set_layout_{VK_NULL_HANDLE};
+            // one per frame in flight, rewritten when the frame comes up after a rebuild
+            std::array<VkDescriptorSet, SwapChain::MAX_FRAMES_IN_FLIGHT> sets_{};
+            std::array<uint64_t, SwapChain::MAX_FRAMES_IN_FLIGHT> set_generations_{};
+            uint64_t generation_{0}; // rebuilds so far
+            uint32_t frame_index_{0};
+            VkPipelineLayout pipeline_layout_{VK_NULL_HANDLE};
+            std::unique_ptr<Pipeline> pipeline_;
+
+            // Number of entities drawn at the last rebuild
+            std::size_t member_count_{0};
+
+            // frames prepared so far, buffers are released MAX_FRAMES_IN_FLIGHT frames after being retired
+            uint64_t frame_count_{0};
+            std::vector<retired_buffers> retired_;
+
+            ecs::change_tick_t last_tick_{0};
+            bool initialized_{false};
+    };
+}
+
+#endif
@@ -1,5 +1,9 @@
 #include <nvkg/Renderer/Renderer/Renderer.hpp>
 
+#include <algorithm>
+#include <span>
+#include <utility>
+
 namespace nvkg {
 
     Renderer::Renderer() {
@@ -23,30 +27,130 @@ namespace nvkg {
 
     void Renderer::recreate_materials() {}
 
-    //if own render systems get to be defined make the availible through function that mirrors render function
+    void Renderer::set_gpu_driven(bool enabled) {
+        if(enabled && !indirect_renderer::supported()) {
+            logger::debug(logger::Level::Warning) << "GPU driven rendering is not supported by the device, drawing on the CPU";
+            enabled = false;
+        }
+        gpu_driven_ = enabled;
+    }
+
+    //if own render systems get to be defined make the availible through function that mirrors prepare and record
     //so that they have access to the params like registry, commandBuffer and camera
-    void Renderer::render(VkCommandBuffer& commandBuffer, std::shared_ptr<CameraNew> camera, ecs::registry& registry) {
-        const auto render_sys = [&](const shared_render_mesh& srm, const instance_data& id){
-            struct ubo {
-                glm::mat4 projection;
-                glm::mat4 modelview;
-                glm::vec4 light_pos = {0.0f, -5.0f, 0.0f, 1.0f};
-            } ubo;
-
-            ubo.projection = camera->matrices.perspective;
-            ubo.modelview = camera->matrices.view;
-
-            MaterialManager::get(srm.material_)->set_uniform_data("globalData", sizeof(ubo), &ubo);
-            MaterialManager::get(srm.material_)->bind(commandBuffer);
-            srm.model_->bind(commandBuffer, VERTEX_BUFFER_BIND_ID);
-            
-            VkDeviceSize offsets[1] = { 0 };
-            vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, &id.instance_data_buffer_.buffer_.buffer, offsets);
-            
-            vkCmdDrawIndexed(commandBuffer, srm.model_->get_index_count(), id.instance_count_, 0, 0, 0);
+    void Renderer::prepare(std::shared_ptr<CameraNew> camera, ecs::registry& registry, uint32_t frame_index, task_scheduler* scheduler) {
+        struct ubo {
+            glm::mat4 projection;
+            glm::mat4 modelview;
+            glm::vec4 light_pos = {0.0f, -5.0f, 0.0f, 1.0f};
+        } ubo;
+
+        ubo.projection = camera->matrices.perspective;
+        ubo.modelview = camera->matrices.view;
+
+        // draws are sorted by material, so uniforms are set once per material
+        const auto set_global_data = [&ubo](const auto& draws, const auto& material_of) {
+            for(std::size_t i = 0; i < draws.size(); i++) {
+                if(i == 0 || material_of(draws[i]) != material_of(draws[i - 1])) {
+                    MaterialManager::get(material_of(draws[i]))->set_uniform_data("globalData", sizeof(ubo), &ubo);
+                }
+            }
         };
 
-        registry.each(render_sys);
+        instanced_draws_.clear();
+
+        if(gpu_driven_) {
+            indirect_.prepare(*camera, registry, frame_index);
+            set_global_data(indirect_.groups(), [](const indirect_renderer::draw_group& group) { return group.material_; });
+        } else {
+            const auto planes = frustum::from_view_projection(ubo.projection * ubo.modelview);
+            // instances of entities with a world_transform are relative to the entity
+            const auto instances_of = [&](const ecs::entity& e, const instance_data& id) -> std::span<const transform_3d> {
+                const auto local = std::span(id.instance_data_).first(std::min<std::size_t>(id.instance_count_, id.instance_data_.size()));
+                if(!registry.has<world_transform>(e)) return local;
+
+                const auto& world = std::as_const(registry).get<world_transform>(e); // mutable access would stamp it changed
+                world_instances_.resize(local.size());
+                std::transform(local.begin(), local.end(), world_instances_.begin(), [&world](const transform_3d& t) { return to_world(world, t); });
+                return world_instances_;
+            };
+
+            // bounds have to enclose the instances again once they or the entity's world transform changed
+            const auto update_bounds = [&](const ecs::entity& e, const shared_render_mesh& srm, const instance_data& id) {
+                if(registry.has<world_bounds>(e)) {
+                    registry.get<world_bounds>(e) = enclosing_bounds(srm.model_->get_bounds(), instances_of(e, id));
+                }
+            };
+            registry.view<const ecs::entity&, const shared_render_mesh&, const instance_data&>().changed_since(cpu_tick_).each(update_bounds);
+            registry.view<const ecs::entity&, const shared_render_mesh&, const instance_data&, const world_transform&>().changed_since(cpu_tick_).each(
+                [&](const ecs::entity& e, const shared_render_mesh& srm, const instance_data& id, const world_transform&) {
+                    update_bounds(e, srm, id);
+                });
+
+            culler_.cull(registry, planes, scheduler);
+
+            instance_ring_.begin_frame(frame_index);
+            registry.each([&](const ecs::entity& e, const shared_render_mesh& srm, const instance_data& id) {
+                // bounds enclose all instances, nothing of an entity outside of the frustum is visible
+                if(registry.has<world_bounds>(e) && !culler_.is_visible(e)) return;
+
+                const auto instances = instances_of(e, id);
+                const auto visible = culler_.cull_instances(planes, srm.model_->get_bounds(), instances, scheduler);
+                if(visible.empty()) return;
+
+                const auto allocation = instance_ring_.allocate(visible.size() * sizeof(transform_3d), alignof(transform_3d));
+                auto* transforms = static_cast<transform_3d*>(allocation.data_);
+                for(std::size_t i = 0; i < visible.size(); i++) {
+                    transforms[i] = instances[visible[i]];
+                }
+
+                instanced_draws_.push_back({&srm, allocation.buffer_, allocation.offset_, static_cast<uint32_t>(visible.size())});
+            });
+
+            // accept changes stamped with the current tick next time, they may happen after this call
+            cpu_tick_ = registry.tick() - 1;
+
+            // group draws by material, so partitions bind few materials
+            std::sort(instanced_draws_.begin(), instanced_draws_.end(), [](const instanced_draw& lhs, const instanced_draw& rhs) {
+                return lhs.mesh_->material_ < rhs.mesh_->material_;
+            });
+
+            set_global_data(instanced_draws_, [](const instanced_draw& draw) { return draw.mesh_->material_; });
+        }
+
+        sdf_draws_.clear();
+        registry.each([this](const sdf_text_outline& s, const render_mesh& r) {
+            sdf_draws_.push_back({&s, &r});
+        });
+    }
+
+    void Renderer::cull(VkCommandBuffer commandBuffer) const {
+        if(gpu_driven_) indirect_.cull(commandBuffer);
+    }
+
+    void Renderer::record(VkCommandBuffer commandBuffer, std::size_t partition, std::size_t partition_count) const {
+        const auto slice = [partition, partition_count](const auto& draws) {
+            return std::span(draws).subspan(
+                draws.size() * partition / partition_count,
+                draws.size() * (partition + 1) / partition_count - draws.size() * partition / partition_count);
+        };
+
+        if(gpu_driven_) {
+            const auto groups = indirect_.groups().size();
+            indirect_.record(commandBuffer, groups * partition / partition_count, groups * (partition + 1) / partition_count);
+        }
+
+        const material_handle* bound = nullptr;
+        for(const auto& draw : slice(instanced_draws_)) {
+            if(bound == nullptr || *bound != draw.mesh_->material_) {
+                MaterialManager::get(draw.mesh_->material_)->bind(commandBuffer);
+                bound = &draw.mesh_->material_;
+            }
+            draw.mesh_->model_->bind(commandBuffer, VERTEX_BUFFER_BIND_ID);
+
+            vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, &draw.instance_buffer_, &draw.instance_offset_);
+
+            vkCmdDrawIndexed(commandBuffer, draw.mesh_->model_->get_index_count(), draw.instance_count_, 0, 0, 0);
+        }
 
         /*tmp = light_material.get();
         Model* m = &light_model;
@@ -60,15 +164,18 @@ namespace nvkg {
             m->draw(commandBuffer, 0);
         });*/
 
+        const auto sdf_draws = slice(sdf_draws_);
+        if(sdf_draws.empty()) {
+            return;
+        }
+
         material_handle tmp = sdf_text::sdf_material();
         MaterialManager::get(tmp)->bind(commandBuffer);
 
-        const auto sdf_sys = [&commandBuffer, &tmp](const sdf_text_outline& s, const render_mesh& r) {
-            MaterialManager::get(tmp)->push_constant(commandBuffer, "push", sizeof(sdf_text_outline), &s);
-            r.model_->bind(commandBuffer);
-            r.model_->draw(commandBuffer, 0);
-        };
-
-        registry.each(sdf_sys);
+        for(const auto& draw : sdf_draws) {
+            MaterialManager::get(tmp)->push_constant(commandBuffer, "push", sizeof(sdf_text_outline), draw.outline_);
+            draw.mesh_->model_->bind(commandBuffer);
+            draw.mesh_->model_->draw(commandBuffer, 0);
+        }
     }
 }
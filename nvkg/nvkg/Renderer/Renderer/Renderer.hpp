@@ -5,7 +5,11 @@
 #include <nvkg/Renderer/Model/Model.hpp>
 #include <nvkg/Renderer/Camera/Camera.hpp>
 #include <nvkg/Components/component.hpp>
+#include <nvkg/Components/hierarchy.hpp>
 #include <nvkg/Renderer/Utils/Math.hpp>
+#include <nvkg/Renderer/Renderer/IndirectRenderer.hpp>
+#include <nvkg/Renderer/Buffer/RingBuffer.hpp>
+#include <nvkg/Utils/task_scheduler.hpp>
 
 namespace nvkg {
 
@@ -16,11 +20,81 @@ namespace nvkg {
             Renderer();
             ~Renderer();
 
-            void render(VkCommandBuffer& command_buffer, std::shared_ptr<CameraNew> camera, ecs::registry& registry);
+            /**
+             * @brief Collects this frame's draws from the registry and updates per material uniforms. Has to run on
+             * the thread owning the registry before cull() and record() are called.
+             *
+             * Without GPU driven rendering instanced draws are frustum culled here: entities with world_bounds are
+             * skipped as a whole when their bounds, which are kept enclosing all of their instances, are outside of
+             * the frustum, then the instances of the remaining ones are culled and only the visible instances are
+             * written to the frame's region of a ring buffer and drawn.
+             *
+             * Instances of entities with a world_transform are placed relative to it, see to_world().
+             *
+             * @param camera - camera to draw and cull with.
+             * @param registry - registry owning the entities to draw.
+             * @param frame_index - index of the frame in flight, its fence has to be waited for.
+             * @param scheduler - scheduler to spread culling across, nullptr culls on the calling thread.
+             **/
+            void prepare(std::shared_ptr<CameraNew> camera, ecs::registry& registry, uint32_t frame_index, task_scheduler* scheduler = nullptr);
+
+            /**
+             * @brief Records GPU culling of instanced draws when GPU driven rendering is enabled, nothing otherwise.
+             * Has to be recorded outside of the render pass, after prepare() and before record().
+             *
+             * @param command_buffer - primary command buffer of the frame.
+             **/
+            void cull(VkCommandBuffer command_buffer) const;
+
+            /**
+             * @brief Records the draws of one partition of the prepared draw lists. Partitions are contiguous ranges of
+             * the draw lists, which are sorted by material, so different partitions can be recorded concurrently into
+             * different command buffers.
+             *
+             * @param command_buffer - command buffer to record to, inside the swapchain render pass.
+             * @param partition - index of the partition to record.
+             * @param partition_count - number of partitions the draw lists are split into.
+             **/
+            void record(VkCommandBuffer command_buffer, std::size_t partition, std::size_t partition_count) const;
 
             void recreate_materials();
 
+            /**
+             * @brief Draws shared_render_mesh entities with instance_data through indirect_renderer, culled on the GPU,
+             * instead of one CPU draw per entity. Stays disabled on devices without indirect_renderer support.
+             **/
+            void set_gpu_driven(bool enabled);
+            bool gpu_driven() const { return gpu_driven_; }
+
         private:
+            struct instanced_draw {
+                const shared_render_mesh* mesh_;
+                VkBuffer instance_buffer_;
+                VkDeviceSize instance_offset_;
+                uint32_t instance_count_;
+            };
+
+            // Initial size of the visible instances of a frame, grows when exceeded
+            static constexpr VkDeviceSize instance_ring_bytes = 64 * 1024;
+
+            struct sdf_draw {
+                const sdf_text_outline* outline_;
+                const render_mesh* mesh_;
+            };
+
+            // Draw lists of the current frame, kept between frames so collecting them does not allocate
+            std::vector<instanced_draw> instanced_draws_;
+            std::vector<sdf_draw> sdf_draws_;
+
+            indirect_renderer indirect_;
+            bool gpu_driven_ = false;
+
+            // CPU culling
+            frustum_culler culler_;
+            frame_ring_buffer instance_ring_{instance_ring_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, true};
+            std::vector<transform_3d> world_instances_; // instances of the current entity placed in world space
+            ecs::change_tick_t cpu_tick_{0};
+
             //TODO this needs to change
             //Model light_model;
             //std::unique_ptr<Material> light_material;
@@ -3,6 +3,7 @@
 namespace nvkg {
 
     bool glsl_runtime_compiler::preprocess_glsl(const shader_info& info, std::string& glsl_shader_code) {
+        mem_profiler::scope profile(mem_profiler::tag::shader_compiler);
         glslang::InitializeProcess();
 
         auto translate_stage = [](VkShaderStageFlagBits stage) -> EShLanguage {
@@ -64,6 +65,7 @@ namespace nvkg {
     }
 
     bool glsl_runtime_compiler::compile_to_spirv(const shader_info& info, std::vector<uint32_t>& shader_code) {
+        mem_profiler::scope profile(mem_profiler::tag::shader_compiler);
         glslang::InitializeProcess();
 
         auto translate_stage = [](VkShaderStageFlagBits stage) -> EShLanguage {
@@ -246,7 +246,7 @@ namespace nvkg {
         ); 
     }
 
-    VkResult SwapChain::submit_command_buffers(const VkCommandBuffer* buffers, uint32_t* imageIndex) {
+    VkResult SwapChain::submit_command_buffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, VkSemaphore uploadSemaphore) {
         uint32_t index = *imageIndex;
 
         if (images_in_flight_[index] != VK_NULL_HANDLE) {
@@ -259,11 +259,12 @@ namespace nvkg {
         
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphores[] = {image_available_semaphores_[current_frame_]};
+        VkSemaphore waitSemaphores[] = {image_available_semaphores_[current_frame_], uploadSemaphore};
 
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+        // uploaded resources may be used by any command of the frame
+        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
 
-        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.waitSemaphoreCount = uploadSemaphore != VK_NULL_HANDLE ? 2 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
 
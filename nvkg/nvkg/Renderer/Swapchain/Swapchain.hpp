@@ -142,9 +142,10 @@ namespace nvkg {
          * 
          * @param buffers - an array of command buffers. 
          * @param imageIndex - the index of the image being drawn. 
+         * @param uploadSemaphore - semaphore of uploads the frame uses, VK_NULL_HANDLE if there are none.
          * @return VkResult - the result of submitting the buffer. 
          */
-        VkResult submit_command_buffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+        VkResult submit_command_buffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, VkSemaphore uploadSemaphore = VK_NULL_HANDLE);
 
         void recreate_swapchain();
 
@@ -28,6 +28,7 @@ namespace nvkg {
     }
 
     SampledTexture* TextureManager::load_2d_img(std::string file, VkFormat format, bool create_mip_levels) {
+        mem_profiler::scope profile(mem_profiler::tag::assets);
         int stb_format = (format == VK_FORMAT_R8G8B8A8_UNORM) ? STBI_rgb_alpha : 0; // todo: figure out how other formats play with stb
         int width, height, channels;
 
@@ -4,11 +4,47 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+#include <array>
+
+namespace nvkg {
+
+    // Bounding sphere in model space, a negative radius marks a model without bounds that is never culled
+    struct bounding_sphere {
+        glm::vec3 center_{0.0f};
+        float radius_{-1.0f};
+    };
+}
+
 namespace nvkg::Utils {
     class Math {
         public:
         static glm::mat4 calc_transform_3d(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale);
         static glm::mat2 calc_transform_2d(const glm::vec2& position, const float& rotation, const glm::vec2& scale);
         static glm::mat3 calc_normal_matrix(const glm::vec3& rotation, const glm::vec3& scale);
-    };    
+
+        /**
+         * @brief Extracts the left, right, bottom, top, near and far planes of a view frustum. Every plane is stored
+         * as (normal, distance) with a normalised normal pointing inwards, so a point p is inside the frustum if
+         * dot(plane.xyz, p) + plane.w >= 0 for all planes.
+         *
+         * @param view_projection - projection * view matrix with a [0, 1] depth range.
+         **/
+        static std::array<glm::vec4, 6> frustum_planes(const glm::mat4& view_projection);
+    };
+
+    // defined inline so header-only code, e.g. the culling benchmark, can use it without linking nvkg
+    inline std::array<glm::vec4, 6> Math::frustum_planes(const glm::mat4& view_projection)
+    {
+        // rows of the column major matrix
+        const glm::vec4 r0 = {view_projection[0][0], view_projection[1][0], view_projection[2][0], view_projection[3][0]};
+        const glm::vec4 r1 = {view_projection[0][1], view_projection[1][1], view_projection[2][1], view_projection[3][1]};
+        const glm::vec4 r2 = {view_projection[0][2], view_projection[1][2], view_projection[2][2], view_projection[3][2]};
+        const glm::vec4 r3 = {view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3]};
+
+        std::array<glm::vec4, 6> planes = {r3 + r0, r3 - r0, r3 + r1, r3 - r1, r2, r3 - r2};
+        for (auto& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return planes;
+    }
 }
@@ -1,29 +1,255 @@
 #include <nvkg/Utils/mem_profiler.hpp>
 
-std::size_t alloc_calls_{0};
-std::size_t dealloc_calls_{0};
-std::size_t used_memory_{0};
-
-void* operator new(std::size_t size) {
-    alloc_calls_ += 1;
-    used_memory_ += size;
-    return std::malloc(size);
-}
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
 
-void operator delete(void* memory, std::size_t size) {
-    dealloc_calls_ += 1;
-    used_memory_ -= size;
-    std::free(memory);
-}
+namespace nvkg::mem_profiler {
+
+    namespace {
+        // Counters of a single thread. Only the owning thread writes them, readers sum up all threads, so relaxed
+        // loads and stores are enough and no read-modify-write is needed on the allocation path.
+        struct thread_counters {
+            struct tag_counters {
+                std::atomic<std::uint64_t> alloc_calls_{0};
+                std::atomic<std::uint64_t> dealloc_calls_{0};
+                std::atomic<std::uint64_t> allocated_bytes_{0};
+                std::atomic<std::uint64_t> freed_bytes_{0};
+            };
+
+            std::array<tag_counters, tag_count> tags_{};
+            std::array<std::atomic<std::uint64_t>, histogram_buckets> histogram_{};
+            thread_counters* next_{nullptr};
+        };
+
+        void add(std::atomic<std::uint64_t>& counter, std::uint64_t value) {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        // Counters of all threads that ever allocated, never freed so counts of finished threads are kept
+        std::atomic<thread_counters*> counters_head_{nullptr};
+
+        thread_local thread_counters* counters_{nullptr};
+
+        thread_counters& local_counters() {
+            if (counters_ == nullptr) [[unlikely]] {
+                // malloc instead of new, this runs inside operator new
+                auto* counters = ::new (std::malloc(sizeof(thread_counters))) thread_counters{};
+                counters->next_ = counters_head_.load(std::memory_order_relaxed);
+                while (!counters_head_.compare_exchange_weak(counters->next_, counters, std::memory_order_release, std::memory_order_relaxed)) {
+                }
+                counters_ = counters;
+            }
+            return *counters_;
+        }
+
+        std::mutex frame_mutex_;
+        stats frame_start_{};
+        std::uint64_t frame_index_{0};
+        std::vector<frame_stats> history_;
+        std::size_t history_next_{0};
+
+#if defined NVKG_MEM_PROFILER
+        // Placed right before every pointer handed out, records what free needs to know
+        struct alignas(16) alloc_header {
+            std::uint64_t size_;
+            std::uint32_t offset_;
+            tag tag_;
+            bool aligned_;
+        };
+
+        constexpr std::size_t header_bytes = sizeof(alloc_header);
+
+        static_assert(header_bytes == 16 && __STDCPP_DEFAULT_NEW_ALIGNMENT__ <= header_bytes);
+
+        void* allocate(std::size_t size, std::size_t alignment) noexcept {
+            auto& state = detail::state_;
+            if (state.no_alloc_depth_ > 0) [[unlikely]] {
+                std::fprintf(stderr, "NVKG NO ALLOCATION SCOPE VIOLATION: %s allocated %zu bytes\n",
+                    state.no_alloc_name_ != nullptr ? state.no_alloc_name_ : "<unnamed>", size);
+                std::abort();
+            }
+
+            const bool aligned = alignment > header_bytes;
+            const std::size_t offset = aligned ? alignment : header_bytes;
+            std::byte* base = nullptr;
+            if (aligned) {
+                const std::size_t bytes = (offset + size + alignment - 1) / alignment * alignment;
+#if defined _WIN32
+                base = static_cast<std::byte*>(_aligned_malloc(bytes, alignment));
+#else
+                base = static_cast<std::byte*>(std::aligned_alloc(alignment, bytes));
+#endif
+            } else {
+                base = static_cast<std::byte*>(std::malloc(offset + size));
+            }
+            if (base == nullptr) {
+                return nullptr;
+            }
+
+            auto* ptr = base + offset;
+            ::new (ptr - header_bytes) alloc_header{size, static_cast<std::uint32_t>(offset), state.tag_, aligned};
+
+            auto& counters = local_counters();
+            auto& tag_counters = counters.tags_[static_cast<std::size_t>(state.tag_)];
+            add(tag_counters.alloc_calls_, 1);
+            add(tag_counters.allocated_bytes_, size);
+            add(counters.histogram_[histogram_bucket(size)], 1);
+            return ptr;
+        }
+
+        void deallocate(void* memory) noexcept {
+            if (memory == nullptr) {
+                return;
+            }
 
-void* operator new[](std::size_t size) {
-    alloc_calls_ += 1;
-    used_memory_ += size;
-    return std::malloc(size);
+            auto* ptr = static_cast<std::byte*>(memory);
+            const auto header = *reinterpret_cast<const alloc_header*>(ptr - header_bytes);
+
+            auto& tag_counters = local_counters().tags_[static_cast<std::size_t>(header.tag_)];
+            add(tag_counters.dealloc_calls_, 1);
+            add(tag_counters.freed_bytes_, header.size_);
+
+#if defined _WIN32
+            if (header.aligned_) {
+                _aligned_free(ptr - header.offset_);
+                return;
+            }
+#endif
+            std::free(ptr - header.offset_);
+        }
+
+        void* allocate_or_throw(std::size_t size, std::size_t alignment) {
+            while (true) {
+                if (auto* ptr = allocate(size, alignment)) {
+                    return ptr;
+                }
+                auto handler = std::get_new_handler();
+                if (handler == nullptr) {
+                    throw std::bad_alloc{};
+                }
+                handler();
+            }
+        }
+#endif
+    }
+
+    const char* tag_name(tag t) {
+        switch (t) {
+            case tag::general: return "general";
+            case tag::ecs: return "ecs";
+            case tag::renderer: return "renderer";
+            case tag::assets: return "assets";
+            case tag::shader_compiler: return "shader compiler";
+            default: return "unknown";
+        }
+    }
+
+    std::size_t histogram_bucket(std::size_t size) {
+        if (size <= 16) {
+            return 0;
+        }
+        return std::min<std::size_t>(std::bit_width(size - 1) - 4, histogram_buckets - 1);
+    }
+
+    tag_stats stats::total() const {
+        tag_stats sum;
+        for (const auto& t : tags_) {
+            sum.alloc_calls_ += t.alloc_calls_;
+            sum.dealloc_calls_ += t.dealloc_calls_;
+            sum.allocated_bytes_ += t.allocated_bytes_;
+            sum.freed_bytes_ += t.freed_bytes_;
+        }
+        return sum;
+    }
+
+    stats totals() {
+        stats sum;
+        for (auto* counters = counters_head_.load(std::memory_order_acquire); counters != nullptr; counters = counters->next_) {
+            for (std::size_t t = 0; t < tag_count; t++) {
+                sum.tags_[t].alloc_calls_ += counters->tags_[t].alloc_calls_.load(std::memory_order_relaxed);
+                sum.tags_[t].dealloc_calls_ += counters->tags_[t].dealloc_calls_.load(std::memory_order_relaxed);
+                sum.tags_[t].allocated_bytes_ += counters->tags_[t].allocated_bytes_.load(std::memory_order_relaxed);
+                sum.tags_[t].freed_bytes_ += counters->tags_[t].freed_bytes_.load(std::memory_order_relaxed);
+            }
+            for (std::size_t b = 0; b < histogram_buckets; b++) {
+                sum.histogram_[b] += counters->histogram_[b].load(std::memory_order_relaxed);
+            }
+        }
+        return sum;
+    }
+
+    frame_stats end_frame() {
+        const auto now = totals();
+
+        frame_stats frame;
+        for (std::size_t t = 0; t < tag_count; t++) {
+            frame.tags_[t].alloc_calls_ = now.tags_[t].alloc_calls_ - frame_start_.tags_[t].alloc_calls_;
+            frame.tags_[t].dealloc_calls_ = now.tags_[t].dealloc_calls_ - frame_start_.tags_[t].dealloc_calls_;
+            frame.tags_[t].allocated_bytes_ = now.tags_[t].allocated_bytes_ - frame_start_.tags_[t].allocated_bytes_;
+            frame.tags_[t].freed_bytes_ = now.tags_[t].freed_bytes_ - frame_start_.tags_[t].freed_bytes_;
+        }
+        for (std::size_t b = 0; b < histogram_buckets; b++) {
+            frame.histogram_[b] = now.histogram_[b] - frame_start_.histogram_[b];
+        }
+
+        const std::scoped_lock lock(frame_mutex_);
+        frame.frame_ = frame_index_++;
+        frame_start_ = now;
+        if (history_.size() < history_frames) {
+            history_.push_back(frame);
+        } else {
+            history_[history_next_] = frame;
+        }
+        history_next_ = (history_next_ + 1) % history_frames;
+        return frame;
+    }
+
+    std::vector<frame_stats> history() {
+        const std::scoped_lock lock(frame_mutex_);
+        std::vector<frame_stats> frames;
+        frames.reserve(history_.size());
+        // once the ring is full the oldest frame is the one overwritten next
+        const std::size_t oldest = history_.size() < history_frames ? 0 : history_next_;
+        for (std::size_t i = 0; i < history_.size(); i++) {
+            frames.push_back(history_[(oldest + i) % history_.size()]);
+        }
+        return frames;
+    }
 }
 
-void operator delete[](void* memory, std::size_t size) {
-    dealloc_calls_ += 1;
-    used_memory_ -= size;
-    std::free(memory);
-}
\ No newline at end of file
+#if defined NVKG_MEM_PROFILER
+
+using nvkg::mem_profiler::allocate;
+using nvkg::mem_profiler::allocate_or_throw;
+using nvkg::mem_profiler::deallocate;
+
+void* operator new(std::size_t size) { return allocate_or_throw(size, 0); }
+void* operator new[](std::size_t size) { return allocate_or_throw(size, 0); }
+void* operator new(std::size_t size, std::align_val_t align) { return allocate_or_throw(size, static_cast<std::size_t>(align)); }
+void* operator new[](std::size_t size, std::align_val_t align) { return allocate_or_throw(size, static_cast<std::size_t>(align)); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, 0); }
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return allocate(size, static_cast<std::size_t>(align)); }
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return allocate(size, static_cast<std::size_t>(align)); }
+
+// sizes and alignments passed to delete are ignored, the allocation header records them
+void operator delete(void* memory) noexcept { deallocate(memory); }
+void operator delete[](void* memory) noexcept { deallocate(memory); }
+void operator delete(void* memory, std::size_t) noexcept { deallocate(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { deallocate(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { deallocate(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { deallocate(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { deallocate(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { deallocate(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { deallocate(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { deallocate(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { deallocate(memory); }
+
+#endif
@@ -1,11 +1,155 @@
 #ifndef MEM_PROFILER_HPP
 #define MEM_PROFILER_HPP
 
+#include <array>
 #include <cstddef>
-#include <cstdlib>
+#include <cstdint>
+#include <vector>
 
-extern std::size_t alloc_calls_;
-extern std::size_t dealloc_calls_;
-extern std::size_t used_memory_;
+/*
+* Heap profiler, opt-in: define NVKG_MEM_PROFILER when building nvkg to replace the global operator new/delete.
+* Without it no allocation is tracked, scopes compile to nothing and all statistics stay zero.
+*
+* Every thread counts its allocations into its own counters, which are only summed up when statistics are requested,
+* so tracking does not serialise threads of the task scheduler. Allocations are attributed to the tag of the innermost
+* scope on the allocating thread, frees are attributed to the tag of the allocation.
+*/
+namespace nvkg::mem_profiler {
 
-#endif
\ No newline at end of file
+    enum class tag : std::uint8_t { general, ecs, renderer, assets, shader_compiler, count };
+
+    constexpr std::size_t tag_count = static_cast<std::size_t>(tag::count);
+
+    /**
+     * Allocation sizes are bucketed by powers of two, bucket i holds sizes in (2^(i + 3), 2^(i + 4)], the first bucket
+     * everything up to 16 bytes and the last everything above 256 KB.
+     **/
+    constexpr std::size_t histogram_buckets = 16;
+
+    /**
+     * Number of frames kept by history().
+     **/
+    constexpr std::size_t history_frames = 120;
+
+    constexpr bool enabled() {
+#if defined NVKG_MEM_PROFILER
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    const char* tag_name(tag t);
+
+    /**
+     * @brief Returns the histogram bucket of an allocation of size bytes.
+     **/
+    std::size_t histogram_bucket(std::size_t size);
+
+    struct tag_stats {
+        std::uint64_t alloc_calls_{0};
+        std::uint64_t dealloc_calls_{0};
+        std::uint64_t allocated_bytes_{0};
+        std::uint64_t freed_bytes_{0};
+
+        std::int64_t live_bytes() const { return static_cast<std::int64_t>(allocated_bytes_ - freed_bytes_); }
+    };
+
+    struct stats {
+        std::array<tag_stats, tag_count> tags_{};
+        std::array<std::uint64_t, histogram_buckets> histogram_{}; // allocation calls per size bucket
+
+        tag_stats total() const;
+    };
+
+    struct frame_stats : stats {
+        std::uint64_t frame_{0};
+    };
+
+    /**
+     * @brief Sums up the counters of all threads since program start.
+     **/
+    stats totals();
+
+    /**
+     * @brief Closes the current frame: records the allocations made since the previous call as a frame of the history.
+     * Call once per frame from a single thread.
+     *
+     * @returns the statistics of the closed frame.
+     **/
+    frame_stats end_frame();
+
+    /**
+     * @brief Returns up to history_frames closed frames, oldest first.
+     **/
+    std::vector<frame_stats> history();
+
+    namespace detail {
+        struct thread_state {
+            tag tag_{tag::general};
+            std::uint32_t no_alloc_depth_{0};
+            const char* no_alloc_name_{nullptr};
+        };
+
+        inline thread_local thread_state state_{};
+    }
+
+    /**
+     * @brief Attributes allocations of the calling thread to t while in scope, scopes nest.
+     *
+     * Usage:
+     *
+     *      nvkg::mem_profiler::scope profile(nvkg::mem_profiler::tag::assets);
+     **/
+    class scope {
+        public:
+
+#if defined NVKG_MEM_PROFILER
+        explicit scope(tag t) : previous_(detail::state_.tag_) { detail::state_.tag_ = t; }
+        ~scope() { detail::state_.tag_ = previous_; }
+#else
+        explicit scope(tag) {}
+#endif
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+        private:
+
+#if defined NVKG_MEM_PROFILER
+        tag previous_;
+#endif
+    };
+
+    /**
+     * @brief Asserts that the calling thread does not allocate while in scope, the first allocation reports name and
+     * the allocation size and aborts. Meant for hot loops that are expected to run allocation free.
+     **/
+    class no_alloc_scope {
+        public:
+
+#if defined NVKG_MEM_PROFILER
+        explicit no_alloc_scope(const char* name) : previous_(detail::state_.no_alloc_name_) {
+            detail::state_.no_alloc_depth_++;
+            detail::state_.no_alloc_name_ = name;
+        }
+        ~no_alloc_scope() {
+            detail::state_.no_alloc_depth_--;
+            detail::state_.no_alloc_name_ = previous_;
+        }
+#else
+        explicit no_alloc_scope(const char*) {}
+#endif
+
+        no_alloc_scope(const no_alloc_scope&) = delete;
+        no_alloc_scope& operator=(const no_alloc_scope&) = delete;
+
+        private:
+
+#if defined NVKG_MEM_PROFILER
+        const char* previous_;
+#endif
+    };
+}
+
+#endif
@@ -0,0 +1,570 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nvkg {
+
+    /**
+     * @brief Join counter of tasks spawned together. Keeps the first exception any of them threw so the thread waiting
+     * for them can rethrow it once all of them are done.
+     **/
+    struct task_join {
+        std::atomic<std::size_t> pending{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+
+        /**
+         * @brief Keeps e unless an earlier exception was kept already.
+         **/
+        void capture(std::exception_ptr e) noexcept {
+            if (!failed.exchange(true, std::memory_order_acq_rel)) {
+                error = std::move(e);
+            }
+        }
+
+        /**
+         * @brief Returns the kept exception and resets the join for reuse. Only valid once pending dropped to zero.
+         **/
+        std::exception_ptr take() noexcept {
+            failed.store(false, std::memory_order_relaxed);
+            return std::exchange(error, nullptr);
+        }
+    };
+
+    /**
+     * @brief A task is a type erased callable stored inline in a single cache line. Unlike std::function it never
+     * allocates, callables that do not fit have to capture by reference. Every task counts down a join counter after
+     * it ran so the thread that spawned it can wait for completion, exceptions are handed to the join.
+     **/
+    class alignas(64) task {
+        public:
+
+        /**
+         * Size of the inline storage for the callable and its captures.
+         **/
+        static constexpr std::size_t storage_bytes = 40;
+
+        task() = default;
+
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+
+        ~task() { reset(); }
+
+        /**
+         * @brief Constructs the callable in place.
+         *
+         * @param func - the callable, invoked without arguments.
+         * @param join - join counted down after func ran and receiving its exception, may be null.
+         **/
+        template<typename F>
+        void emplace(F&& func, task_join* join) {
+            using func_type = std::decay_t<F>;
+            static_assert(sizeof(func_type) <= storage_bytes, "Task callable does not fit the inline storage, capture by reference");
+            static_assert(alignof(func_type) <= alignof(std::max_align_t), "Task callable is over-aligned");
+
+            reset();
+            ::new (static_cast<void*>(storage_)) func_type(std::forward<F>(func));
+            invoke_ = [](void* storage) { (*static_cast<func_type*>(storage))(); };
+            if constexpr (!std::is_trivially_destructible_v<func_type>) {
+                destroy_ = [](void* storage) { static_cast<func_type*>(storage)->~func_type(); };
+            }
+            join_ = join;
+        }
+
+        /**
+         * @brief Runs the callable and signals completion through the join. An exception of the callable is kept by
+         * the join, tasks without a join must not throw.
+         **/
+        void execute() noexcept {
+            auto* join = join_;
+            try {
+                invoke_(storage_);
+            } catch (...) {
+                if (join == nullptr) {
+                    std::terminate();
+                }
+                join->capture(std::current_exception());
+            }
+            reset();
+            if (join != nullptr) {
+                join->pending.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        private:
+
+        void reset() noexcept {
+            if (destroy_ != nullptr) {
+                destroy_(storage_);
+            }
+            invoke_ = nullptr;
+            destroy_ = nullptr;
+        }
+
+        alignas(std::max_align_t) std::byte storage_[storage_bytes];
+        void (*invoke_)(void*) = nullptr;
+        void (*destroy_)(void*) = nullptr;
+        task_join* join_ = nullptr;
+    };
+
+    static_assert(sizeof(task) == 64, "Task is expected to fill exactly one cache line");
+
+    /**
+     * @brief Chase-Lev work stealing deque of task pointers. The owning thread pushes and pops at the bottom without
+     * locking, any other thread steals from the top. The ring grows when full, retired rings are kept until the deque
+     * is destroyed since thieves may still read from them.
+     **/
+    class work_stealing_deque {
+        public:
+
+        explicit work_stealing_deque(std::size_t capacity = 1024) {
+            assert((capacity & (capacity - 1)) == 0 && "Deque capacity must be a power of two");
+            rings_.push_back(std::make_unique<ring>(capacity));
+            ring_.store(rings_.back().get(), std::memory_order_relaxed);
+        }
+
+        work_stealing_deque(const work_stealing_deque&) = delete;
+        work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+        /**
+         * @brief Pushes a task at the bottom. Owner thread only.
+         **/
+        void push(task* t) {
+            const auto b = bottom_.load(std::memory_order_relaxed);
+            const auto top = top_.load(std::memory_order_acquire);
+            auto* r = ring_.load(std::memory_order_relaxed);
+            if (b - top > static_cast<std::int64_t>(r->mask)) {
+                r = grow(r, top, b);
+            }
+            r->put(b, t);
+            bottom_.store(b + 1, std::memory_order_release);
+        }
+
+        /**
+         * @brief Pops the most recently pushed task. Owner thread only.
+         *
+         * @return the task or nullptr when the deque is empty.
+         **/
+        task* pop() noexcept {
+            const auto b = bottom_.load(std::memory_order_relaxed) - 1;
+            auto* r = ring_.load(std::memory_order_relaxed);
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto top = top_.load(std::memory_order_relaxed);
+
+            if (top > b) {
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            task* t = r->get(b);
+            if (top == b) {
+                // last task, race against thieves
+                if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    t = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+            return t;
+        }
+
+        /**
+         * @brief Steals the least recently pushed task. Safe to call from any thread.
+         *
+         * @return the task or nullptr when the deque is empty or another thread won the race.
+         **/
+        task* steal() noexcept {
+            auto top = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const auto b = bottom_.load(std::memory_order_acquire);
+            if (top >= b) {
+                return nullptr;
+            }
+
+            task* t = ring_.load(std::memory_order_acquire)->get(top);
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return t;
+        }
+
+        /**
+         * @brief Returns true if the deque looked empty at the time of the call.
+         **/
+        bool empty() const noexcept {
+            return top_.load(std::memory_order_relaxed) >= bottom_.load(std::memory_order_relaxed);
+        }
+
+        private:
+
+        struct ring {
+            explicit ring(std::size_t capacity) : mask(capacity - 1), slots(new std::atomic<task*>[capacity]) {}
+
+            task* get(std::int64_t index) const noexcept {
+                return slots[static_cast<std::size_t>(index) & mask].load(std::memory_order_relaxed);
+            }
+
+            void put(std::int64_t index, task* t) noexcept {
+                slots[static_cast<std::size_t>(index) & mask].store(t, std::memory_order_relaxed);
+            }
+
+            std::size_t mask;
+            std::unique_ptr<std::atomic<task*>[]> slots;
+        };
+
+        ring* grow(ring* old, std::int64_t top, std::int64_t bottom) {
+            auto bigger = std::make_unique<ring>((old->mask + 1) * 2);
+            for (auto i = top; i < bottom; i++) {
+                bigger->put(i, old->get(i));
+            }
+            auto* r = bigger.get();
+            rings_.push_back(std::move(bigger));
+            ring_.store(r, std::memory_order_release);
+            return r;
+        }
+
+        alignas(64) std::atomic<std::int64_t> top_{0};
+        alignas(64) std::atomic<std::int64_t> bottom_{0};
+        std::atomic<ring*> ring_{nullptr};
+        std::vector<std::unique_ptr<ring>> rings_;
+    };
+
+    /**
+     * @brief Work stealing task scheduler. Every worker owns a deque it pushes and pops spawned tasks from, idle
+     * workers steal from the others, so fine grained fork/join work does not serialise on a shared queue lock.
+     *
+     * Threads that are not workers of the scheduler (e.g. the main thread) share one extra deque. Only one such
+     * thread submits work at a time, others block until it is done. The submitting thread helps executing tasks
+     * while it waits, so a scheduler with N workers runs work on N + 1 threads.
+     *
+     * Usage:
+     *
+     *      nvkg::task_scheduler scheduler(7);
+     *      scheduler.parallel_for(0, items.size(), [&](std::size_t first, std::size_t last) {
+     *          for (auto i = first; i < last; i++) process(items[i]);
+     *      }, 64);
+     **/
+    class task_scheduler {
+        // Deque slot the calling thread pushes spawned tasks to
+        struct binding {
+            const task_scheduler* scheduler;
+            std::size_t slot;
+        };
+
+        static inline thread_local binding binding_{nullptr, 0};
+
+        // Binds the calling thread to a deque slot of this scheduler. Workers already are, external threads take the
+        // shared slot 0 and hold its lock until the scope ends.
+        class bind_scope {
+            public:
+
+            explicit bind_scope(task_scheduler& scheduler) : previous_(binding_) {
+                if (binding_.scheduler == &scheduler) {
+                    return;
+                }
+                lock_ = std::unique_lock<std::mutex>(scheduler.external_mutex_);
+                binding_ = binding{&scheduler, 0};
+            }
+
+            bind_scope(const bind_scope&) = delete;
+            bind_scope& operator=(const bind_scope&) = delete;
+
+            ~bind_scope() { binding_ = previous_; }
+
+            private:
+
+            binding previous_;
+            std::unique_lock<std::mutex> lock_;
+        };
+
+        public:
+
+        /**
+         * @brief Creates the scheduler and starts its workers.
+         *
+         * @param thread_count - number of worker threads, 0 uses hardware concurrency minus the calling thread.
+         **/
+        explicit task_scheduler(std::size_t thread_count = 0) {
+            if (thread_count == 0) {
+                thread_count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+            }
+
+            // slot 0 belongs to external threads, slots 1..N to workers
+            deques_.reserve(thread_count + 1);
+            for (std::size_t i = 0; i <= thread_count; i++) {
+                deques_.push_back(std::make_unique<work_stealing_deque>());
+            }
+
+            workers_.reserve(thread_count);
+            for (std::size_t i = 1; i <= thread_count; i++) {
+                workers_.emplace_back([this, i] { worker(i); });
+            }
+        }
+
+        task_scheduler(const task_scheduler&) = delete;
+        task_scheduler& operator=(const task_scheduler&) = delete;
+
+        /**
+         * @brief Stops and joins all workers. No work may be in flight.
+         **/
+        ~task_scheduler() {
+            stop_.store(true, std::memory_order_seq_cst);
+            epoch_.fetch_add(1, std::memory_order_seq_cst);
+            epoch_.notify_all();
+            for (auto& worker : workers_) {
+                worker.join();
+            }
+        }
+
+        /**
+         * @brief Returns the number of worker threads.
+         **/
+        std::size_t thread_count() const noexcept { return workers_.size(); }
+
+        /**
+         * @brief Runs func over [first, last) and returns when all blocks are done. grain is the maximum block size:
+         * the range is split until no block holds more than grain indices, and each block runs as one task. The range
+         * is split in halves lazily, the calling thread runs the first half while the second is offered to thieves, so
+         * only O(log n) tasks are live per thread and none of them are heap allocated. May be called from within a
+         * task.
+         *
+         * If func throws, blocks that didn't start yet are skipped and the first exception is rethrown on the calling
+         * thread once all running blocks finished.
+         *
+         * @param first - first index.
+         * @param last - one past the last index.
+         * @param func - callable invoked as func(block_first, block_last).
+         * @param grain - maximum number of indices in a block, i.e. processed by a single task.
+         **/
+        template<typename F>
+        void parallel_for(std::size_t first, std::size_t last, F&& func, std::size_t grain = 1) {
+            if (first >= last) {
+                return;
+            }
+
+            bind_scope scope(*this);
+            range_context<std::remove_reference_t<F>> context{this, &func, std::max<std::size_t>(grain, 1)};
+            run_range(context, first, last);
+        }
+
+        /**
+         * @brief A group of independent tasks spawned by one thread and waited for together. Task storage is paged and
+         * reused between waits, so a group kept across frames does not allocate once warmed up. A group is bound to
+         * the thread that created it.
+         **/
+        class task_group {
+            public:
+
+            explicit task_group(task_scheduler& scheduler) : scheduler_(scheduler), scope_(scheduler) {}
+
+            task_group(const task_group&) = delete;
+            task_group& operator=(const task_group&) = delete;
+
+            // exceptions nobody waited for are dropped, a destructor can't rethrow them
+            ~task_group() { scheduler_.wait(join_.pending); }
+
+            /**
+             * @brief Spawns func as a task.
+             *
+             * @param func - callable without arguments fitting into task::storage_bytes.
+             **/
+            template<typename F>
+            void run(F&& func) {
+                if (used_ == pages_.size() * page_size) {
+                    pages_.push_back(std::make_unique<task[]>(page_size));
+                }
+                auto& t = pages_[used_ / page_size][used_ % page_size];
+                used_++;
+
+                t.emplace(std::forward<F>(func), &join_);
+                join_.pending.fetch_add(1, std::memory_order_relaxed);
+                scheduler_.push(&t);
+            }
+
+            /**
+             * @brief Waits for all spawned tasks, executing tasks in the meantime. Rethrows the first exception a task
+             * threw once all of them are done.
+             **/
+            void wait() {
+                scheduler_.wait(join_.pending);
+                used_ = 0;
+                if (auto error = join_.take()) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            private:
+
+            static constexpr std::size_t page_size = 256;
+
+            task_scheduler& scheduler_;
+            bind_scope scope_;
+            task_join join_;
+            std::vector<std::unique_ptr<task[]>> pages_;
+            std::size_t used_ = 0;
+        };
+
+        private:
+
+        template<typename F>
+        struct range_context {
+            task_scheduler* scheduler;
+            F* func;
+            std::size_t grain;
+            std::atomic<bool> cancelled{false}; // set once a block threw, blocks not started yet are skipped
+        };
+
+        // Most recent splits live on this frame, enough for any range since every split halves it
+        static constexpr std::size_t max_splits = 64;
+
+        template<typename F>
+        void run_range(range_context<F>& context, std::size_t first, std::size_t last) {
+            struct alignas(task) split_storage {
+                std::byte bytes[sizeof(task)];
+            };
+            split_storage splits[max_splits];
+            task_join join;
+            std::size_t split_count = 0;
+            std::exception_ptr error;
+
+            try {
+                while (last - first > context.grain && split_count < max_splits) {
+                    const std::size_t mid = first + (last - first) / 2;
+                    auto* t = ::new (static_cast<void*>(splits[split_count].bytes)) task();
+                    split_count++;
+                    t->emplace([&context, mid, last] {
+                        if (!context.cancelled.load(std::memory_order_relaxed)) {
+                            context.scheduler->run_range(context, mid, last);
+                        }
+                    }, &join);
+                    join.pending.fetch_add(1, std::memory_order_relaxed);
+                    try {
+                        push(t);
+                    } catch (...) {
+                        join.pending.fetch_sub(1, std::memory_order_relaxed);
+                        throw;
+                    }
+                    last = mid;
+                }
+
+                if (!context.cancelled.load(std::memory_order_relaxed)) {
+                    (*context.func)(first, last);
+                }
+            } catch (...) {
+                error = std::current_exception();
+                context.cancelled.store(true, std::memory_order_relaxed);
+            }
+
+            // splits live on this frame and may be run by thieves, they have to finish before it unwinds
+            wait(join.pending);
+
+            for (std::size_t i = 0; i < split_count; i++) {
+                std::launder(reinterpret_cast<task*>(splits[i].bytes))->~task();
+            }
+
+            if (auto split_error = join.take(); !error) {
+                error = std::move(split_error);
+            }
+            if (error) {
+                context.cancelled.store(true, std::memory_order_relaxed);
+                std::rethrow_exception(error);
+            }
+        }
+
+        void push(task* t) {
+            deques_[binding_.slot]->push(t);
+            epoch_.fetch_add(1, std::memory_order_seq_cst);
+            if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+                epoch_.notify_one();
+            }
+        }
+
+        // Help executing tasks until the join counter drops to zero
+        void wait(const std::atomic<std::size_t>& pending) {
+            const std::size_t slot = binding_.slot;
+            while (pending.load(std::memory_order_acquire) != 0) {
+                if (auto* t = find_task(slot)) {
+                    t->execute();
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        task* find_task(std::size_t slot) noexcept {
+            if (auto* t = deques_[slot]->pop()) {
+                return t;
+            }
+
+            // xorshift picks a random victim to start from so thieves spread over the deques
+            static thread_local std::uint32_t seed = static_cast<std::uint32_t>(
+                std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1u;
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+
+            const std::size_t count = deques_.size();
+            const std::size_t start = seed % count;
+            for (std::size_t i = 0; i < count; i++) {
+                const std::size_t victim = (start + i) % count;
+                if (victim == slot) {
+                    continue;
+                }
+                if (auto* t = deques_[victim]->steal()) {
+                    return t;
+                }
+            }
+            return nullptr;
+        }
+
+        void worker(std::size_t slot) {
+            binding_ = binding{this, slot};
+            constexpr int spin_count = 64;
+
+            while (!stop_.load(std::memory_order_relaxed)) {
+                task* t = nullptr;
+                for (int spin = 0; spin < spin_count && t == nullptr; spin++) {
+                    t = find_task(slot);
+                }
+                if (t != nullptr) {
+                    t->execute();
+                    continue;
+                }
+
+                // announce sleeping before the last check so a concurrent push either sees us or we see its task
+                sleepers_.fetch_add(1, std::memory_order_seq_cst);
+                const auto epoch = epoch_.load(std::memory_order_seq_cst);
+                t = find_task(slot);
+                if (t == nullptr && !stop_.load(std::memory_order_seq_cst)) {
+                    epoch_.wait(epoch, std::memory_order_seq_cst);
+                }
+                sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+
+                if (t != nullptr) {
+                    t->execute();
+                }
+            }
+        }
+
+        std::vector<std::unique_ptr<work_stealing_deque>> deques_;
+        std::vector<std::thread> workers_;
+        std::mutex external_mutex_;
+
+        std::atomic<bool> stop_{false};
+        std::atomic<std::uint32_t> epoch_{0};
+        std::atomic<std::size_t> sleepers_{0};
+    };
+}
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <bit>
 #include <ranges>
+#include <span>
 
 #include <nvkg/ecs/chunk.hpp>
 #include <nvkg/ecs/component.hpp>
 #include <nvkg/ecs/detail/hash_map.hpp>
+#include <nvkg/ecs/detail/sparse_map.hpp>
 #include <nvkg/ecs/entity.hpp>
 #include <nvkg/ecs/entity_location.hpp>
 
@@ -24,10 +27,16 @@ public:
     /// @brief Construct a new archetype object
     ///
     /// @param components Components
-    explicit archetype(component_meta_set components) : _components(std::move(components)) {
-        _max_size = get_max_size(_components);
+    /// @param chunk_bytes Size of chunks in bytes
+    /// @param tick Current change tick of the registry
+    explicit archetype(component_meta_set components,
+        std::size_t chunk_bytes = chunk::default_chunk_bytes,
+        const change_tick_t* tick = &initial_change_tick) :
+        _allocator(&chunk_allocator::instance(chunk_bytes)), _tick(tick),
+        _components(std::move(components)) {
+        _max_size = get_max_size(_components, chunk_bytes);
         init_blocks(_components);
-        _chunks.emplace_back(_blocks, _max_size);
+        _chunks.emplace_back(_blocks, _max_size, *_allocator, _tick);
     }
 
     /// @brief Return components set
@@ -51,6 +60,41 @@ public:
         return _chunks;
     }
 
+    /// @brief Return blocks (columns) table shared by all chunks of this archetype
+    ///
+    /// @return const blocks_type&
+    [[nodiscard]] auto blocks() const noexcept -> const blocks_type& {
+        return _blocks;
+    }
+
+    /// @brief Return how many entities a chunk of this archetype holds
+    ///
+    /// @return std::size_t
+    [[nodiscard]] auto max_size() const noexcept -> std::size_t {
+        return _max_size;
+    }
+
+    /// @brief Emplace count entities into a single chunk block by block, see chunk::emplace_back_blocks(). A new chunk
+    /// is started when the last one cannot hold all of them. Entity locations have to be updated by the caller
+    ///
+    /// @param count Number of entities to emplace, at most max_size()
+    /// @param construct Callable constructing a block
+    /// @return entity_location Location of the first entity
+    auto emplace_back_blocks(std::size_t count, auto&& construct) -> entity_location {
+        assert((count <= _max_size) && "Chunk cannot hold that many entities");
+        auto* free_chunk = &ensure_free_chunk();
+        if (free_chunk->max_size() - free_chunk->size() < count) {
+            free_chunk = &_chunks.emplace_back(_blocks, _max_size, *_allocator, _tick);
+        }
+        const auto entry_index = free_chunk->size();
+        free_chunk->emplace_back_blocks(count, construct);
+        return entity_location{
+            this,
+            static_cast<std::uint32_t>(_chunks.size() - 1),
+            static_cast<std::uint32_t>(entry_index),
+        };
+    }
+
     /// @brief Emplace new entity and assign given components to it, return entities location
     ///
     /// @tparam Components Components types
@@ -65,11 +109,66 @@ public:
         free_chunk.emplace_back(ent, std::forward<Components>(components)...);
         return entity_location{
             this,
-            chunk_index,
-            entry_index,
+            static_cast<std::uint32_t>(chunk_index),
+            static_cast<std::uint32_t>(entry_index),
         };
     }
 
+    /// @brief Emplace a range of entities, filling free chunks one after another. For every chunk construct(first,
+    /// count, columns...) is called to construct count components starting at index first of the input in each column,
+    /// then placed(entity, location) is called for every entity emplaced into that chunk. When construct or placed
+    /// throws the entities emplaced so far are removed again, construct must not leave components behind itself
+    ///
+    /// @tparam Components Components types
+    /// @param entities Entities to emplace
+    /// @param construct Callable constructing components
+    /// @param placed Callable receiving the location of every emplaced entity
+    template<component... Components>
+    void emplace_back_n(std::span<const entity> entities, auto&& construct, auto&& placed) {
+        const std::size_t free_in_last = _chunks.empty() ? 0 : _chunks.back().max_size() - _chunks.back().size();
+        if (entities.size() > free_in_last) {
+            _chunks.reserve(_chunks.size() + (entities.size() - free_in_last + _max_size - 1) / _max_size);
+        }
+
+        std::size_t done = 0;
+        std::size_t emplaced = 0;
+        try {
+            while (done < entities.size()) {
+                auto& free_chunk = ensure_free_chunk();
+                const auto chunk_index = _chunks.size() - 1;
+                const auto entry_index = free_chunk.size();
+                const auto count = std::min(entities.size() - done, free_chunk.max_size() - entry_index);
+                const auto segment = entities.subspan(done, count);
+
+                free_chunk.template emplace_back_n<Components...>(
+                    segment, [&](Components*... columns) { construct(done, count, columns...); });
+                emplaced += count;
+                for (std::size_t i = 0; i < count; i++) {
+                    placed(segment[i],
+                        entity_location{
+                            this,
+                            static_cast<std::uint32_t>(chunk_index),
+                            static_cast<std::uint32_t>(entry_index + i),
+                        });
+                }
+                done += count;
+            }
+        } catch (...) {
+            // the emplaced entities are the last ones of the archetype, chunks created for them are dropped as well
+            const auto drop_empty_chunks = [this] {
+                while (_chunks.size() > 1 && _chunks.back().empty()) {
+                    _chunks.pop_back();
+                }
+            };
+            drop_empty_chunks();
+            for (; emplaced > 0; emplaced--) {
+                _chunks.back().pop_back();
+                drop_empty_chunks();
+            }
+            throw;
+        }
+    }
+
     /// @brief Swap erase an entity at given location, returns an entity that has been moved as a result of this
     /// operation or std::nullopt if no entities were moved
     ///
@@ -101,8 +200,8 @@ public:
         auto moved = swap_erase(location);
         auto new_location = entity_location{
             &other,
-            other._chunks.size() - 1,
-            entry_index,
+            static_cast<std::uint32_t>(other._chunks.size() - 1),
+            static_cast<std::uint32_t>(entry_index),
         };
 
         return std::make_pair(new_location, moved);
@@ -159,10 +258,119 @@ public:
         }
     }
 
+    /// @brief Check whether compact() has work to do, i.e. a chunk other than the last one is not full or the last chunk
+    /// is empty
+    ///
+    /// @return true If the archetype is fragmented
+    /// @return false Otherwise
+    [[nodiscard]] auto fragmented() const noexcept -> bool {
+        if (!_chunks.empty() && _chunks.back().empty()) {
+            return true;
+        }
+        for (std::size_t i = 0; i + 1 < _chunks.size(); i++) {
+            if (!_chunks[i].full()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Merge partially filled chunks by moving entities from the last chunk into free slots of the first chunks
+    /// that are not full, releasing chunks that end up empty back to the allocator. An archetype without entities is left
+    /// without chunks. placed(entity, location) is called for every moved entity
+    ///
+    /// @param budget Maximum number of entities to move
+    /// @param placed Callable receiving the new location of every moved entity
+    /// @return std::pair<std::size_t, std::size_t> Number of entities moved and number of chunks released
+    auto compact(std::size_t budget, auto&& placed) -> std::pair<std::size_t, std::size_t> {
+        std::size_t moved = 0;
+        std::size_t released = 0;
+        std::size_t target_index = 0;
+        while (true) {
+            while (!_chunks.empty() && _chunks.back().empty()) {
+                _chunks.pop_back();
+                released++;
+            }
+            while (target_index < _chunks.size() && _chunks[target_index].full()) {
+                target_index++;
+            }
+            if (target_index + 1 >= _chunks.size() || moved == budget) {
+                break;
+            }
+
+            auto& source = _chunks.back();
+            auto& target = _chunks[target_index];
+            const auto count = std::min({ source.size(), target.max_size() - target.size(), budget - moved });
+            for (std::size_t i = 0; i < count; i++) {
+                const auto entry_index = source.move(source.size() - 1, target);
+                source.pop_back();
+                placed(target.entities()[entry_index],
+                    entity_location{
+                        this,
+                        static_cast<std::uint32_t>(target_index),
+                        static_cast<std::uint32_t>(entry_index),
+                    });
+            }
+            moved += count;
+        }
+        if (released > 0) {
+            _chunks.shrink_to_fit();
+        }
+        return std::make_pair(moved, released);
+    }
+
+    /// @brief Return archetype reached by adding component to this archetype or nullptr if that transition has not
+    /// been cached yet
+    ///
+    /// @param component_id Component ID
+    /// @return archetype*
+    [[nodiscard]] auto added_edge(component_id_t component_id) const noexcept -> archetype* {
+        return find_edge(_added_edges, component_id);
+    }
+
+    /// @brief Return archetype reached by removing component from this archetype or nullptr if that transition has not
+    /// been cached yet
+    ///
+    /// @param component_id Component ID
+    /// @return archetype*
+    [[nodiscard]] auto removed_edge(component_id_t component_id) const noexcept -> archetype* {
+        return find_edge(_removed_edges, component_id);
+    }
+
+    /// @brief Cache transition to target archetype when adding component to this archetype. The reverse transition
+    /// is cached on target as well
+    ///
+    /// @param component_id Component ID
+    /// @param target Archetype that has all components of this archetype plus component_id
+    void set_added_edge(component_id_t component_id, archetype* target) {
+        _added_edges[component_id] = target;
+        target->_removed_edges[component_id] = this;
+    }
+
+    /// @brief Cache transition to target archetype when removing component from this archetype. The reverse transition
+    /// is cached on target as well
+    ///
+    /// @param component_id Component ID
+    /// @param target Archetype that has all components of this archetype except component_id
+    void set_removed_edge(component_id_t component_id, archetype* target) {
+        _removed_edges[component_id] = target;
+        target->_added_edges[component_id] = this;
+    }
+
 private:
+    using edges_type = detail::sparse_map<component_id_t, archetype*>;
+
+    static auto find_edge(const edges_type& edges, component_id_t component_id) noexcept -> archetype* {
+        auto iter = edges.find(component_id);
+        if (iter == edges.end()) {
+            return nullptr;
+        }
+        return iter->second;
+    }
+
     void init_blocks(const component_meta_set& components_meta) {
-        // make space for entity
-        auto offset = add_block(0, component_meta::of<entity>());
+        // make space for change ticks header and entity
+        auto offset = add_block(chunk::ticks_size(components_meta.size() + 1), component_meta::of<entity>());
 
         // space for all components
         for (const auto& meta : components_meta) {
@@ -171,42 +379,31 @@ private:
     }
 
     auto add_block(std::size_t offset, const component_meta& meta) -> std::size_t {
-        const std::size_t size_in_bytes = _max_size * meta.type->size;
-        const std::size_t align = meta.type->align;
-
-        _blocks.emplace(meta.id, offset, meta);
-
-        offset += detail::mod_2n(offset, align) + size_in_bytes;
+        offset = detail::align_up(offset, block_alignment(meta));
+        _blocks.add(offset, meta);
+        return offset + _max_size * meta.type->size;
+    }
 
-        return offset;
+    // Every block starts at least at chunk::block_alignment so blocks can be processed with wide SIMD loads
+    static auto block_alignment(const component_meta& meta) noexcept -> std::size_t {
+        return std::max(chunk::block_alignment, meta.type->align);
     }
 
     // Calculates the maximum size of individual components this chunk buffer can hold
-    static auto get_max_size(auto&& components_meta) -> std::size_t {
-        // Calculate size of the following structure:
-        //
-        // struct {
-        //     component_a_t a;
-        //     component_b_t b;
-        //     component_c_t c;
-        //     ...
-        // };
-        //
-        auto aligned_size = aligned_components_size(components_meta);
-
-        // handle subtraction overflow - chunk size is insufficient to hold at least one such entity
-        if (aligned_size > chunk::chunk_bytes) [[unlikely]] {
-            throw insufficient_chunk_size{ aligned_size, chunk::chunk_bytes };
+    static auto get_max_size(auto&& components_meta, std::size_t chunk_bytes) -> std::size_t {
+        // Start from the amount of packed components that fit and shrink until aligned blocks fit as well, padding is
+        // less than block alignment per block so this takes only a few steps
+        auto count = chunk_bytes / packed_components_size(components_meta);
+        while (count > 0 && blocks_size(components_meta, count) > chunk_bytes) {
+            count--;
         }
 
-        // Remaining size for packed components
-        auto remaining_space = chunk::chunk_bytes - aligned_size;
-
-        // Calculate how much components we can pack into remaining space
-        auto remaining_elements_count = remaining_space / packed_components_size(components_meta);
+        // chunk size is insufficient to hold at least one such entity
+        if (count == 0) [[unlikely]] {
+            throw insufficient_chunk_size{ blocks_size(components_meta, 1), chunk_bytes };
+        }
 
-        // The maximum amount of entities we can hold is grater by 1 for which we calculated aligned_size
-        return remaining_elements_count + 1;
+        return count;
     }
 
     // Calculate size of packed structure of components
@@ -217,23 +414,21 @@ private:
             [](const auto& res, const auto& meta) { return res + meta.type->size; });
     }
 
-    // Calculate size of properly aligned structure of components
-    static auto aligned_components_size(auto&& components_meta) noexcept -> std::size_t {
-        auto begin = chunk::alloc_alignment;
-        auto end = begin;
+    // Calculate size of all aligned blocks holding count entities
+    static auto blocks_size(auto&& components_meta, std::size_t count) noexcept -> std::size_t {
+        std::size_t end = chunk::ticks_size(components_meta.size() + 1);
 
-        // Add single component element size accounting for its alignment
-        auto add_elements = [&end](const component_meta& meta) {
-            end += detail::mod_2n(std::bit_cast<std::size_t>(end), meta.type->align);
-            end += meta.type->size;
+        // Add block size accounting for its alignment
+        auto add_block = [&end, count](const component_meta& meta) {
+            end = detail::align_up(end, block_alignment(meta)) + count * meta.type->size;
         };
 
-        add_elements(component_meta::of<entity>());
+        add_block(component_meta::of<entity>());
         for (const auto& meta : components_meta) {
-            add_elements(meta);
+            add_block(meta);
         }
 
-        return end - begin;
+        return end;
     }
 
     template<component_reference ComponentRef>
@@ -251,18 +446,21 @@ private:
     }
 
     auto ensure_free_chunk() -> chunk& {
-        auto& chunk = _chunks.back();
-        if (!chunk.full()) {
-            return chunk;
+        if (!_chunks.empty() && !_chunks.back().full()) {
+            return _chunks.back();
         }
-        _chunks.emplace_back(_blocks, _max_size);
+        _chunks.emplace_back(_blocks, _max_size, *_allocator, _tick);
         return _chunks.back();
     }
 
     std::size_t _max_size{};
+    chunk_allocator* _allocator{};
+    const change_tick_t* _tick{ &initial_change_tick };
     blocks_type _blocks{};
     component_meta_set _components{};
     chunks_storage_t _chunks{};
+    edges_type _added_edges{};
+    edges_type _removed_edges{};
 };
 
 /// @brief Container for archetypes, holds a map from component set to archetype
@@ -276,6 +474,37 @@ public:
     using key_type = storage_type::key_type;
     using mapped_type = storage_type::mapped_type;
 
+    /// @brief Construct a new archetypes container
+    ///
+    /// @param chunk_bytes Size of chunks in bytes for all archetypes, has to be a power of two multiple of
+    /// chunk_allocator::slab_alignment
+    explicit archetypes(std::size_t chunk_bytes = chunk::default_chunk_bytes) : _chunk_bytes(chunk_bytes) {
+        if (!std::has_single_bit(chunk_bytes) || chunk_bytes < chunk_allocator::slab_alignment) [[unlikely]] {
+            throw invalid_chunk_size{ chunk_bytes };
+        }
+    }
+
+    /// @brief Returns the size of chunks in bytes
+    ///
+    /// @return std::size_t
+    [[nodiscard]] auto chunk_bytes() const noexcept -> std::size_t {
+        return _chunk_bytes;
+    }
+
+    /// @brief Returns the current change tick, chunks of all archetypes stamp changed blocks with it
+    ///
+    /// @return change_tick_t
+    [[nodiscard]] auto tick() const noexcept -> change_tick_t {
+        return *_tick;
+    }
+
+    /// @brief Advance the current change tick
+    ///
+    /// @return change_tick_t New tick
+    auto advance_tick() noexcept -> change_tick_t {
+        return ++*_tick;
+    }
+
     /// @brief Get or create an archetype matching the passed Components types
     ///
     /// @tparam Components Component types
@@ -288,28 +517,55 @@ public:
         auto& archetype = _archetypes[_search_component_set];
         if (!archetype) {
             archetype = create_archetype(component_meta_set::create<Components...>());
+            _created.push_back(archetype.get());
         }
         assert((archetype->components().ids() == _search_component_set)
                && "Archetype components do not match the search request");
         return archetype.get();
     }
 
+    /// @brief Get or create an archetype holding the given components. A new archetype lays out its blocks in the
+    /// order of components in the set
+    ///
+    /// @param components Components
+    /// @return archetype*
+    auto ensure_archetype(const component_meta_set& components) -> archetype* {
+        auto& archetype = _archetypes[components.ids()];
+        if (!archetype) {
+            archetype = std::make_unique<ecs::archetype>(components, _chunk_bytes, _tick.get());
+            _created.push_back(archetype.get());
+        }
+        return archetype.get();
+    }
+
     /// @brief Get or create an archetype by adding new Components to an anchor archetype
     ///
     /// @tparam Components Components to add
     /// @param anchor_archetype Anchor archetype
     /// @return archetype*
     template<component... Components>
-    auto ensure_archetype_added(const archetype* anchor_archetype) -> archetype* {
+    auto ensure_archetype_added(archetype* anchor_archetype) -> archetype* {
+        // single component transitions are cached as edges on the anchor archetype
+        if constexpr (sizeof...(Components) == 1) {
+            if (auto* target = anchor_archetype->added_edge(component_id::value<Components...>)) {
+                return target;
+            }
+        }
+
         _search_component_set = anchor_archetype->components().ids();
         (..., _search_component_set.insert<Components>());
 
         auto& archetype = _archetypes[_search_component_set];
         if (!archetype) {
             archetype = create_archetype_added<Components...>(anchor_archetype);
+            _created.push_back(archetype.get());
         }
         assert((archetype->components().ids() == _search_component_set)
                && "Archetype components do not match the search request");
+
+        if constexpr (sizeof...(Components) == 1) {
+            anchor_archetype->set_added_edge(component_id::value<Components...>, archetype.get());
+        }
         return archetype.get();
     }
 
@@ -319,16 +575,28 @@ public:
     /// @param anchor_archetype Anchor archetype
     /// @return archetype*
     template<component... Components>
-    auto ensure_archetype_removed(const archetype* anchor_archetype) -> archetype* {
+    auto ensure_archetype_removed(archetype* anchor_archetype) -> archetype* {
+        // single component transitions are cached as edges on the anchor archetype
+        if constexpr (sizeof...(Components) == 1) {
+            if (auto* target = anchor_archetype->removed_edge(component_id::value<Components...>)) {
+                return target;
+            }
+        }
+
         _search_component_set = anchor_archetype->components().ids();
         (..., _search_component_set.erase<Components>());
 
         auto& archetype = _archetypes[_search_component_set];
         if (!archetype) {
             archetype = create_archetype_removed<Components...>(anchor_archetype);
+            _created.push_back(archetype.get());
         }
         assert((archetype->components().ids() == _search_component_set)
                && "Archetype components do not match the search request");
+
+        if constexpr (sizeof...(Components) == 1) {
+            anchor_archetype->set_removed_edge(component_id::value<Components...>, archetype.get());
+        }
         return archetype.get();
     }
 
@@ -367,23 +635,41 @@ public:
         return _archetypes.size();
     }
 
+    /// @brief Returns the archetypes generation. Generation is incremented every time a new archetype is created, so
+    /// it can be used to find out whether cached archetype lookups are outdated
+    ///
+    /// @return std::size_t
+    [[nodiscard]] auto generation() const noexcept -> std::size_t {
+        return _created.size();
+    }
+
+    /// @brief Returns archetypes created since given generation in creation order
+    ///
+    /// @param generation Generation to start from
+    /// @return std::span<archetype* const>
+    [[nodiscard]] auto created_since(std::size_t generation) const noexcept -> std::span<archetype* const> {
+        assert((generation <= _created.size()) && "Generation exceeds archetypes generation");
+        return std::span<archetype* const>(_created).subspan(generation);
+    }
+
 private:
-    static auto create_archetype(auto&& components_meta) -> decltype(auto) {
-        return std::make_unique<ecs::archetype>(std::forward<decltype(components_meta)>(components_meta));
+    auto create_archetype(auto&& components_meta) const -> decltype(auto) {
+        return std::make_unique<ecs::archetype>(
+            std::forward<decltype(components_meta)>(components_meta), _chunk_bytes, _tick.get());
     }
 
     template<component... Components>
-    static auto create_archetype_added(const archetype* anchor_archetype) -> decltype(auto) {
+    auto create_archetype_added(const archetype* anchor_archetype) const -> decltype(auto) {
         auto components_meta = anchor_archetype->components();
         (..., components_meta.insert<Components>());
-        return std::make_unique<ecs::archetype>(std::move(components_meta));
+        return std::make_unique<ecs::archetype>(std::move(components_meta), _chunk_bytes, _tick.get());
     }
 
     template<component... Components>
-    static auto create_archetype_removed(const archetype* anchor_archetype) -> decltype(auto) {
+    auto create_archetype_removed(const archetype* anchor_archetype) const -> decltype(auto) {
         auto components_meta = anchor_archetype->components();
         (..., components_meta.erase<Components>());
-        return std::make_unique<ecs::archetype>(std::move(components_meta));
+        return std::make_unique<ecs::archetype>(std::move(components_meta), _chunk_bytes, _tick.get());
     }
 
     // Member component set is here to speed up archetype lookup.
@@ -394,7 +680,14 @@ private:
     // In-ability to simply find() in the hash map due to a type mismatch is one of them.
     component_set _search_component_set{};
 
+    std::size_t _chunk_bytes{};
+
+    // Heap allocated so chunks keep pointing to it when the container is moved
+    std::unique_ptr<change_tick_t> _tick{ std::make_unique<change_tick_t>(initial_change_tick) };
     storage_type _archetypes{};
+
+    // Non-owning archetype pointers in creation order, its size is the archetypes generation
+    std::vector<archetype*> _created{};
 };
 
 } // namespace ecs
\ No newline at end of file
@@ -1,20 +1,33 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <optional>
+#include <span>
 #include <type_traits>
+#include <vector>
 
+#include <nvkg/ecs/chunk_allocator.hpp>
 #include <nvkg/ecs/component.hpp>
 #include <nvkg/ecs/detail/bits.hpp>
-#include <nvkg/ecs/detail/sparse_map.hpp>
 #include <nvkg/ecs/entity.hpp>
 #include <nvkg/ecs/exceptions.hpp>
 
 
 namespace ecs {
 
-/// @brief Block metadata holds pointers where it begins, ends and a component metadata it holds
+/// @brief Change tick type. Registry keeps a current tick, chunks stamp every block (column) with the current tick when
+/// it is accessed mutably or the chunk changes structurally
+using change_tick_t = std::uint64_t;
+
+/// @brief Tick a registry starts at, a tick of 0 is older than any stamp
+inline constexpr change_tick_t initial_change_tick = 1;
+
+/// @brief Block metadata holds the offset where it begins and a component metadata it holds
 struct block_metadata {
     std::size_t offset{};
     component_meta meta{};
@@ -23,27 +36,118 @@ struct block_metadata {
     }
 };
 
-using blocks_type = detail::sparse_map<component_id_t, block_metadata>;
+/// @brief Dense table of blocks (columns) of an archetype. Blocks are stored in a packed array in the order they were
+/// added, the entity block always comes first. The index of a block is looked up directly by component ID, which are
+/// small sequential numbers, without any hashing or sparse indirection.
+class blocks_type {
+public:
+    using storage_type = std::vector<block_metadata>;
+    using const_iterator = typename storage_type::const_iterator;
+
+    /// @brief Value for components not present in the table
+    static constexpr auto npos = std::numeric_limits<std::uint32_t>::max();
+
+    /// @brief Add block for a component
+    ///
+    /// @param offset Block offset in the chunk buffer
+    /// @param meta Component metadata
+    void add(std::size_t offset, const component_meta& meta) {
+        if (meta.id >= _index_by_id.size()) {
+            _index_by_id.resize(meta.id + 1, npos);
+        }
+        _index_by_id[meta.id] = static_cast<std::uint32_t>(_blocks.size());
+        _blocks.emplace_back(offset, meta);
+    }
+
+    /// @brief Return index of the block holding component ID or npos
+    ///
+    /// @param id Component ID
+    /// @return std::size_t Block index
+    [[nodiscard]] auto index_of(component_id_t id) const noexcept -> std::size_t {
+        if (id < _index_by_id.size()) {
+            return _index_by_id[id];
+        }
+        return npos;
+    }
+
+    /// @brief Find block holding component ID
+    ///
+    /// @param id Component ID
+    /// @return const block_metadata* Block or nullptr if there is no such component
+    [[nodiscard]] auto find(component_id_t id) const noexcept -> const block_metadata* {
+        auto index = index_of(id);
+        if (index == npos) {
+            return nullptr;
+        }
+        return &_blocks[index];
+    }
+
+    /// @brief Return block at index
+    ///
+    /// @param index Block index
+    /// @return const block_metadata& Block
+    [[nodiscard]] auto operator[](std::size_t index) const noexcept -> const block_metadata& {
+        return _blocks[index];
+    }
+
+    /// @brief Return number of blocks
+    ///
+    /// @return std::size_t
+    [[nodiscard]] auto size() const noexcept -> std::size_t {
+        return _blocks.size();
+    }
+
+    /// @brief Return const iterator to the first block
+    ///
+    /// @return const_iterator
+    [[nodiscard]] auto begin() const noexcept -> const_iterator {
+        return _blocks.begin();
+    }
+
+    /// @brief Return const iterator past the last block
+    ///
+    /// @return const_iterator
+    [[nodiscard]] auto end() const noexcept -> const_iterator {
+        return _blocks.end();
+    }
 
-/// @brief Chunk holds a 16 Kb block of memory that holds components in blocks:
-/// |A1|A2|A3|...padding|B1|B2|B3|...padding|C1|C2|C3...padding where A, B, C are component types and A1, B1, C1 and
-/// others are components instances.
+private:
+    storage_type _blocks{};
+    std::vector<std::uint32_t> _index_by_id{};
+};
+
+/// @brief Chunk holds a block of memory (16 Kb by default) that holds components in blocks:
+/// |T|...padding|A1|A2|A3|...padding|B1|B2|B3|...padding|C1|C2|C3...padding where A, B, C are component types and A1,
+/// B1, C1 and others are components instances. T is a header with a change tick per block.
 class chunk {
 public:
-    /// @brief Chunk size in bytes
-    static constexpr std::size_t chunk_bytes = static_cast<const std::size_t>(16U * 1024); // 16 KB
+    /// @brief Default chunk size in bytes
+    static constexpr std::size_t default_chunk_bytes = static_cast<std::size_t>(16U * 1024); // 16 KB
 
-    /// @brief Block allocation alignment
-    static constexpr std::size_t alloc_alignment = alignof(entity);
+    /// @brief Minimum alignment of every block start, a cache line which is enough for AVX2 and AVX-512 loads
+    static constexpr std::size_t block_alignment = 64;
+
+    /// @brief Return size of the change ticks header at the beginning of a chunk with given number of blocks
+    ///
+    /// @param block_count Number of blocks
+    /// @return std::size_t Header size in bytes
+    static constexpr auto ticks_size(std::size_t block_count) noexcept -> std::size_t {
+        return block_count * sizeof(change_tick_t);
+    }
 
     /// @brief Construct a new chunk object
     ///
-    /// @param set Component metadata set
-    chunk(const blocks_type& blocks, std::size_t max_size) :
-        _blocks(&blocks), _max_size(max_size),
-        // TODO: we could use std::aligned_alloc with alignment of an entity type,
-        // but it is not available in MSVC. We use std::malloc which uses maximum alignment.
-        _buffer(reinterpret_cast<std::byte*>(std::malloc(chunk_bytes))) {
+    /// @param blocks Blocks table of the archetype
+    /// @param max_size Maximum amount of entities this chunk can hold
+    /// @param allocator Allocator to allocate the chunk buffer from
+    /// @param tick Current change tick of the registry, read whenever a block is stamped
+    chunk(const blocks_type& blocks,
+        std::size_t max_size,
+        chunk_allocator& allocator,
+        const change_tick_t* tick = &initial_change_tick) :
+        _buffer(allocator.allocate()),
+        _max_size(max_size), _blocks(&blocks), _allocator(&allocator), _tick(tick) {
+        std::uninitialized_fill_n(ticks(), _blocks->size(), *_tick);
     }
 
     /// @brief Deleted copy constructor
@@ -60,7 +164,8 @@ public:
     ///
     /// @param rhs Another chunk
     chunk(chunk&& rhs) noexcept :
-        _buffer(rhs._buffer), _size(rhs._size), _max_size(rhs._max_size), _blocks(rhs._blocks) {
+        _buffer(rhs._buffer), _size(rhs._size), _max_size(rhs._max_size), _blocks(rhs._blocks),
+        _allocator(rhs._allocator), _tick(rhs._tick) {
         rhs._buffer = nullptr;
     }
 
@@ -73,6 +178,8 @@ public:
         _size = rhs._size;
         _max_size = rhs._max_size;
         _blocks = rhs._blocks;
+        _allocator = rhs._allocator;
+        _tick = rhs._tick;
 
         rhs._buffer = nullptr;
         return *this;
@@ -83,12 +190,12 @@ public:
         if (_buffer == nullptr) {
             return;
         }
-        for (const auto& [id, block] : *_blocks) {
+        for (const auto& block : *_blocks) {
             for (std::size_t i = 0; i < _size; i++) {
                 block.meta.type->destruct(_buffer + block.offset + i * block.meta.type->size);
             }
         }
-        std::free(_buffer); // NOLINT(cppcoreguidelines-owning-memory)
+        _allocator->deallocate(_buffer);
     }
 
     /// @brief Emplace back components into blocks
@@ -101,6 +208,50 @@ public:
         std::construct_at(ptr_unchecked<entity>(size()), ent);
         (..., std::construct_at(ptr_mut<Args>(size()), std::move(args)));
         _size++;
+        mark_all_changed();
+    }
+
+    /// @brief Emplace back a range of entities at once. Entities are copied into the entity block in one go, components
+    /// are constructed by construct which receives a pointer to the first free slot of every block in Args and has to
+    /// construct entities.size() components in each of them
+    ///
+    /// @tparam Args Component types
+    /// @param entities Entities to emplace
+    /// @param construct Callable constructing components
+    template<component... Args>
+    void emplace_back_n(std::span<const entity> entities, auto&& construct) {
+        assert((size() + entities.size() <= max_size()) && "Chunk cannot hold that many entities");
+        std::memcpy(ptr_unchecked<entity>(size()), entities.data(), entities.size_bytes());
+        construct(ptr_mut<Args>(size())...);
+        _size += entities.size();
+        mark_all_changed();
+    }
+
+    /// @brief Emplace back count entities block by block. construct(block, first) is called once for every block, the
+    /// entity block included, and has to construct count values of the block type starting at first. When construct
+    /// throws it must not leave values behind in that block, values of blocks constructed before are destroyed
+    ///
+    /// @param count Number of entities to emplace
+    /// @param construct Callable constructing a block
+    void emplace_back_blocks(std::size_t count, auto&& construct) {
+        assert((size() + count <= max_size()) && "Chunk cannot hold that many entities");
+        std::size_t constructed = 0;
+        try {
+            for (const auto& block : *_blocks) {
+                construct(block, _buffer + block.offset + _size * block.meta.type->size);
+                constructed++;
+            }
+        } catch (...) {
+            for (std::size_t i = 0; i < constructed; i++) {
+                const auto& block = (*_blocks)[i];
+                for (std::size_t j = 0; j < count; j++) {
+                    block.meta.type->destruct(_buffer + block.offset + (_size + j) * block.meta.type->size);
+                }
+            }
+            throw;
+        }
+        _size += count;
+        mark_all_changed();
     }
 
     /// @brief Remove back elements from blocks
@@ -108,6 +259,7 @@ public:
         assert((!empty()) && "Chunk is empty, cannot pop out any entity");
         _size--;
         destroy_at(_size);
+        mark_all_changed();
     }
 
     /// @brief Swap end removes a components in blocks at position index and swaps it with the last element from
@@ -125,13 +277,14 @@ public:
         }
         assert((!other.empty()) && "Other chunk is empty, cannot move entity out of it");
         const std::size_t other_chunk_index = other._size - 1;
+        assert((_blocks == other._blocks) && "Swap erase is only possible between chunks of the same archetype");
         entity ent = *other.ptr_unchecked<entity>(other_chunk_index);
-        for (const auto& [id, block] : *_blocks) {
-            auto other_block = other._blocks->find(id)->second;
+        for (const auto& block : *_blocks) {
             const auto* type = block.meta.type;
-            auto* ptr = other._buffer + other_block.offset + other_chunk_index * type->size;
+            auto* ptr = other._buffer + block.offset + other_chunk_index * type->size;
             type->move_assign(_buffer + block.offset + index * type->size, ptr);
         }
+        mark_all_changed();
         other.pop_back();
         return ent;
     }
@@ -145,15 +298,17 @@ public:
         assert((index < _size) && "Entity index exceeds chunk size");
         assert((!other_chunk.full()) && "Other chunk is full, cannot move entity to it");
         const std::size_t other_chunk_index = other_chunk._size;
-        for (const auto& [id, block] : *_blocks) {
+        for (const auto& block : *_blocks) {
             const auto* type = block.meta.type;
-            if (!other_chunk._blocks->contains(id)) {
+            const auto* other_block = other_chunk._blocks->find(block.meta.id);
+            if (other_block == nullptr) {
                 continue;
             }
-            auto* ptr = other_chunk._buffer + other_chunk._blocks->at(id).offset + other_chunk_index * type->size;
+            auto* ptr = other_chunk._buffer + other_block->offset + other_chunk_index * type->size;
             type->move_construct(ptr, _buffer + block.offset + index * type->size);
         }
         other_chunk._size++;
+        other_chunk.mark_all_changed();
         return other_chunk_index;
     }
 
@@ -167,7 +322,7 @@ public:
         return ptr_unchecked_impl<const T*>(*this, index);
     }
 
-    /// @brief Give a pointer to a component T at index
+    /// @brief Give a pointer to a component T at index, stamps the block of T with the current tick
     ///
     /// @tparam T Component type
     /// @param index Index
@@ -175,7 +330,63 @@ public:
     template<component T>
     inline auto ptr_mut(std::size_t index) -> T* {
         static_assert(!std::is_same_v<T, entity>, "Cannot give a mutable pointer/reference to the entity");
-        return ptr_unchecked_impl<T*>(*this, index);
+        const auto block_index = get_block_index<T>();
+        mark_changed(block_index);
+        return ptr_at_offset<T>((*_blocks)[block_index].offset, index);
+    }
+
+    /// @brief Give a pointer to a component T at index in a block starting at offset. The offset has to be resolved
+    /// beforehand from the archetype blocks, no lookup is done
+    ///
+    /// @tparam T Component type, may be const qualified
+    /// @param offset Block offset
+    /// @param index Index
+    /// @return T* Resulting pointer
+    template<typename T>
+    inline auto ptr_at_offset(std::size_t offset, std::size_t index) noexcept -> T* {
+        return reinterpret_cast<T*>(_buffer + offset) + index;
+    }
+
+    /// @brief Give a const pointer to a component T at index in a block starting at offset
+    ///
+    /// @tparam T Component type, may be const qualified
+    /// @param offset Block offset
+    /// @param index Index
+    /// @return const T* Resulting pointer
+    template<typename T>
+    inline auto ptr_at_offset(std::size_t offset, std::size_t index) const noexcept -> const T* {
+        return reinterpret_cast<const T*>(_buffer + offset) + index;
+    }
+
+    /// @brief Return the tick block at block_index was last changed at
+    ///
+    /// @param block_index Block index
+    /// @return change_tick_t Change tick
+    [[nodiscard]] auto change_tick(std::size_t block_index) const noexcept -> change_tick_t {
+        assert((block_index < _blocks->size()) && "Block index exceeds the number of blocks");
+        return ticks()[block_index];
+    }
+
+    /// @brief Stamp block at block_index with the current tick
+    ///
+    /// @param block_index Block index
+    void mark_changed(std::size_t block_index) noexcept {
+        assert((block_index < _blocks->size()) && "Block index exceeds the number of blocks");
+        ticks()[block_index] = *_tick;
+    }
+
+    /// @brief Stamp all blocks with the current tick
+    void mark_all_changed() noexcept {
+        std::fill_n(ticks(), _blocks->size(), *_tick);
+    }
+
+    /// @brief Return span over entities stored in this chunk
+    ///
+    /// @return std::span<const entity> Entities
+    [[nodiscard]] auto entities() const noexcept -> std::span<const entity> {
+        // entity block is always the first block
+        assert(((*_blocks)[0].meta.id == component_id::value<entity>) && "First block does not hold entities");
+        return std::span<const entity>(ptr_at_offset<entity>((*_blocks)[0].offset, 0), _size);
     }
 
     /// @brief Get max size, how many elements can this chunk hold
@@ -222,16 +433,35 @@ private:
     template<typename P>
     [[nodiscard]] static inline auto ptr_unchecked_impl(auto&& self, std::size_t index) -> P {
         using component_type = std::remove_const_t<std::remove_pointer_t<P>>;
-        const auto& block = self.get_block(component_id::value<component_type>);
+        const auto& block = self.template get_block<component_type>();
         return (reinterpret_cast<P>(self._buffer + block.offset) + index);
     }
 
-    [[nodiscard]] auto get_block(component_id_t id) const -> const block_metadata& {
-        return _blocks->at(id);
+    template<component T>
+    [[nodiscard]] auto get_block() const -> const block_metadata& {
+        return (*_blocks)[get_block_index<T>()];
+    }
+
+    template<component T>
+    [[nodiscard]] auto get_block_index() const -> std::size_t {
+        const auto index = _blocks->index_of(component_id::value<T>);
+        if (index == blocks_type::npos) [[unlikely]] {
+            throw component_not_found{ type_meta::of<T>() };
+        }
+        return index;
+    }
+
+    // Change ticks header lives at the beginning of the buffer, blocks start after it
+    [[nodiscard]] auto ticks() noexcept -> change_tick_t* {
+        return reinterpret_cast<change_tick_t*>(_buffer);
+    }
+
+    [[nodiscard]] auto ticks() const noexcept -> const change_tick_t* {
+        return reinterpret_cast<const change_tick_t*>(_buffer);
     }
 
     inline void destroy_at(std::size_t index) noexcept {
-        for (const auto& [id, block] : *_blocks) {
+        for (const auto& block : *_blocks) {
             block.meta.type->destruct(_buffer + block.offset + index * block.meta.type->size);
         }
     }
@@ -240,6 +470,8 @@ private:
     std::size_t _size{};
     std::size_t _max_size{};
     const blocks_type* _blocks;
+    chunk_allocator* _allocator;
+    const change_tick_t* _tick;
 };
 
 /// @brief Component fetch is a namespace for routines that figure out based on input component_reference how to fetch
@@ -251,11 +483,7 @@ struct component_fetch {
     template<component_reference C>
     static auto fetch_pointer(auto&& chunk, std::size_t index)
         -> const decay_component_t<C>* requires(const_component_reference_v<C>) {
-            try {
-                return chunk.template ptr_const<decay_component_t<C>>(index);
-            } catch (const std::out_of_range&) {
-                throw component_not_found{ type_meta::of<decay_component_t<C>>() };
-            }
+            return chunk.template ptr_const<decay_component_t<C>>(index);
         }
 
     /// @brief Fetches pointer for mutable component reference
@@ -264,12 +492,17 @@ struct component_fetch {
     template<component_reference C>
     static auto fetch_pointer(auto&& chunk, std::size_t index)
         -> decay_component_t<C>* requires(mutable_component_reference_v<C>) {
-            try {
-                return chunk.template ptr_mut<decay_component_t<C>>(index);
-            } catch (const std::out_of_range&) {
-                throw component_not_found{ type_meta::of<decay_component_t<C>>() };
-            }
+            return chunk.template ptr_mut<decay_component_t<C>>(index);
         }
+
+    /// @brief Fetches pointer for a component reference from a block offset resolved beforehand
+    ///
+    /// @tparam C Component reference
+    template<component_reference C>
+    static auto fetch_pointer(auto&& chunk, std::size_t offset, std::size_t index) noexcept
+        -> std::add_pointer_t<std::remove_reference_t<C>> {
+        return chunk.template ptr_at_offset<std::remove_reference_t<C>>(offset, index);
+    }
 };
 
 /// @brief A type aware view into a chunk components
@@ -307,6 +540,15 @@ public:
             _ptrs(std::make_tuple(component_fetch::fetch_pointer<Args>(c, index)...)) {
         }
 
+        /// @brief Create iterator out of chunk and block offsets of Args pointing to the index
+        ///
+        /// @param c Chunk reference
+        /// @param offsets Block offsets in order of Args
+        /// @param index Index this iterator is pointing to
+        constexpr iterator(chunk_type c, const std::size_t* offsets, std::size_t index) noexcept :
+            iterator(c, offsets, index, std::index_sequence_for<Args...>{}) {
+        }
+
         /// @brief Default copy constructor
         ///
         /// @param rhs Right hand side iterator
@@ -360,6 +602,12 @@ public:
         constexpr auto operator<=>(const iterator& rhs) const noexcept = default;
 
     private:
+        template<std::size_t... I>
+        constexpr iterator(chunk_type c, const std::size_t* offsets, std::size_t index, std::index_sequence<I...>) noexcept
+            :
+            _ptrs(std::make_tuple(component_fetch::fetch_pointer<Args>(c, offsets[I], index)...)) {
+        }
+
         std::tuple<std::add_pointer_t<std::remove_reference_t<Args>>...> _ptrs;
     };
 
@@ -369,22 +617,56 @@ public:
     explicit chunk_view(chunk_type c) : _chunk(c) {
     }
 
+    /// @brief Construct a new chunk view object with block offsets of Args resolved beforehand, iterators created by
+    /// such a view do not look up any blocks
+    ///
+    /// @param c Chunk reference
+    /// @param offsets Block offsets in order of Args
+    chunk_view(chunk_type c, const std::size_t* offsets) noexcept : _chunk(c), _offsets(offsets) {
+    }
+
+    /// @brief Return spans over the entities and over the blocks of Args in this chunk. Requires the view to be
+    /// constructed with block offsets
+    ///
+    /// @return std::tuple<std::span<const entity>, std::span<Args>...> Entities and component spans
+    [[nodiscard]] auto spans() const noexcept
+        -> std::tuple<std::span<const entity>, std::span<std::remove_reference_t<Args>>...> {
+        assert(_offsets && "Chunk view has no block offsets");
+        return spans_impl(std::index_sequence_for<Args...>{});
+    }
+
     /// @brief Return iterator to the beginning of a chunk
     ///
     /// @return constexpr iterator
-    [[nodiscard]] constexpr auto begin() noexcept -> iterator {
+    [[nodiscard]] constexpr auto begin() -> iterator {
+        if (_offsets) {
+            return iterator(_chunk, _offsets, 0);
+        }
         return iterator(_chunk, 0);
     }
 
     /// @brief Return iterator to the end of a chunk
     ///
     /// @return constexpr iterator
-    [[nodiscard]] constexpr auto end() noexcept -> iterator {
+    [[nodiscard]] constexpr auto end() -> iterator {
+        if (_offsets) {
+            return iterator(_chunk, _offsets, _chunk.size());
+        }
         return iterator(_chunk, _chunk.size());
     }
 
 private:
+    template<std::size_t... I>
+    auto spans_impl(std::index_sequence<I...> /*unused*/) const noexcept
+        -> std::tuple<std::span<const entity>, std::span<std::remove_reference_t<Args>>...> {
+        const auto size = _chunk.size();
+        return std::make_tuple(_chunk.entities(),
+            std::span<std::remove_reference_t<Args>>(
+                component_fetch::fetch_pointer<Args>(_chunk, _offsets[I], 0), size)...);
+    }
+
     chunk_type _chunk;
+    const std::size_t* _offsets{};
 };
 
 } // namespace ecs
\ No newline at end of file
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined __linux__
+#include <sys/mman.h>
+#endif
+
+namespace ecs {
+
+/// @brief Chunk allocator statistics
+struct chunk_allocator_stats {
+    /// @brief Number of slabs allocated from the system
+    std::size_t slab_count{};
+
+    /// @brief Total bytes reserved by all slabs
+    std::size_t reserved_bytes{};
+
+    /// @brief Number of chunk blocks handed out
+    std::size_t used_blocks{};
+
+    /// @brief Total bytes of chunk blocks handed out
+    std::size_t used_bytes{};
+
+    /// @brief Number of chunk blocks in the free list
+    std::size_t free_blocks{};
+};
+
+/// @brief Chunk allocator hands out fixed size blocks carved from large page aligned slabs. Freed blocks are kept in an
+/// intrusive free list and reused, slabs are only returned to the system by trim() or when the allocator is destroyed.
+/// This keeps spawn/despawn heavy frames away from the system allocator.
+class chunk_allocator {
+public:
+    /// @brief Slab alignment, a page
+    static constexpr std::size_t slab_alignment = 4096;
+
+    /// @brief Huge page size, slabs backed by huge pages are aligned and sized to it
+    static constexpr std::size_t huge_page_bytes = static_cast<std::size_t>(2U * 1024 * 1024); // 2 MB
+
+    /// @brief Default number of blocks per slab
+    static constexpr std::size_t default_blocks_per_slab = 64;
+
+    /// @brief Construct a new chunk allocator object
+    ///
+    /// @param block_bytes Size of a single block, must be a multiple of the slab alignment
+    /// @param blocks_per_slab Number of blocks carved out of a single slab
+    /// @param huge_pages Advise the system to back slabs with huge pages (linux only)
+    explicit chunk_allocator(std::size_t block_bytes,
+        std::size_t blocks_per_slab = default_blocks_per_slab,
+        bool huge_pages = false) :
+        _block_bytes(block_bytes),
+        _blocks_per_slab(blocks_per_slab), _huge_pages(huge_pages) {
+        assert((_block_bytes % slab_alignment == 0) && "Block size must be a multiple of the slab alignment");
+        if (_huge_pages) {
+            // round slab up to a whole number of huge pages
+            auto slab_bytes = _block_bytes * _blocks_per_slab;
+            slab_bytes = (slab_bytes + huge_page_bytes - 1) / huge_page_bytes * huge_page_bytes;
+            _blocks_per_slab = slab_bytes / _block_bytes;
+        }
+    }
+
+    /// @brief Deleted copy constructor
+    ///
+    /// @param rhs Another allocator
+    chunk_allocator(const chunk_allocator& rhs) = delete;
+
+    /// @brief Deleted copy assignment operator
+    ///
+    /// @param rhs Another allocator
+    auto operator=(const chunk_allocator& rhs) -> chunk_allocator& = delete;
+
+    /// @brief Destroy the chunk allocator object, releases all slabs
+    ~chunk_allocator() {
+        for (auto* slab : _slabs) {
+            std::free(slab); // NOLINT(cppcoreguidelines-owning-memory)
+        }
+    }
+
+    /// @brief Allocate a block
+    ///
+    /// @return std::byte* Block of block_bytes() bytes aligned to the slab alignment
+    [[nodiscard]] auto allocate() -> std::byte* {
+        const std::scoped_lock lock(_mutex);
+        if (_free_list == nullptr) {
+            add_slab();
+        }
+        auto* block = _free_list;
+        _free_list = block->next;
+        _free_blocks--;
+        _used_blocks++;
+        return reinterpret_cast<std::byte*>(block);
+    }
+
+    /// @brief Return a block to the free list
+    ///
+    /// @param ptr Block previously returned by allocate()
+    void deallocate(std::byte* ptr) noexcept {
+        if (ptr == nullptr) {
+            return;
+        }
+        const std::scoped_lock lock(_mutex);
+        auto* block = ::new (ptr) free_block{ _free_list };
+        _free_list = block;
+        _free_blocks++;
+        _used_blocks--;
+    }
+
+    /// @brief Return slabs whose blocks are all in the free list to the system. Meant to be called after a registry
+    /// compaction released chunks, at a point where no other thread is spawning entities
+    ///
+    /// @return std::size_t Number of bytes released
+    auto trim() -> std::size_t {
+        const std::scoped_lock lock(_mutex);
+        if (_free_blocks < _blocks_per_slab) {
+            return 0;
+        }
+
+        const std::size_t slab_bytes = _block_bytes * _blocks_per_slab;
+        std::ranges::sort(_slabs);
+        auto slab_of = [&](const free_block* block) {
+            const auto* ptr = reinterpret_cast<const std::byte*>(block);
+            return static_cast<std::size_t>(std::ranges::upper_bound(_slabs, ptr) - _slabs.begin() - 1);
+        };
+
+        std::vector<std::size_t> free_counts(_slabs.size());
+        for (auto* block = _free_list; block != nullptr; block = block->next) {
+            free_counts[slab_of(block)]++;
+        }
+
+        // rebuild the free list without blocks of released slabs, keeping the order of the rest
+        free_block* head = nullptr;
+        free_block** tail = &head;
+        for (auto* block = _free_list; block != nullptr; block = block->next) {
+            if (free_counts[slab_of(block)] != _blocks_per_slab) {
+                *tail = block;
+                tail = &block->next;
+            }
+        }
+        *tail = nullptr;
+        _free_list = head;
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < _slabs.size(); i++) {
+            if (free_counts[i] == _blocks_per_slab) {
+                std::free(_slabs[i]); // NOLINT(cppcoreguidelines-owning-memory)
+            } else {
+                _slabs[kept++] = _slabs[i];
+            }
+        }
+        const std::size_t released = _slabs.size() - kept;
+        _slabs.resize(kept);
+        _free_blocks -= released * _blocks_per_slab;
+        return released * slab_bytes;
+    }
+
+    /// @brief Return the block size
+    ///
+    /// @return std::size_t Block size in bytes
+    [[nodiscard]] auto block_bytes() const noexcept -> std::size_t {
+        return _block_bytes;
+    }
+
+    /// @brief Return allocator statistics
+    ///
+    /// @return chunk_allocator_stats Statistics
+    [[nodiscard]] auto stats() const -> chunk_allocator_stats {
+        const std::scoped_lock lock(_mutex);
+        return chunk_allocator_stats{
+            _slabs.size(),
+            _slabs.size() * _blocks_per_slab * _block_bytes,
+            _used_blocks,
+            _used_blocks * _block_bytes,
+            _free_blocks,
+        };
+    }
+
+    /// @brief Return the allocator for blocks of block_bytes shared by all archetypes. Define CO_ECS_HUGE_PAGES to back
+    /// slabs with huge pages
+    ///
+    /// @param block_bytes Block size
+    /// @return chunk_allocator& Shared allocator
+    static auto instance(std::size_t block_bytes) -> chunk_allocator& {
+        // Intentionally never destroyed, chunks owned by static registries may outlive any static allocator
+        static auto* allocators = new std::vector<std::unique_ptr<chunk_allocator>>();
+        static std::mutex mutex;
+
+        const std::scoped_lock lock(mutex);
+        for (auto& allocator : *allocators) {
+            if (allocator->block_bytes() == block_bytes) {
+                return *allocator;
+            }
+        }
+#if defined CO_ECS_HUGE_PAGES
+        return *allocators->emplace_back(std::make_unique<chunk_allocator>(block_bytes, default_blocks_per_slab, true));
+#else
+        return *allocators->emplace_back(std::make_unique<chunk_allocator>(block_bytes));
+#endif
+    }
+
+private:
+    struct free_block {
+        free_block* next;
+    };
+
+    void add_slab() {
+        const std::size_t slab_bytes = _block_bytes * _blocks_per_slab;
+        const std::size_t alignment = _huge_pages ? huge_page_bytes : slab_alignment;
+        auto* slab = static_cast<std::byte*>(std::aligned_alloc(alignment, slab_bytes));
+        if (slab == nullptr) [[unlikely]] {
+            throw std::bad_alloc{};
+        }
+#if defined __linux__ && defined MADV_HUGEPAGE
+        if (_huge_pages) {
+            madvise(slab, slab_bytes, MADV_HUGEPAGE);
+        }
+#endif
+        _slabs.push_back(slab);
+
+        // push blocks in reverse so they are handed out in address order
+        for (std::size_t i = _blocks_per_slab; i > 0; i--) {
+            _free_list = ::new (slab + (i - 1) * _block_bytes) free_block{ _free_list };
+        }
+        _free_blocks += _blocks_per_slab;
+    }
+
+    std::size_t _block_bytes{};
+    std::size_t _blocks_per_slab{};
+    bool _huge_pages{};
+
+    mutable std::mutex _mutex{};
+    free_block* _free_list{};
+    std::size_t _used_blocks{};
+    std::size_t _free_blocks{};
+    std::vector<std::byte*> _slabs{};
+};
+
+} // namespace ecs
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <nvkg/ecs/detail/bits.hpp>
+#include <nvkg/ecs/registry.hpp>
+
+namespace ecs {
+
+namespace detail {
+
+/// @brief Paged arena for command payloads. Pages are never moved, so payloads do not need to be relocatable, and are
+/// kept across resets so recording after a flush does not allocate.
+class command_arena {
+public:
+    /// @brief Default page size
+    static constexpr std::size_t page_bytes = 4096;
+
+    /// @brief Allocate uninitialized memory
+    ///
+    /// @param size Size in bytes
+    /// @param align Alignment
+    /// @return void* Memory
+    [[nodiscard]] auto allocate(std::size_t size, std::size_t align) -> void* {
+        while (true) {
+            if (_page == _pages.size()) {
+                auto bytes = std::max(page_bytes, size + align);
+                _pages.push_back(page{ std::make_unique<std::byte[]>(bytes), bytes });
+            }
+
+            auto& page = _pages[_page];
+            const auto base = reinterpret_cast<std::uintptr_t>(page.data.get());
+            const auto offset = align_up(base + _offset, align) - base;
+            if (offset + size <= page.size) {
+                _offset = offset + size;
+                return page.data.get() + offset;
+            }
+
+            _page++;
+            _offset = 0;
+        }
+    }
+
+    /// @brief Make all pages available again, payloads have to be destroyed beforehand
+    void reset() noexcept {
+        _page = 0;
+        _offset = 0;
+    }
+
+private:
+    struct page {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+
+    std::vector<page> _pages{};
+    std::size_t _page{};
+    std::size_t _offset{};
+};
+
+/// @brief Key type used to assign an ID to a set of components of a create command
+///
+/// @tparam Components Component types
+template<component... Components>
+struct create_signature {};
+
+/// @brief Type for family used to generate create command signature IDs
+using create_signature_id = type_id<struct _create_signature_family_t, std::uint32_t>;
+
+} // namespace detail
+
+/// @brief Command buffer records structural changes (create, destroy, set, remove) and applies them to a registry in
+/// a later flush. Structural changes invalidate chunk iterators, so systems iterating a view, possibly in parallel,
+/// record them here instead and the owner flushes the buffer once iteration is done.
+///
+/// Every thread records into its own command list, recording from many threads at once is safe. Flushing is not,
+/// it has to happen when no thread is recording anymore.
+///
+/// A flush applies creates first, grouped by component set so every group resolves its archetype once and fills chunks
+/// in bulk. Component sets and removes follow, sorted by component and source archetype so consecutive commands move
+/// entities along the same archetype edge, but they are applied one entity at a time. Destroys come last. Commands on
+/// entities that are not alive anymore are skipped. If applying a command throws, the exception propagates, commands
+/// applied before stay applied and the remaining ones are dropped.
+///
+/// @code {.cpp}
+/// ecs::command_buffer commands;
+/// registry.par_each(pool, ecs::parallel_safe([&commands](const ecs::entity& ent, const health& h) {
+///     if (h.value <= 0) {
+///         commands.destroy(ent);
+///     }
+/// }));
+/// commands.flush(registry);
+/// @endcode
+class command_buffer {
+public:
+    /// @brief Construct a new command buffer
+    command_buffer() : _id(next_id()) {
+    }
+
+    /// @brief Deleted copy constructor
+    ///
+    /// @param rhs Another command buffer
+    command_buffer(const command_buffer& rhs) = delete;
+
+    /// @brief Deleted copy assignment operator
+    ///
+    /// @param rhs Another command buffer
+    auto operator=(const command_buffer& rhs) -> command_buffer& = delete;
+
+    /// @brief Destroy the command buffer, commands that were not flushed are dropped
+    ~command_buffer() {
+        clear();
+    }
+
+    /// @brief Record creation of a new entity with components Args... attached
+    ///
+    /// @tparam Args Component types
+    /// @param args Components
+    template<component... Args>
+    void create(Args&&... args) {
+        // compile-time check to make sure all component types in parameter pack are unique
+        [[maybe_unused]] detail::unique_types<Args...> uniqueness_check;
+
+        using payload_type = std::tuple<std::decay_t<Args>...>;
+        auto& list = local();
+        auto* payload = std::construct_at(
+            static_cast<payload_type*>(list.arena.allocate(sizeof(payload_type), alignof(payload_type))),
+            std::forward<Args>(args)...);
+        list.commands.push_back(command{
+            command_kind::create,
+            entity::invalid,
+            detail::create_signature_id::value<detail::create_signature<std::decay_t<Args>...>>,
+            payload,
+            &apply_create<std::decay_t<Args>...>,
+            &destroy_payload<payload_type>,
+        });
+    }
+
+    /// @brief Record destruction of an entity
+    ///
+    /// @param ent Entity to destroy
+    void destroy(entity ent) {
+        local().commands.push_back(command{
+            command_kind::destroy,
+            ent,
+            invalid_component_id,
+            nullptr,
+            &apply_destroy,
+            nullptr,
+        });
+    }
+
+    /// @brief Record setting component C constructed from args on an entity
+    ///
+    /// @tparam C Component type
+    /// @tparam Args Parameter pack, argument types to construct C from
+    /// @param ent Entity to assign component to
+    /// @param args Arguments to construct C from
+    template<component C, typename... Args>
+    void set(entity ent, Args&&... args) {
+        auto& list = local();
+        auto* payload = std::construct_at(static_cast<C*>(list.arena.allocate(sizeof(C), alignof(C))),
+            std::forward<Args>(args)...);
+        list.commands.push_back(command{
+            command_kind::change,
+            ent,
+            component_id::value<C>,
+            payload,
+            &apply_set<C>,
+            &destroy_payload<C>,
+        });
+    }
+
+    /// @brief Record removal of component C from an entity
+    ///
+    /// @tparam C Component type
+    /// @param ent Entity to remove component from
+    template<component C>
+    void remove(entity ent) {
+        local().commands.push_back(command{
+            command_kind::change,
+            ent,
+            component_id::value<C>,
+            nullptr,
+            &apply_remove<C>,
+            nullptr,
+        });
+    }
+
+    /// @brief Return the number of recorded commands. Like flush(), it must not be called while threads are recording
+    ///
+    /// @return std::size_t Number of commands
+    [[nodiscard]] auto size() const -> std::size_t {
+        std::size_t size = 0;
+        for (const auto& [thread, list] : _lists) {
+            size += list->commands.size();
+        }
+        return size;
+    }
+
+    /// @brief Check whether no commands were recorded, must not be called while threads are recording
+    ///
+    /// @return true If there are no commands
+    /// @return false Otherwise
+    [[nodiscard]] auto empty() const -> bool {
+        return size() == 0;
+    }
+
+    /// @brief Apply all recorded commands to the registry and clear the buffer
+    ///
+    /// @param registry Registry to apply commands to
+    void flush(registry& registry) {
+        // applied commands have released their payloads, when a batch throws the rest are destroyed unapplied
+        struct clear_on_exit {
+            command_buffer& buffer;
+            ~clear_on_exit() {
+                buffer.clear();
+            }
+        } guard{ *this };
+
+        _creates.clear();
+        _changes.clear();
+        _destroys.clear();
+
+        for (auto& [thread, list] : _lists) {
+            for (auto& cmd : list->commands) {
+                switch (cmd.kind) {
+                case command_kind::create:
+                    _creates.push_back(&cmd);
+                    break;
+                case command_kind::change:
+                    _changes.push_back(&cmd);
+                    break;
+                case command_kind::destroy:
+                    _destroys.push_back(&cmd);
+                    break;
+                }
+            }
+        }
+
+        // Creates grouped by component set, stable sort keeps recording order inside a group
+        std::ranges::stable_sort(_creates, {}, [](const command* cmd) { return cmd->component; });
+        apply_batches(registry, _creates, [](const command* lhs, const command* rhs) {
+            return lhs->component == rhs->component;
+        });
+
+        // Changes grouped by component and the archetype the entity is in before the flush. All commands of an entity on
+        // the same component end up next to each other in recording order, so their result does not change, while
+        // every group moves entities along the same archetype edge
+        _change_keys.clear();
+        for (auto* cmd : _changes) {
+            const archetype* source = nullptr;
+            if (registry.alive(cmd->ent)) {
+                source = registry.get_location(cmd->ent.id()).archetype;
+            }
+            _change_keys.push_back(change_key{ cmd->component, source, cmd->ent.id(), cmd });
+        }
+        std::ranges::stable_sort(_change_keys, [](const change_key& lhs, const change_key& rhs) {
+            return std::tie(lhs.component, lhs.source, lhs.entity_id)
+                   < std::tie(rhs.component, rhs.source, rhs.entity_id);
+        });
+        _changes.clear();
+        for (const auto& key : _change_keys) {
+            _changes.push_back(key.cmd);
+        }
+        apply_batches(registry, _changes, [](const command* lhs, const command* rhs) {
+            return lhs->apply == rhs->apply;
+        });
+
+        apply_batches(registry, _destroys, [](const command*, const command*) { return true; });
+    }
+
+    /// @brief Drop all recorded commands without applying them
+    void clear() noexcept {
+        for (auto& [thread, list] : _lists) {
+            for (auto& cmd : list->commands) {
+                if (cmd.payload != nullptr && cmd.destroy != nullptr) {
+                    cmd.destroy(cmd.payload);
+                }
+            }
+            list->commands.clear();
+            list->arena.reset();
+        }
+    }
+
+private:
+    enum class command_kind : std::uint8_t {
+        create,
+        change,
+        destroy,
+    };
+
+    struct command {
+        command_kind kind;
+        entity ent;
+        // Component ID for set/remove, component set signature ID for create
+        component_id_t component;
+        void* payload;
+        void (*apply)(registry&, std::span<command* const>);
+        void (*destroy)(void*);
+    };
+
+    struct command_list {
+        std::vector<command> commands;
+        detail::command_arena arena;
+    };
+
+    struct change_key {
+        component_id_t component;
+        const archetype* source;
+        entity_id_t entity_id;
+        command* cmd;
+    };
+
+    // Split commands into runs of equal commands and apply every run as a batch
+    static void apply_batches(registry& registry, std::span<command* const> commands, auto&& same_batch) {
+        std::size_t first = 0;
+        while (first < commands.size()) {
+            auto last = first + 1;
+            while (last < commands.size() && same_batch(commands[first], commands[last])) {
+                last++;
+            }
+            commands[first]->apply(registry, commands.subspan(first, last - first));
+            first = last;
+        }
+    }
+
+    template<component... Args>
+    static void apply_create(registry& registry, std::span<command* const> commands) {
+        using payload_type = std::tuple<Args...>;
+        registry.create_n<Args...>(commands.size(), [commands](std::size_t i) -> payload_type {
+            return std::move(*static_cast<payload_type*>(commands[i]->payload));
+        });
+        for (auto* cmd : commands) {
+            destroy_payload<payload_type>(cmd->payload);
+            cmd->payload = nullptr;
+        }
+    }
+
+    template<component C>
+    static void apply_set(registry& registry, std::span<command* const> commands) {
+        for (auto* cmd : commands) {
+            auto* value = static_cast<C*>(cmd->payload);
+            if (registry.alive(cmd->ent)) {
+                registry.set<C>(cmd->ent, std::move(*value));
+            }
+            std::destroy_at(value);
+            cmd->payload = nullptr;
+        }
+    }
+
+    template<component C>
+    static void apply_remove(registry& registry, std::span<command* const> commands) {
+        for (auto* cmd : commands) {
+            if (registry.alive(cmd->ent)) {
+                registry.remove<C>(cmd->ent);
+            }
+        }
+    }
+
+    static void apply_destroy(registry& registry, std::span<command* const> commands) {
+        for (auto* cmd : commands) {
+            if (registry.alive(cmd->ent)) {
+                registry.destroy(cmd->ent);
+            }
+        }
+    }
+
+    template<typename T>
+    static void destroy_payload(void* payload) {
+        std::destroy_at(static_cast<T*>(payload));
+    }
+
+    // Return the command list of the calling thread. The last used list is cached per thread, so only the first
+    // command a thread records into this buffer takes the lock
+    auto local() -> command_list& {
+        thread_local struct {
+            std::uint64_t buffer_id{};
+            command_list* list{};
+        } cache;
+
+        if (cache.buffer_id == _id) {
+            return *cache.list;
+        }
+
+        const std::scoped_lock lock(_mutex);
+        const auto thread = std::this_thread::get_id();
+        auto iter = std::ranges::find_if(_lists, [thread](const auto& entry) { return entry.first == thread; });
+        if (iter == _lists.end()) {
+            _lists.emplace_back(thread, std::make_unique<command_list>());
+            iter = std::prev(_lists.end());
+        }
+        cache.buffer_id = _id;
+        cache.list = iter->second.get();
+        return *cache.list;
+    }
+
+    static auto next_id() noexcept -> std::uint64_t {
+        static std::atomic<std::uint64_t> id{ 1 };
+        return id++;
+    }
+
+    std::uint64_t _id;
+    std::mutex _mutex{};
+    std::vector<std::pair<std::thread::id, std::unique_ptr<command_list>>> _lists{};
+
+    // Scratch storage reused between flushes
+    std::vector<command*> _creates{};
+    std::vector<command*> _changes{};
+    std::vector<command*> _destroys{};
+    std::vector<change_key> _change_keys{};
+};
+
+} // namespace ecs
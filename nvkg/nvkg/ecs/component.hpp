@@ -6,6 +6,7 @@
 #include <functional>
 #include <numeric>
 #include <stdexcept>
+#include <string>
 
 #include <nvkg/ecs/detail/dynamic_bitset.hpp>
 #include <nvkg/ecs/detail/hash_map.hpp>
@@ -16,34 +17,70 @@ namespace ecs {
 
 namespace detail {
 
-/// @brief Type registry is a container holding a mapping between type to its assigned ID.
+/// @brief Type registry is a container holding a mapping between type to its assigned ID. Types are keyed by the
+/// compile time hash of their name, registering a different name with the same hash is detected and reported.
 ///
 /// @tparam Type it is parametrized over
 /// @tparam _id_type Type used for IDs
-template<typename = void, typename _id_type = std::uint64_t>
+/// @tparam first_id First ID handed out, IDs below it are reserved for fixed IDs
+template<typename = void, typename _id_type = std::uint64_t, _id_type first_id = 0>
 class type_registry {
 public:
     using id_type = _id_type;
 
+    /// @brief Registered type entry
+    struct entry {
+        std::string_view name;
+        id_type id;
+    };
+
 #ifndef CO_ECS_CLIENT
     /// @brief Get ID of for a type
     ///
     /// @param type_string Name of the type
     /// @return id_type ID assigned to a type
     CO_ECS_EXPORT static auto id(std::string_view type_string) -> id_type {
-        auto [iter, inserted] = get_id_map().emplace(type_string, get_next_id());
+        return id(fnv1a(type_string), type_string);
+    }
+
+    /// @brief Get ID for a type, assigning the next free ID on first registration
+    ///
+    /// @param type_hash Hash of the type name
+    /// @param type_string Name of the type
+    /// @return id_type ID assigned to a type
+    CO_ECS_EXPORT static auto id(std::uint64_t type_hash, std::string_view type_string) -> id_type {
+        auto [iter, inserted] = get_id_map().emplace(type_hash, entry{ type_string, get_next_id() });
         if (inserted) {
             get_next_id()++;
         }
-        auto type_id = iter->second;
-        return type_id;
+        check_collision(iter->second, type_string);
+        return iter->second.id;
+    }
+
+    /// @brief Register a type with a fixed ID, checks that neither its hash nor its ID is taken by another type
+    ///
+    /// @param type_hash Hash of the type name
+    /// @param type_string Name of the type
+    /// @param fixed_id ID to assign
+    /// @return id_type ID assigned to a type
+    CO_ECS_EXPORT static auto claim(std::uint64_t type_hash, std::string_view type_string, id_type fixed_id)
+        -> id_type {
+        for (const auto& [hash, registered] : get_id_map()) {
+            if (registered.id == fixed_id && registered.name != type_string) [[unlikely]] {
+                throw std::logic_error("Types " + std::string(registered.name) + " and " + std::string(type_string)
+                                       + " claim the same ID " + std::to_string(fixed_id));
+            }
+        }
+        auto [iter, inserted] = get_id_map().emplace(type_hash, entry{ type_string, fixed_id });
+        check_collision(iter->second, type_string);
+        return iter->second.id;
     }
 
     /// @brief Get ID mapping
     ///
-    /// @return hash_map<std::string_view, id_type>& Reference to a hash map: name -> ID
-    CO_ECS_EXPORT static auto get_id_map() -> hash_map<std::string_view, id_type>& {
-        static hash_map<std::string_view, id_type> id_map{};
+    /// @return hash_map<std::uint64_t, entry>& Reference to a hash map: name hash -> name and ID
+    CO_ECS_EXPORT static auto get_id_map() -> hash_map<std::uint64_t, entry>& {
+        static hash_map<std::uint64_t, entry> id_map{};
         return id_map;
     }
 
@@ -51,14 +88,24 @@ public:
     ///
     /// @return id_type& Next ID value
     CO_ECS_EXPORT static auto get_next_id() -> id_type& {
-        static id_type next_id{};
+        static id_type next_id{ first_id };
         return next_id;
     }
 #else
-    CO_ECS_IMPORT static hash_map<std::string_view, id_type>& get_id_map();
+    CO_ECS_IMPORT static hash_map<std::uint64_t, entry>& get_id_map();
     CO_ECS_IMPORT static id_type& get_next_id();
     CO_ECS_IMPORT static id_type id(std::string_view type_string);
+    CO_ECS_IMPORT static id_type id(std::uint64_t type_hash, std::string_view type_string);
+    CO_ECS_IMPORT static id_type claim(std::uint64_t type_hash, std::string_view type_string, id_type fixed_id);
 #endif
+
+private:
+    static void check_collision(const entry& registered, std::string_view type_string) {
+        if (registered.name != type_string) [[unlikely]] {
+            throw std::logic_error(
+                "Type name hash collision between " + std::string(registered.name) + " and " + std::string(type_string));
+        }
+    }
 };
 
 /// @brief Generate unique sequential IDs for types
@@ -70,7 +117,7 @@ struct type_id {
     using id_type = _id_type;
 
     template<typename T>
-    inline static const id_type value = type_registry<Base, id_type>::id(type_name<T>());
+    inline static const id_type value = type_registry<Base, id_type>::id(type_hash<T>(), type_name<T>());
 };
 
 } // namespace detail
@@ -81,8 +128,65 @@ using component_id_t = std::uint32_t;
 /// @brief Invalid component ID
 constexpr auto invalid_component_id = std::numeric_limits<component_id_t>::max();
 
+#ifndef CO_ECS_STATIC_COMPONENT_ID_COUNT
+#define CO_ECS_STATIC_COMPONENT_ID_COUNT 16
+#endif
+
+/// @brief Number of component IDs reserved for components with a compile time ID, IDs assigned at runtime start after
+constexpr component_id_t static_component_id_count = CO_ECS_STATIC_COMPONENT_ID_COUNT;
+
+/// @brief Specialize to give a component a compile time ID below static_component_id_count. Lookups of such IDs fold
+/// to constants, e.g. for components used in hot loops. IDs claimed twice are reported when the component is first
+/// used in an archetype
+///
+/// @code {.cpp}
+/// template<>
+/// struct ecs::static_component_id<position> : std::integral_constant<ecs::component_id_t, 1> {};
+/// @endcode
+///
+/// @tparam T Component type
+template<typename T>
+struct static_component_id {};
+
+/// @brief Check whether component type has a compile time ID
+///
+/// @tparam T Component type
+template<typename T>
+concept has_static_component_id = requires { static_component_id<T>::value; };
+
+namespace detail {
+
 /// @brief Type for family used to generated component IDs.
-using component_id = detail::type_id<struct _component_family_t, component_id_t>;
+using component_registry = type_registry<struct _component_family_t, component_id_t, static_component_id_count>;
+
+/// @brief Component ID assigned at runtime on first use
+///
+/// @tparam T Component type
+template<typename T>
+inline const component_id_t component_id_value = component_registry::id(type_hash<T>(), type_name<T>());
+
+/// @brief Component ID known at compile time
+///
+/// @tparam T Component type
+template<has_static_component_id T>
+inline constexpr component_id_t component_id_value<T> = static_component_id<T>::value;
+
+} // namespace detail
+
+/// @brief Component IDs are small sequential numbers used to index component tables directly
+struct component_id {
+    /// @brief ID of component T, a constant expression for components with a compile time ID
+    ///
+    /// @tparam T Component type
+    template<typename T>
+    static constexpr const component_id_t& value = detail::component_id_value<T>;
+
+    /// @brief Compile time hash of the component type name
+    ///
+    /// @tparam T Component type
+    template<typename T>
+    static constexpr std::uint64_t hash = type_hash<T>();
+};
 
 /// @brief Component concept. The component must be a struct/class that can be move constructed and move
 /// assignable
@@ -92,6 +196,33 @@ template<typename T>
 concept component =
     std::is_class_v<T> && std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>;
 
+/// @brief Component storage policy
+enum class storage_policy : std::uint8_t {
+    // Stored in archetype chunks together with the other components of the entity, the default
+    archetype,
+
+    // Stored in a per component sparse set, adding or removing it does not move the entity between archetypes
+    sparse,
+};
+
+/// @brief Specialize to change the storage policy of a component. Sparse storage suits tag-like components that are
+/// added and removed often, e.g. selection, visibility or dirty flags, while archetype storage is faster to iterate
+///
+/// @code {.cpp}
+/// template<>
+/// struct ecs::component_storage<selected> : std::integral_constant<ecs::storage_policy, ecs::storage_policy::sparse> {};
+/// @endcode
+///
+/// @tparam T Component type
+template<typename T>
+struct component_storage : std::integral_constant<storage_policy, storage_policy::archetype> {};
+
+/// @brief Component stored in a sparse set
+///
+/// @tparam T Component type
+template<typename T>
+concept sparse_component = component<T> && component_storage<T>::value == storage_policy::sparse;
+
 /// @brief Component reference concept. It should be a reference or const reference to C, where C satisfies component
 /// concept
 ///
@@ -155,7 +286,15 @@ public:
     /// @tparam T Component type
     /// @return component_meta Component metadata
     template<component T>
-    static auto of() noexcept -> component_meta {
+    static auto of() -> component_meta {
+        if constexpr (has_static_component_id<T>) {
+            static_assert(static_component_id<T>::value < static_component_id_count,
+                "Compile time component ID exceeds the reserved range, raise CO_ECS_STATIC_COMPONENT_ID_COUNT");
+
+            // detect two components claiming the same ID once per component type
+            [[maybe_unused]] static const auto claimed = detail::component_registry::claim(
+                component_id::hash<T>, type_name<T>(), component_id::value<T>);
+        }
         return component_meta{
             component_id::value<T>,
             type_meta::of<T>(),
@@ -252,6 +391,24 @@ public:
         _bitset.clear();
     }
 
+    /// @brief Check if every component of this set is present in rhs
+    ///
+    /// @param rhs Right hand side
+    /// @return true If this set is a subset of rhs
+    /// @return false Otherwise
+    [[nodiscard]] auto is_subset_of(const component_set& rhs) const noexcept -> bool {
+        return _bitset.is_subset_of(rhs._bitset);
+    }
+
+    /// @brief Check if this set and rhs have a component in common
+    ///
+    /// @param rhs Right hand side
+    /// @return true If at least one component is present in both sets
+    /// @return false Otherwise
+    [[nodiscard]] auto intersects(const component_set& rhs) const noexcept -> bool {
+        return _bitset.intersects(rhs._bitset);
+    }
+
     /// @brief Equality operator
     ///
     /// @param rhs Right hand side
@@ -273,7 +430,7 @@ public:
     ///
     /// @param set Component set
     /// @return std::size_t Hash value
-    auto operator()(const component_set& set) const -> std::size_t {
+    auto operator()(const component_set& set) const noexcept -> std::size_t {
         return std::hash<typename component_set::storage_type>()(set._bitset);
     }
 };
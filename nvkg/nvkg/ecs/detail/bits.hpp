@@ -11,4 +11,13 @@ constexpr auto mod_2n(auto value, auto divisor) noexcept -> decltype(auto) {
     return value & (divisor - 1U);
 }
 
+/// @brief Round value up to the next multiple of alignment=2^n
+///
+/// @param value Value
+/// @param alignment Power of 2 alignment
+/// @return decltype(auto) Result
+constexpr auto align_up(auto value, auto alignment) noexcept -> decltype(auto) {
+    return (value + alignment - 1U) & ~(alignment - 1U);
+}
+
 } // namespace ecs::detail
\ No newline at end of file
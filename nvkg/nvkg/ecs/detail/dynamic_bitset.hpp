@@ -3,30 +3,71 @@
 #include <nvkg/ecs/detail/bits.hpp>
 
 #include <algorithm>
+#include <array>
 #include <climits>
+#include <concepts>
 #include <cstdint>
 #include <ranges>
 #include <vector>
 
 namespace ecs::detail {
 
-/// @brief Dynamically growing bitset
+/// @brief Multiply two 64-bit values and fold the 128-bit product into 64 bits
 ///
-/// TODO: Small size optimization
+/// @param lhs Left hand side
+/// @param rhs Right hand side
+/// @return std::uint64_t Folded product
+constexpr auto mix_mul(std::uint64_t lhs, std::uint64_t rhs) noexcept -> std::uint64_t {
+#if defined(__SIZEOF_INT128__)
+    const auto product = static_cast<unsigned __int128>(lhs) * rhs;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64U);
+#else
+    const std::uint64_t lhs_lo = lhs & 0xffffffffU;
+    const std::uint64_t lhs_hi = lhs >> 32U;
+    const std::uint64_t rhs_lo = rhs & 0xffffffffU;
+    const std::uint64_t rhs_hi = rhs >> 32U;
+    const std::uint64_t lo_lo = lhs_lo * rhs_lo;
+    const std::uint64_t hi_lo = lhs_hi * rhs_lo;
+    const std::uint64_t lo_hi = lhs_lo * rhs_hi;
+    const std::uint64_t hi_hi = lhs_hi * rhs_hi;
+    const std::uint64_t cross = (lo_lo >> 32U) + (hi_lo & 0xffffffffU) + lo_hi;
+    const std::uint64_t lo = (cross << 32U) | (lo_lo & 0xffffffffU);
+    const std::uint64_t hi = hi_hi + (hi_lo >> 32U) + (cross >> 32U);
+    return lo ^ hi;
+#endif
+}
+
+/// @brief Dynamically growing bitset. The first inline_bits bits are stored in place, which covers the component sets
+/// of almost every archetype without a heap allocation, only bits past them spill into a vector.
 ///
+/// Inline blocks are always compared and combined as a whole, the loops have a fixed trip count without early exits so
+/// compilers turn equality, subset and hash into a few vector instructions.
+///
+/// @tparam T Block type
 /// @tparam A Allocator type
-template<typename T = std::uint64_t, typename A = std::allocator<T>>
+template<std::unsigned_integral T = std::uint64_t, typename A = std::allocator<T>>
 class dynamic_bitset {
 public:
     using block_type = T;
     using allocator_type = A;
     using storage_type = std::vector<block_type, allocator_type>;
 
+    /// @brief Number of bits in a block
+    static constexpr std::size_t block_bits = sizeof(block_type) * CHAR_BIT;
+
+    /// @brief Number of blocks stored in place
+    static constexpr std::size_t inline_blocks = 256 / block_bits;
+
+    /// @brief Number of bits stored in place
+    static constexpr std::size_t inline_bits = inline_blocks * block_bits;
+
     /// @brief Construct a new dynamic bitset object
     ///
-    /// @param initial_bits Initial size of the bitset
-    explicit dynamic_bitset(std::size_t initial_blocks = 1) {
-        _blocks.resize(initial_blocks);
+    /// @param initial_blocks Number of blocks to reserve space for
+    explicit dynamic_bitset(std::size_t initial_blocks = inline_blocks) {
+        if (initial_blocks > inline_blocks) {
+            _spilled.reserve(initial_blocks - inline_blocks);
+        }
     }
 
     /// @brief Check if bit at given position is set
@@ -36,8 +77,12 @@ public:
     /// @return false If bit is unset
     [[nodiscard]] inline auto test(std::size_t pos) const noexcept -> bool {
         const auto [block_index, bit_pos] = block_and_bit(pos);
-        if (block_index < _blocks.size()) {
-            return _blocks[block_index] & (block_type{ 1 } << bit_pos);
+        if (block_index < inline_blocks) [[likely]] {
+            return _inline[block_index] & (block_type{ 1 } << bit_pos);
+        }
+        const auto spilled_index = block_index - inline_blocks;
+        if (spilled_index < _spilled.size()) {
+            return _spilled[spilled_index] & (block_type{ 1 } << bit_pos);
         }
         return false;
     }
@@ -49,27 +94,105 @@ public:
     /// @return dynamic_bitset&
     inline auto set(std::size_t pos, bool value = true) -> dynamic_bitset& {
         const auto [block_index, bit_pos] = block_and_bit(pos);
-        if (block_index >= _blocks.size()) {
-            _blocks.resize(block_index + 1);
+        if (block_index < inline_blocks) [[likely]] {
+            if (value) {
+                _inline[block_index] |= (block_type{ 1 } << bit_pos);
+            } else {
+                _inline[block_index] &= ~(block_type{ 1 } << bit_pos);
+            }
+            return *this;
         }
+
+        const auto spilled_index = block_index - inline_blocks;
         if (value) {
-            _blocks[block_index] |= (block_type{ 1 } << bit_pos);
-        } else {
-            _blocks[block_index] &= ~(block_type{ 1 } << bit_pos);
+            if (spilled_index >= _spilled.size()) {
+                _spilled.resize(spilled_index + 1);
+            }
+            _spilled[spilled_index] |= (block_type{ 1 } << bit_pos);
+        } else if (spilled_index < _spilled.size()) {
+            _spilled[spilled_index] &= ~(block_type{ 1 } << bit_pos);
 
-            std::size_t i = _blocks.size() - 1;
-            while (!_blocks[i] && i != 0) {
-                i--;
+            // Spilled blocks never end with a zero block, so equal bitsets have equal storage
+            while (!_spilled.empty() && !_spilled.back()) {
+                _spilled.pop_back();
             }
-            _blocks.resize(i + 1);
         }
         return *this;
     }
 
     /// @brief Clear all bits
     inline void clear() noexcept {
-        _blocks.resize(1);
-        _blocks[0] = 0;
+        _inline.fill(0);
+        _spilled.clear();
+    }
+
+    /// @brief Check if no bit is set
+    ///
+    /// @return true If no bit is set
+    /// @return false Otherwise
+    [[nodiscard]] auto none() const noexcept -> bool {
+        block_type any{};
+        for (std::size_t i = 0; i < inline_blocks; i++) {
+            any |= _inline[i];
+        }
+        return !any && _spilled.empty();
+    }
+
+    /// @brief Check if every bit set in this bitset is also set in rhs
+    ///
+    /// @param rhs Right hand side bitset
+    /// @return true If this bitset is a subset of rhs
+    /// @return false Otherwise
+    [[nodiscard]] auto is_subset_of(const dynamic_bitset& rhs) const noexcept -> bool {
+        block_type extra{};
+        for (std::size_t i = 0; i < inline_blocks; i++) {
+            extra |= _inline[i] & ~rhs._inline[i];
+        }
+        if (extra) {
+            return false;
+        }
+        if (_spilled.size() > rhs._spilled.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < _spilled.size(); i++) {
+            extra |= _spilled[i] & ~rhs._spilled[i];
+        }
+        return !extra;
+    }
+
+    /// @brief Check if this bitset and rhs have a bit set in common
+    ///
+    /// @param rhs Right hand side bitset
+    /// @return true If at least one bit is set in both bitsets
+    /// @return false Otherwise
+    [[nodiscard]] auto intersects(const dynamic_bitset& rhs) const noexcept -> bool {
+        block_type common{};
+        for (std::size_t i = 0; i < inline_blocks; i++) {
+            common |= _inline[i] & rhs._inline[i];
+        }
+        const auto spilled = std::min(_spilled.size(), rhs._spilled.size());
+        for (std::size_t i = 0; i < spilled; i++) {
+            common |= _spilled[i] & rhs._spilled[i];
+        }
+        return common;
+    }
+
+    /// @brief Hash the bitset. Every block is mixed with a multiply-fold step, so bits spread over the whole value and
+    /// sets differing in symmetric bit patterns do not collide the way XOR-ing blocks does
+    ///
+    /// @return std::uint64_t Hash value
+    [[nodiscard]] auto hash() const noexcept -> std::uint64_t {
+        constexpr std::uint64_t seed_0 = 0xa0761d6478bd642fULL;
+        constexpr std::uint64_t seed_1 = 0xe7037ed1a0b428dbULL;
+
+        std::uint64_t hash = seed_0 ^ _spilled.size();
+        for (std::size_t i = 0; i < inline_blocks; i++) {
+            hash = mix_mul(hash ^ static_cast<std::uint64_t>(_inline[i]), seed_1 + i);
+        }
+        for (auto block : _spilled) {
+            hash = mix_mul(hash ^ static_cast<std::uint64_t>(block), seed_1);
+        }
+        return mix_mul(hash ^ (hash >> 32U), seed_0);
     }
 
     /// @brief Equality operator
@@ -78,19 +201,22 @@ public:
     /// @return true If bitsets are equal
     /// @return false If bitsets aren't equal
     auto operator==(const dynamic_bitset& rhs) const noexcept -> bool {
-        return std::ranges::equal(_blocks, rhs._blocks);
+        block_type diff{};
+        for (std::size_t i = 0; i < inline_blocks; i++) {
+            diff |= _inline[i] ^ rhs._inline[i];
+        }
+        return !diff && std::ranges::equal(_spilled, rhs._spilled);
     }
 
 private:
-    friend struct std::hash<dynamic_bitset>;
-
     static inline auto block_and_bit(std::size_t pos) -> std::pair<std::size_t, std::size_t> {
-        const auto bit_pos = pos % (sizeof(block_type) * CHAR_BIT);
-        const auto block_index = pos / (sizeof(block_type) * CHAR_BIT);
+        const auto bit_pos = pos % block_bits;
+        const auto block_index = pos / block_bits;
         return std::make_pair(block_index, bit_pos);
     }
 
-    storage_type _blocks;
+    alignas(32) std::array<block_type, inline_blocks> _inline{};
+    storage_type _spilled;
 };
 
 } // namespace ecs::detail
@@ -98,14 +224,10 @@ private:
 namespace std {
 
 /// @brief Hash implementation for dynamic_bitset
-template<typename A>
-struct hash<ecs::detail::dynamic_bitset<A>> {
-    auto operator()(const ecs::detail::dynamic_bitset<A>& bitset) const -> std::size_t {
-        std::size_t hash = 0;
-        for (auto block : bitset._blocks) {
-            hash ^= block;
-        }
-        return hash;
+template<typename T, typename A>
+struct hash<ecs::detail::dynamic_bitset<T, A>> {
+    auto operator()(const ecs::detail::dynamic_bitset<T, A>& bitset) const noexcept -> std::size_t {
+        return static_cast<std::size_t>(bitset.hash());
     }
 };
 
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ecs::detail {
+
+/// @brief Paged table maps dense integer keys to values by direct indexing. Keys are split into a page index and an
+/// index inside the page, pages of PageSize values are allocated the first time a key on them is written and are never
+/// moved afterwards, so references stay valid while the table grows. A lookup loads the page vector data, the page
+/// pointer and then the value, without the bounds check and sparse-to-dense step of a sparse table.
+///
+/// Meant for keys that are already dense indices, e.g. entity IDs, where a sparse table would add an indirection.
+///
+/// @tparam T Value type, default constructed values mark unused slots
+/// @tparam PageSize Number of values in a page, power of two
+template<typename T, std::size_t PageSize = 4096>
+class paged_table {
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    static_assert((PageSize & (PageSize - 1)) == 0, "Page size must be a power of two");
+
+    /// @brief Number of values in a page
+    static constexpr size_type page_size = PageSize;
+
+    /// @brief Return reference to the value at key, the page holding it has to be allocated
+    ///
+    /// @param key Key
+    /// @return T& Value
+    [[nodiscard]] auto operator[](size_type key) noexcept -> T& {
+        assert(contains(key) && "Key is not on an allocated page");
+        return _pages[key / page_size][key % page_size];
+    }
+
+    /// @brief Return const reference to the value at key, the page holding it has to be allocated
+    ///
+    /// @param key Key
+    /// @return const T& Value
+    [[nodiscard]] auto operator[](size_type key) const noexcept -> const T& {
+        assert(contains(key) && "Key is not on an allocated page");
+        return _pages[key / page_size][key % page_size];
+    }
+
+    /// @brief Return reference to the value at key, allocating the page holding it when necessary
+    ///
+    /// @param key Key
+    /// @return T& Value
+    auto ensure(size_type key) -> T& {
+        const auto page = key / page_size;
+        if (page >= _pages.size()) [[unlikely]] {
+            _pages.resize(page + 1);
+        }
+        if (!_pages[page]) [[unlikely]] {
+            _pages[page] = std::make_unique<T[]>(page_size);
+        }
+        return _pages[page][key % page_size];
+    }
+
+    /// @brief Check whether the page holding key is allocated
+    ///
+    /// @param key Key
+    /// @return true If the page is allocated
+    /// @return false Otherwise
+    [[nodiscard]] auto contains(size_type key) const noexcept -> bool {
+        const auto page = key / page_size;
+        return page < _pages.size() && _pages[page];
+    }
+
+    /// @brief Return the number of allocated pages
+    ///
+    /// @return size_type Number of pages
+    [[nodiscard]] auto page_count() const noexcept -> size_type {
+        size_type count = 0;
+        for (const auto& page : _pages) {
+            count += page != nullptr;
+        }
+        return count;
+    }
+
+    /// @brief Release all pages
+    void clear() noexcept {
+        _pages.clear();
+    }
+
+private:
+    std::vector<std::unique_ptr<T[]>> _pages{};
+};
+
+} // namespace ecs::detail
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace ecs::detail {
+
+/// @brief Run func(first, last) over blocks of [0, count) on pool and wait for all of them. grain_size is the maximum
+/// block size: the range is split until no block holds more than grain_size indices, and each block runs as one task.
+/// The pool is either a BS::thread_pool or a work stealing scheduler providing parallel_for(first, last, func, grain)
+/// with the same grain meaning, the latter splits the range itself. The first exception thrown by func is rethrown once
+/// all blocks finished
+///
+/// @param pool Thread pool to run tasks on
+/// @param count Number of indices
+/// @param func Callable invoked with a block of indices
+/// @param grain_size Maximum number of indices in a block, i.e. processed by a single task
+void parallel_for(auto& pool, std::size_t count, auto&& func, std::size_t grain_size) {
+    grain_size = std::max<std::size_t>(grain_size, 1);
+
+    if constexpr (requires { pool.parallel_for(std::size_t{ 0 }, count, func, grain_size); }) {
+        pool.parallel_for(std::size_t{ 0 }, count, func, grain_size);
+    } else {
+        if (count <= grain_size || pool.get_thread_count() <= 1) {
+            func(std::size_t{ 0 }, count);
+            return;
+        }
+
+        // blocks of equal size, none larger than grain_size
+        const std::size_t num_blocks = (count + grain_size - 1) / grain_size;
+        auto blocks = pool.parallelize_loop(std::size_t{ 0 }, count, func, num_blocks);
+        // blocks may reference the caller's stack, all of them have to finish before an exception is rethrown
+        blocks.wait();
+        blocks.get();
+    }
+}
+
+} // namespace ecs::detail
@@ -255,7 +255,7 @@ public:
     ///
     /// @param key Key to look for
     /// @return Reference to element found or inserted
-    constexpr auto operator[](const key_type& key) noexcept -> mapped_type&
+    constexpr auto operator[](const key_type& key) -> mapped_type&
         requires(is_map)
     {
         auto [iter, _] = emplace(key);
@@ -25,6 +25,17 @@ using first_type_t = nth_type_t<0, Args...>;
 template<typename... Args>
 using second_type_t = nth_type_t<1, Args...>;
 
+/// @brief Returns the first value in parameter pack
+///
+/// @tparam T First value type
+/// @tparam Rest Other value types
+/// @param first First value
+/// @return T& Reference to first value
+template<typename T, typename... Rest>
+constexpr auto first_value(T&& first, Rest&&... /*rest*/) noexcept -> T&& {
+    return std::forward<T>(first);
+}
+
 /// @brief Function traits primary template
 ///
 /// @tparam F Function type
@@ -1,4 +1,7 @@
 #pragma once
 
+#include <nvkg/ecs/command_buffer.hpp>
 #include <nvkg/ecs/registry.hpp>
+#include <nvkg/ecs/snapshot.hpp>
+#include <nvkg/ecs/system.hpp>
 #include <nvkg/ecs/view.hpp>
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <numeric>
 #include <vector>
 
+#include <nvkg/ecs/component.hpp>
+
 namespace ecs {
 
 /// @brief Entity ID type, 32 bit value should be sufficient for all use cases
@@ -70,6 +72,13 @@ private:
 
 inline const entity entity::invalid{ entity::invalid_id, entity::invalid_generation };
 
+/// @brief Entity is stored in every archetype, its component ID is fixed so entity block lookups fold to constants
+template<>
+struct static_component_id<entity> : std::integral_constant<component_id_t, 0> {};
+
+
+// forward declaration
+class snapshot;
 
 /// @brief Pool of entities, generates entity ids, recycles ids.
 class entity_pool {
@@ -88,6 +97,23 @@ public:
         return handle;
     };
 
+    /// @brief Create count new handles and append them to out. Recycled IDs are used first, the rest is allocated in
+    /// one go
+    ///
+    /// @param count Number of handles to create
+    /// @param out Vector to append handles to
+    void create_n(std::size_t count, std::vector<entity>& out) {
+        out.reserve(out.size() + count);
+        while (count > 0 && !_free_ids.empty()) {
+            out.push_back(create());
+            count--;
+        }
+        _generations.resize(_generations.size() + count);
+        for (std::size_t i = 0; i < count; i++) {
+            out.emplace_back(_next_id++);
+        }
+    }
+
     /// @brief Check if handle is still alive
     ///
     /// @param handle Handle to check
@@ -111,6 +137,9 @@ public:
     }
 
 private:
+    // Let snapshot save and restore the pool state
+    friend class snapshot;
+
     typename entity::id_t _next_id{};
     std::vector<typename entity::generation_t> _generations;
     std::vector<typename entity::id_t> _free_ids;
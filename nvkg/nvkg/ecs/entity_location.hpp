@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 namespace ecs {
@@ -7,17 +8,22 @@ namespace ecs {
 // forward declaration
 class archetype;
 
-/// @brief Entity location
+/// @brief Entity location, packed into 16 bytes so four locations share a cache line
 class entity_location {
 public:
     // Non-owning pointer to an archetype this entity belongs to
     ecs::archetype* archetype{};
 
     // Chunk index
-    std::size_t chunk_index{};
+    std::uint32_t chunk_index{};
 
     // Entry index in the chunk
-    std::size_t entry_index{};
+    std::uint32_t entry_index{};
 };
 
-} // namespace ecs
\ No newline at end of file
+/// @brief Number of entity locations in a page of the registry location table
+constexpr std::size_t entity_location_page_size = 4096;
+
+static_assert(sizeof(entity_location) <= 16, "Entity location is expected to fit into 16 bytes");
+
+} // namespace ecs
@@ -80,4 +80,50 @@ private:
     std::string _msg;
 };
 
+/// @brief Invalid chunk size error
+class invalid_chunk_size : public std::exception {
+public:
+    /// @brief Construct a new invalid chunk size exception object
+    ///
+    /// @param chunk_size Requested chunk size
+    explicit invalid_chunk_size(std::size_t chunk_size) {
+        std::stringstream ss;
+        ss << "Chunk size of " << chunk_size << " bytes is not a power of two multiple of the page size";
+        _msg = ss.str();
+    }
+
+    /// @brief Message to the client
+    ///
+    /// @return const char*
+    [[nodiscard]] auto what() const noexcept -> const char* override {
+        return _msg.c_str();
+    }
+
+private:
+    std::string _msg;
+};
+
+/// @brief Snapshot error raised when snapshot data cannot be written or read back
+class snapshot_error : public std::exception {
+public:
+    /// @brief Construct a new snapshot error exception object
+    ///
+    /// @param reason What went wrong
+    explicit snapshot_error(const std::string& reason) {
+        std::stringstream ss;
+        ss << "snapshot: " << reason;
+        _msg = ss.str();
+    }
+
+    /// @brief Message to the client
+    ///
+    /// @return const char*
+    [[nodiscard]] auto what() const noexcept -> const char* override {
+        return _msg.c_str();
+    }
+
+private:
+    std::string _msg;
+};
+
 } // namespace ecs
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <nvkg/ecs/archetype.hpp>
+
+#include <vector>
+
+namespace ecs {
+
+/// @brief Archetype query caches the list of archetypes that contain a set of components. The cache is refreshed
+/// incrementally using the archetypes generation, only archetypes created since the last refresh are tested, so the
+/// per-iteration cost depends on the number of matching archetypes instead of all archetypes.
+///
+/// Together with every matching archetype the query stores the block offsets and block indices of the requested
+/// components in the order they were requested, so chunks can be iterated and their change ticks checked without
+/// looking up blocks.
+class archetype_query {
+public:
+    /// @brief Archetype matching the query, block offsets and block indices of requested components in it
+    struct match {
+        ecs::archetype* archetype{};
+        std::vector<std::size_t> offsets{};
+        std::vector<std::size_t> blocks{};
+    };
+
+    /// @brief Construct query for given component types
+    ///
+    /// @tparam Components Component types
+    /// @return archetype_query Query
+    template<component... Components>
+    static auto create() -> archetype_query {
+        archetype_query query;
+        (..., query.require<Components>());
+        return query;
+    }
+
+    /// @brief Return archetypes that contain all required components, refreshing the cache when new archetypes were
+    /// created since the last call
+    ///
+    /// @param archetypes Archetypes container
+    /// @return const std::vector<match>& Matching archetypes
+    auto matching(const archetypes& archetypes) -> const std::vector<match>& {
+        if (_generation != archetypes.generation()) [[unlikely]] {
+            refresh(archetypes);
+        }
+        return _matching;
+    }
+
+    /// @brief Return the archetypes generation this query was last refreshed at
+    ///
+    /// @return std::size_t
+    [[nodiscard]] auto generation() const noexcept -> std::size_t {
+        return _generation;
+    }
+
+private:
+    template<component C>
+    void require() {
+        // sparse components are stored outside of archetypes, views look them up per entity
+        if constexpr (!sparse_component<C>) {
+            _components.push_back(component_id::value<C>);
+
+            // every archetype stores entities, they are not part of the component set
+            if constexpr (!std::is_same_v<C, entity>) {
+                _required.insert<C>();
+            }
+        }
+    }
+
+    void refresh(const archetypes& archetypes) {
+        for (auto* archetype : archetypes.created_since(_generation)) {
+            if (!_required.is_subset_of(archetype->components().ids())) {
+                continue;
+            }
+
+            auto& entry = _matching.emplace_back(archetype);
+            entry.offsets.reserve(_components.size());
+            entry.blocks.reserve(_components.size());
+            for (auto id : _components) {
+                const auto index = archetype->blocks().index_of(id);
+                entry.offsets.push_back(archetype->blocks()[index].offset);
+                entry.blocks.push_back(index);
+            }
+        }
+        _generation = archetypes.generation();
+    }
+
+    std::vector<component_id_t> _components{};
+    component_set _required{};
+    std::vector<match> _matching{};
+    std::size_t _generation{};
+};
+
+namespace detail {
+
+/// @brief Key type used to assign an ID to a query over Components
+///
+/// @tparam Components Component types
+template<component... Components>
+struct query_key {};
+
+/// @brief Type for family used to generate query IDs
+using query_id = type_id<struct _query_family_t, std::uint32_t>;
+
+} // namespace detail
+
+} // namespace ecs
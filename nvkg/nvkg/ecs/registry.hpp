@@ -1,20 +1,112 @@
 #pragma once
 
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <ranges>
+#include <vector>
+
 #include <nvkg/ecs/archetype.hpp>
+#include <nvkg/ecs/detail/paged_table.hpp>
 #include <nvkg/ecs/detail/sparse_map.hpp>
 #include <nvkg/ecs/detail/type_traits.hpp>
 #include <nvkg/ecs/entity.hpp>
 #include <nvkg/ecs/entity_location.hpp>
+#include <nvkg/ecs/query.hpp>
+#include <nvkg/ecs/sparse_storage.hpp>
 #include <nvkg/ecs/view_arguments.hpp>
 
 
 namespace ecs {
 
+/// @brief Result of a registry::compact() call
+struct compact_stats {
+    /// @brief Number of entities moved into other chunks
+    std::size_t moved_entities{};
+
+    /// @brief Number of chunks released to the chunk allocator
+    std::size_t released_chunks{};
+
+    /// @brief Whether the pass went over all archetypes, false when the budget ran out first
+    bool done{};
+};
+
+/// @brief Chunk occupancy of a registry, see registry::fragmentation()
+struct fragmentation_stats {
+    /// @brief Number of archetypes
+    std::size_t archetypes{};
+
+    /// @brief Number of archetypes without entities that still hold a chunk
+    std::size_t empty_archetypes{};
+
+    /// @brief Number of chunks
+    std::size_t chunks{};
+
+    /// @brief Number of chunks that are not full and are not the last chunk of their archetype
+    std::size_t fragmented_chunks{};
+
+    /// @brief Number of entities stored in chunks
+    std::size_t entities{};
+
+    /// @brief Number of entities all chunks can hold
+    std::size_t capacity{};
+
+    /// @brief Return the ratio of used chunk slots
+    ///
+    /// @return double Occupancy in [0, 1], 1 for a registry without chunks
+    [[nodiscard]] auto occupancy() const noexcept -> double {
+        return capacity == 0 ? 1.0 : static_cast<double>(entities) / static_cast<double>(capacity);
+    }
+};
+
 /// @brief Registry is a container for all our entities and components. Components are stored in continuously in memory
 /// allowing for very fast iterations, a so called SoA approach. A set of unique components form an archetype, where
 /// every entity is mapped to an archetype.
+///
+/// Components with the sparse storage policy, see component_storage, are kept in a sparse set per component type
+/// instead and are not part of the archetype.
 class registry {
 public:
+    /// @brief Construct a new registry with default chunk size
+    registry() = default;
+
+    /// @brief Construct a new registry with given chunk size, all archetypes of this registry use chunks of that size.
+    /// Bigger chunks fit more entities of archetypes with large components
+    ///
+    /// @param chunk_bytes Chunk size in bytes, a power of two multiple of the page size, e.g. 16, 32 or 64 KB
+    explicit registry(std::size_t chunk_bytes) : _archetypes(chunk_bytes) {
+    }
+
+    /// @brief Return the size of chunks of this registry in bytes
+    ///
+    /// @return std::size_t Chunk size
+    [[nodiscard]] auto chunk_bytes() const noexcept -> std::size_t {
+        return _archetypes.chunk_bytes();
+    }
+
+    /// @brief Return the current change tick. Chunks stamp their blocks with the current tick whenever components are
+    /// accessed mutably or entities are added, moved or removed, see view::changed_since()
+    ///
+    /// @return change_tick_t Current tick
+    [[nodiscard]] auto tick() const noexcept -> change_tick_t {
+        return _archetypes.tick();
+    }
+
+    /// @brief Advance the current change tick, usually once per frame. Changes made after this call are stamped with
+    /// the new tick
+    ///
+    /// @code {.cpp}
+    /// auto last = registry.tick();
+    /// registry.advance_tick();
+    /// // ... systems mutate components ...
+    /// registry.view<const transform_3d&>().changed_since(last).each_chunk(upload);
+    /// @endcode
+    ///
+    /// @return change_tick_t New tick
+    auto advance_tick() noexcept -> change_tick_t {
+        return _archetypes.advance_tick();
+    }
+
     /// @brief Creates a new entity in the world with components Args... attached and returns an ecs::entity that
     /// user can use to operate on the entity later, example:
     ///
@@ -38,6 +130,8 @@ public:
     auto create(Args&&... args) -> entity {
         // compile-time check to make sure all component types in parameter pack are unique
         [[maybe_unused]] detail::unique_types<Args...> uniqueness_check;
+        static_assert(!(sparse_component<std::decay_t<Args>> || ...),
+            "Sparse components cannot be created with the entity, set() them afterwards");
 
         auto entity = _entity_pool.create();
         auto archetype = _archetypes.ensure_archetype<Args...>();
@@ -46,6 +140,73 @@ public:
         return entity;
     }
 
+    /// @brief Creates count entities with components Args... attached. The archetype is resolved once and chunks are
+    /// filled one after another, generator(index) is called for every entity and has to return std::tuple<Args...>
+    /// used to construct its components. When generator throws no entity is created, example:
+    ///
+    /// @code {.cpp}
+    /// auto entities = registry.create_n<position, velocity>(1000, [](std::size_t i) {
+    ///     return std::make_tuple(position{ int(i), 0 }, velocity{ 1, 1 });
+    /// });
+    /// @endcode
+    ///
+    /// @tparam Args Component types
+    /// @param count Number of entities to create
+    /// @param generator Callable returning components for the entity at index
+    /// @return std::vector<entity> Created entities
+    template<component... Args, typename F>
+    auto create_n(std::size_t count, F&& generator) -> std::vector<entity> {
+        auto construct = [&generator](std::size_t first, std::size_t n, Args*... columns) {
+            std::size_t i = 0;
+            try {
+                for (; i < n; i++) {
+                    std::tuple<Args...> values = generator(first + i);
+                    std::apply([&](auto&&... value) { (..., std::construct_at(columns + i, std::move(value))); }, values);
+                }
+            } catch (...) {
+                (..., std::destroy_n(columns, i));
+                throw;
+            }
+        };
+        return create_n_impl<Args...>(count, construct);
+    }
+
+    /// @brief Creates entities with components Args... attached from ranges of components, one range per component
+    /// type, all of the same size. Components of trivially copyable types given in contiguous ranges are copied into
+    /// chunks with memcpy, example:
+    ///
+    /// @code {.cpp}
+    /// std::vector<position> positions = ...;
+    /// std::vector<velocity> velocities = ...;
+    /// auto entities = registry.create_bulk<position, velocity>(positions, velocities);
+    /// @endcode
+    ///
+    /// @tparam Args Component types
+    /// @tparam Ranges Range types
+    /// @param ranges Ranges of components
+    /// @return std::vector<entity> Created entities
+    template<component... Args, std::ranges::random_access_range... Ranges>
+    auto create_bulk(Ranges&&... ranges) -> std::vector<entity>
+        requires(sizeof...(Args) > 0 && sizeof...(Args) == sizeof...(Ranges))
+    {
+        const auto count = static_cast<std::size_t>(std::ranges::size(detail::first_value(ranges...)));
+        assert(((static_cast<std::size_t>(std::ranges::size(ranges)) == count) && ...)
+               && "All component ranges must be of the same size");
+
+        auto construct = [&ranges...](std::size_t first, std::size_t n, Args*... columns) {
+            // a throwing copy cleans up its own column, the columns copied before are destroyed here
+            std::size_t copied = 0;
+            try {
+                (..., (copy_column(columns, ranges, first, n), copied++));
+            } catch (...) {
+                std::size_t column = 0;
+                (..., (column++ < copied ? std::destroy_n(columns, n) : columns));
+                throw;
+            }
+        };
+        return create_n_impl<Args...>(count, construct);
+    }
+
     /// @brief Destroy an entity
     ///
     /// @param ent Entity to destroy
@@ -57,6 +218,10 @@ public:
         auto moved = location.archetype->swap_erase(location);
         remove_location(ent.id());
 
+        for (auto* storage : _existing_sparse_storages) {
+            storage->erase(ent.id());
+        }
+
         if (moved) {
             set_location(moved->id(), location);
         }
@@ -66,7 +231,7 @@ public:
 
     /// @brief Set component to an entity. It can either override a component value that is already assigned to an
     /// entity or it may construct a new once and assign to it. Note, such operation involves an archetype change
-    /// which is a costly operation.
+    /// which is a costly operation, unless C uses sparse storage.
     ///
     /// @code {.cpp}
     /// struct position {
@@ -94,51 +259,61 @@ public:
     template<component C, typename... Args>
     void set(entity ent, Args&&... args) {
         ensure_alive(ent);
-        auto& location = get_location(ent.id());
-        auto*& archetype = location.archetype;
-
-        if (archetype->contains<C>()) {
-            archetype->template get<C&>(location) = C{ std::forward<Args>(args)... };
+        if constexpr (sparse_component<C>) {
+            ensure_sparse_storage<C>().emplace_or_assign(ent, std::forward<Args>(args)...);
         } else {
-            auto new_archetype = _archetypes.ensure_archetype_added<C>(archetype);
-            auto [new_location, moved] = archetype->move(location, *new_archetype);
+            auto& location = get_location(ent.id());
+            auto*& archetype = location.archetype;
 
-            auto ptr = std::addressof(new_archetype->template get<C&>(new_location));
-            std::construct_at(ptr, std::forward<Args>(args)...);
+            if (archetype->contains<C>()) {
+                archetype->template get<C&>(location) = C{ std::forward<Args>(args)... };
+            } else {
+                auto new_archetype = _archetypes.ensure_archetype_added<C>(archetype);
+                auto [new_location, moved] = archetype->move(location, *new_archetype);
 
-            if (moved) {
-                set_location(moved->id(), location);
-            }
+                auto ptr = std::addressof(new_archetype->template get<C&>(new_location));
+                std::construct_at(ptr, std::forward<Args>(args)...);
 
-            archetype = new_archetype;
-            set_location(ent.id(), new_location);
+                if (moved) {
+                    set_location(moved->id(), location);
+                }
+
+                archetype = new_archetype;
+                set_location(ent.id(), new_location);
+            }
         }
     }
 
     /// @brief Remove component C from an entity. In case entity does not have component attached nothing is done
     /// and this method returns. In case component is removed it requires archetype change which is a costly
-    /// operation.
+    /// operation, unless C uses sparse storage.
     ///
     /// @tparam C Component type
     /// @param ent Entity to remove component from
     template<component C>
     void remove(entity ent) {
         ensure_alive(ent);
-        auto entity_id = ent.id();
-        auto& location = get_location(entity_id);
-        auto*& archetype = location.archetype;
+        if constexpr (sparse_component<C>) {
+            if (auto* storage = find_sparse_storage<C>(*this)) {
+                storage->erase(ent.id());
+            }
+        } else {
+            auto entity_id = ent.id();
+            auto& location = get_location(entity_id);
+            auto*& archetype = location.archetype;
 
-        if (!archetype->contains<C>()) {
-            return;
-        }
-        auto new_archetype = _archetypes.ensure_archetype_removed<C>(archetype);
-        auto [new_location, moved] = archetype->move(location, *new_archetype);
-        if (moved) {
-            set_location(moved->id(), location);
-        }
+            if (!archetype->contains<C>()) {
+                return;
+            }
+            auto new_archetype = _archetypes.ensure_archetype_removed<C>(archetype);
+            auto [new_location, moved] = archetype->move(location, *new_archetype);
+            if (moved) {
+                set_location(moved->id(), location);
+            }
 
-        archetype = new_archetype;
-        set_location(entity_id, new_location);
+            archetype = new_archetype;
+            set_location(entity_id, new_location);
+        }
     }
 
     /// @brief Check if an entity is alive or not
@@ -202,9 +377,13 @@ public:
     template<component C>
     [[nodiscard]] auto has(entity ent) const -> bool {
         ensure_alive(ent);
-        auto entity_id = ent.id();
-        const auto& location = get_location(entity_id);
-        return location.archetype->template contains<C>();
+        if constexpr (sparse_component<C>) {
+            const auto* storage = find_sparse_storage<C>(*this);
+            return storage != nullptr && storage->contains(ent.id());
+        } else {
+            const auto& location = get_location(ent.id());
+            return location.archetype->template contains<C>();
+        }
     }
 
     /// @brief Create a non-const view based on component query in parameter pack
@@ -244,6 +423,83 @@ public:
     void each(F&& func) const
         requires(detail::func_decomposer<F>::is_const);
 
+    /// @brief Run func on every entity that matches the Args requirement, distributing matching chunks across the
+    /// workers of pool. Mutable access requires func to be marked with ecs::parallel_safe()
+    ///
+    /// @code {.cpp}
+    /// registry.par_each(pool, ecs::parallel_safe([](position& p, const velocity& v) {
+    ///     p.x += v.x;
+    ///     p.y += v.y;
+    /// }));
+    /// @endcode
+    ///
+    /// @param pool Thread pool to run tasks on
+    /// @param func A callable to run on entity components
+    /// @param grain_size Maximum number of chunks processed by a single task
+    template<typename F>
+    void par_each(auto& pool, F&& func, std::size_t grain_size = default_grain_size)
+        requires(!detail::func_decomposer<F>::is_const);
+
+    /// @brief Run func on every entity that matches the Args requirement in parallel. Constant version
+    ///
+    /// @param pool Thread pool to run tasks on
+    /// @param func A callable to run on entity components
+    /// @param grain_size Maximum number of chunks processed by a single task
+    template<typename F>
+    void par_each(auto& pool, F&& func, std::size_t grain_size = default_grain_size) const
+        requires(detail::func_decomposer<F>::is_const);
+
+    /// @brief Merge partially filled chunks of every archetype and release chunks that end up empty, including the
+    /// chunk held by archetypes without entities. Entities are moved from the last chunk of an archetype into free
+    /// slots of its first chunks and their locations are patched. The pass is incremental, at most budget entities are
+    /// moved per call and the next call resumes where the previous one stopped, so it can be spread over frames.
+    ///
+    /// Moving entities invalidates component references and chunk iteration, do not call it while iterating or while
+    /// a command buffer is being recorded against this registry. Released chunks go back to the shared chunk allocator,
+    /// call chunk_allocator::trim() to return fully free slabs to the system.
+    ///
+    /// @param budget Maximum number of entities to move
+    /// @return compact_stats Moved entities, released chunks and whether the pass is complete
+    auto compact(std::size_t budget = std::numeric_limits<std::size_t>::max()) -> compact_stats {
+        compact_stats stats{};
+        const auto archetypes = _archetypes.created_since(0);
+        while (_compact_cursor < archetypes.size()) {
+            auto* archetype = archetypes[_compact_cursor];
+            const auto [moved, released] = archetype->compact(budget - stats.moved_entities,
+                [this](entity ent, const entity_location& location) { set_location(ent.id(), location); });
+            stats.moved_entities += moved;
+            stats.released_chunks += released;
+            if (archetype->fragmented()) {
+                return stats;
+            }
+            _compact_cursor++;
+        }
+        _compact_cursor = 0;
+        stats.done = true;
+        return stats;
+    }
+
+    /// @brief Return chunk occupancy statistics, use them to decide whether compact() is worth running
+    ///
+    /// @return fragmentation_stats Statistics
+    [[nodiscard]] auto fragmentation() const noexcept -> fragmentation_stats {
+        fragmentation_stats stats{};
+        for (const auto* archetype : _archetypes.created_since(0)) {
+            const auto& chunks = archetype->chunks();
+            std::size_t entities = 0;
+            for (std::size_t i = 0; i < chunks.size(); i++) {
+                entities += chunks[i].size();
+                stats.fragmented_chunks += (i + 1 < chunks.size() && !chunks[i].full());
+            }
+            stats.archetypes++;
+            stats.empty_archetypes += (entities == 0 && !chunks.empty());
+            stats.chunks += chunks.size();
+            stats.entities += entities;
+            stats.capacity += chunks.size() * archetype->max_size();
+        }
+        return stats;
+    }
+
 private:
     [[nodiscard]] auto get_archetypes() noexcept -> archetypes& {
         return _archetypes;
@@ -257,8 +513,102 @@ private:
     static auto get_impl(auto&& self, entity ent) -> std::tuple<Args...> {
         self.ensure_alive(ent);
         auto& location = self.get_location(ent.id());
-        auto* archetype = location.archetype;
-        return std::tuple<Args...>(std::ref(archetype->template get<Args>(location))...);
+        return std::tuple<Args...>(std::ref(fetch<Args>(self, ent, location))...);
+    }
+
+    // Fetch a component of an entity either from its archetype or from the sparse storage of the component
+    template<component_reference C>
+    static auto fetch(auto&& self, entity ent, const entity_location& location) -> C {
+        using component_type = decay_component_t<C>;
+        if constexpr (sparse_component<component_type>) {
+            auto* storage = find_sparse_storage<component_type>(self);
+            if (storage == nullptr) [[unlikely]] {
+                throw component_not_found{ type_meta::of<component_type>() };
+            }
+            return storage->get(ent.id());
+        } else {
+            return location.archetype->template get<C>(location);
+        }
+    }
+
+    // Return the sparse storage of C or nullptr if no entity had C yet
+    template<sparse_component C>
+    static auto find_sparse_storage(auto&& self) noexcept {
+        using storage_type = std::conditional_t<std::is_const_v<std::remove_reference_t<decltype(self)>>,
+            const sparse_storage<C>,
+            sparse_storage<C>>;
+        const auto id = component_id::value<C>;
+        if (id < self._sparse_storages.size()) {
+            return static_cast<storage_type*>(self._sparse_storages[id].get());
+        }
+        return static_cast<storage_type*>(nullptr);
+    }
+
+    // Return the sparse storage of C, creating it on first use
+    template<sparse_component C>
+    auto ensure_sparse_storage() -> sparse_storage<C>& {
+        const auto id = component_id::value<C>;
+        if (id >= _sparse_storages.size()) {
+            _sparse_storages.resize(id + 1);
+        }
+        auto& storage = _sparse_storages[id];
+        if (!storage) {
+            // reserve first, so a storage is never left out of the list
+            _existing_sparse_storages.reserve(_existing_sparse_storages.size() + 1);
+            storage = std::make_unique<sparse_storage<C>>();
+            _existing_sparse_storages.push_back(storage.get());
+        }
+        return static_cast<sparse_storage<C>&>(*storage);
+    }
+
+    // Queries are cached per component set and shared between all views of the same kind, so temporary views like the
+    // ones created by each() do not need to filter all archetypes again
+    template<component_reference... Args>
+    [[nodiscard]] auto get_query() const -> archetype_query& {
+        auto& query = _queries[detail::query_id::value<detail::query_key<decay_component_t<Args>...>>];
+        if (!query) {
+            query = std::make_unique<archetype_query>(archetype_query::create<decay_component_t<Args>...>());
+        }
+        return *query;
+    }
+
+    template<component... Args>
+    auto create_n_impl(std::size_t count, auto&& construct) -> std::vector<entity> {
+        // compile-time check to make sure all component types in parameter pack are unique
+        [[maybe_unused]] detail::unique_types<Args...> uniqueness_check;
+        static_assert(!(sparse_component<Args> || ...),
+            "Sparse components cannot be created with the entities, set() them afterwards");
+
+        auto archetype = _archetypes.ensure_archetype<Args...>();
+        std::vector<entity> entities;
+        _entity_pool.create_n(count, entities);
+        try {
+            archetype->template emplace_back_n<Args...>(entities,
+                construct,
+                [this](entity ent, const entity_location& location) { set_location(ent.id(), location); });
+        } catch (...) {
+            // the archetype removed the entities emplaced so far, release their locations and IDs as well
+            for (const auto& ent : entities) {
+                if (_entity_locations.contains(ent.id())) {
+                    remove_location(ent.id());
+                }
+                _entity_pool.recycle(ent);
+            }
+            throw;
+        }
+        return entities;
+    }
+
+    template<component T>
+    static void copy_column(T* dst, auto&& range, std::size_t first, std::size_t count) {
+        using range_type = decltype(range);
+        auto src = std::ranges::begin(range) + first;
+        if constexpr (std::ranges::contiguous_range<range_type> && std::is_trivially_copyable_v<T>
+                      && std::is_same_v<std::ranges::range_value_t<range_type>, T>) {
+            std::memcpy(dst, std::to_address(src), count * sizeof(T));
+        } else {
+            std::uninitialized_copy_n(src, count, dst);
+        }
     }
 
     inline void ensure_alive(const entity& ent) const {
@@ -267,29 +617,46 @@ private:
         }
     }
 
-    [[nodiscard]] auto get_location(entity_id_t entity_id) const -> const entity_location& {
-        return _entity_archetype_map.at(entity_id);
+    // Entity IDs are dense indices handed out by the entity pool, so locations are indexed by ID directly. Callers
+    // check the entity is alive first, which guarantees its location was set
+    [[nodiscard]] auto get_location(entity_id_t entity_id) const noexcept -> const entity_location& {
+        return _entity_locations[entity_id];
     }
 
-    [[nodiscard]] auto get_location(entity_id_t id) -> entity_location& {
-        return _entity_archetype_map.at(id);
+    [[nodiscard]] auto get_location(entity_id_t entity_id) noexcept -> entity_location& {
+        return _entity_locations[entity_id];
     }
 
     void set_location(entity_id_t entity_id, const entity_location& location) {
-        _entity_archetype_map[entity_id] = location;
+        _entity_locations.ensure(entity_id) = location;
     }
 
-    void remove_location(entity_id_t entity_id) {
-        _entity_archetype_map.erase(entity_id);
+    void remove_location(entity_id_t entity_id) noexcept {
+        _entity_locations[entity_id] = entity_location{};
     }
 
     entity_pool _entity_pool;
     archetypes _archetypes;
-    detail::sparse_map<entity_id_t, entity_location> _entity_archetype_map;
+    detail::paged_table<entity_location, entity_location_page_size> _entity_locations;
+
+    // Sparse storages indexed by component ID, null for components without sparse storage
+    std::vector<std::unique_ptr<sparse_storage_base>> _sparse_storages;
+    // Non-null entries of _sparse_storages, destroy() visits only these
+    std::vector<sparse_storage_base*> _existing_sparse_storages;
+    mutable detail::sparse_map<std::uint32_t, std::unique_ptr<archetype_query>> _queries;
+
+    // Position of the next archetype to compact in creation order
+    std::size_t _compact_cursor{};
 
     // Let view access registry private members
     template<component_reference... Args>
     friend class view;
+
+    // Let command buffer look up entity locations to batch commands
+    friend class command_buffer;
+
+    // Let snapshot restore archetypes, entities and their locations
+    friend class snapshot;
 };
 
 } // namespace ecs
\ No newline at end of file
@@ -0,0 +1,554 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <nvkg/ecs/detail/hash_map.hpp>
+#include <nvkg/ecs/exceptions.hpp>
+#include <nvkg/ecs/registry.hpp>
+
+namespace ecs {
+
+/// @brief Snapshot writer appends binary data to a byte vector, passed to serialize hooks
+class snapshot_writer {
+public:
+    /// @brief Construct a writer appending to bytes
+    ///
+    /// @param bytes Output bytes
+    explicit snapshot_writer(std::vector<std::byte>& bytes) noexcept : _bytes(&bytes) {
+    }
+
+    /// @brief Write raw memory
+    ///
+    /// @param data Pointer to data
+    /// @param size Size in bytes
+    void write(const void* data, std::size_t size) {
+        const auto* first = static_cast<const std::byte*>(data);
+        _bytes->insert(_bytes->end(), first, first + size);
+    }
+
+    /// @brief Write a trivially copyable value
+    ///
+    /// @tparam T Value type
+    /// @param value Value
+    template<typename T>
+    void write(const T& value)
+        requires std::is_trivially_copyable_v<T>
+    {
+        write(std::addressof(value), sizeof(T));
+    }
+
+    /// @brief Write a string prefixed with its size
+    ///
+    /// @param value String
+    void write_string(std::string_view value) {
+        write(static_cast<std::uint64_t>(value.size()));
+        write(value.data(), value.size());
+    }
+
+private:
+    std::vector<std::byte>* _bytes;
+};
+
+/// @brief Snapshot reader reads binary data back from a byte span, passed to serialize hooks. Reading past the end of
+/// the data throws snapshot_error
+class snapshot_reader {
+public:
+    /// @brief Construct a reader over bytes
+    ///
+    /// @param bytes Input bytes
+    explicit snapshot_reader(std::span<const std::byte> bytes) noexcept : _bytes(bytes) {
+    }
+
+    /// @brief Return the next size bytes and advance past them
+    ///
+    /// @param size Size in bytes
+    /// @return std::span<const std::byte> Bytes
+    auto take(std::size_t size) -> std::span<const std::byte> {
+        if (size > remaining()) [[unlikely]] {
+            throw snapshot_error{ "unexpected end of data" };
+        }
+        auto bytes = _bytes.subspan(_offset, size);
+        _offset += size;
+        return bytes;
+    }
+
+    /// @brief Read raw memory
+    ///
+    /// @param data Pointer to write data to
+    /// @param size Size in bytes
+    void read(void* data, std::size_t size) {
+        if (size > 0) {
+            std::memcpy(data, take(size).data(), size);
+        }
+    }
+
+    /// @brief Read a trivially copyable value
+    ///
+    /// @tparam T Value type
+    /// @return T Value
+    template<typename T>
+    auto read() -> T
+        requires std::is_trivially_copyable_v<T>
+    {
+        std::array<std::byte, sizeof(T)> bytes;
+        read(bytes.data(), bytes.size());
+        return std::bit_cast<T>(bytes);
+    }
+
+    /// @brief Read a string prefixed with its size
+    ///
+    /// @return std::string String
+    auto read_string() -> std::string {
+        const auto size = read<std::uint64_t>();
+        const auto bytes = take(size);
+        return std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    /// @brief Return the number of bytes left
+    ///
+    /// @return std::size_t
+    [[nodiscard]] auto remaining() const noexcept -> std::size_t {
+        return _bytes.size() - _offset;
+    }
+
+private:
+    std::span<const std::byte> _bytes;
+    std::size_t _offset{};
+};
+
+/// @brief Serialize hooks for component type T. Components that are not trivially copyable, or hold pointers and
+/// handles that cannot be stored as raw memory, specialize it, example:
+///
+/// @code {.cpp}
+/// template<>
+/// struct ecs::serializer<name> {
+///     static void save(ecs::snapshot_writer& writer, const name& value) {
+///         writer.write_string(value.value);
+///     }
+///
+///     static auto load(ecs::snapshot_reader& reader) -> name {
+///         return name{ reader.read_string() };
+///     }
+/// };
+/// @endcode
+///
+/// @tparam T Component type
+template<typename T>
+struct serializer;
+
+/// @brief Component with serialize hooks
+///
+/// @tparam T Component type
+template<typename T>
+concept serializable = requires(snapshot_writer& writer, snapshot_reader& reader, const T& value) {
+    serializer<T>::save(writer, value);
+    { serializer<T>::load(reader) } -> std::convertible_to<T>;
+};
+
+/// @brief Snapshot saves a registry into a binary blob and loads it back. Archetypes are written chunk by chunk and
+/// every chunk column by column. Columns of trivially copyable components are stored as raw memory and loaded with a
+/// single copy straight from the input bytes, which can be a memory mapped file, without constructing components one
+/// by one. Other components go through serializer<T> hooks.
+///
+/// Components with sparse storage are written after the archetypes as an entity column and a component column per
+/// sparse storage.
+///
+/// Component IDs are assigned at runtime, so components are identified by their type name hash and every component
+/// that is saved or loaded has to be registered first. A snapshot can only be loaded on a platform with the same
+/// endianness and component layouts, layouts are checked when loading. Truncated or malformed data, e.g. an entity
+/// listed twice, makes loading throw snapshot_error.
+///
+/// @code {.cpp}
+/// ecs::snapshot snapshot;
+/// snapshot.register_components<position, velocity, name>();
+///
+/// std::ofstream out("level.bin", std::ios::binary);
+/// snapshot.save(registry, out);
+///
+/// std::ifstream in("level.bin", std::ios::binary);
+/// ecs::registry loaded = snapshot.load(in);
+/// @endcode
+class snapshot {
+public:
+    /// @brief Snapshot format version, bumped on every format change
+    static constexpr std::uint32_t version = 2;
+
+    /// @brief Construct a new snapshot, entities are always registered
+    snapshot() {
+        register_components<entity>();
+    }
+
+    /// @brief Register components to save and load
+    ///
+    /// @tparam Components Component types
+    /// @return snapshot& This snapshot
+    template<component... Components>
+    auto register_components() -> snapshot& {
+        (..., register_component<Components>());
+        return *this;
+    }
+
+    /// @brief Save registry into bytes
+    ///
+    /// @param registry Registry to save
+    /// @return std::vector<std::byte> Snapshot data
+    [[nodiscard]] auto save(const registry& registry) const -> std::vector<std::byte> {
+        std::vector<std::byte> bytes;
+        snapshot_writer writer(bytes);
+        save(registry, writer);
+        return bytes;
+    }
+
+    /// @brief Save registry into a stream
+    ///
+    /// @param registry Registry to save
+    /// @param stream Output stream
+    void save(const registry& registry, std::ostream& stream) const {
+        const auto bytes = save(registry);
+        stream.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if (!stream) [[unlikely]] {
+            throw snapshot_error{ "failed to write to stream" };
+        }
+    }
+
+    /// @brief Load registry from bytes
+    ///
+    /// @param bytes Snapshot data
+    /// @return registry Loaded registry
+    [[nodiscard]] auto load(std::span<const std::byte> bytes) const -> registry {
+        snapshot_reader reader(bytes);
+        return load(reader);
+    }
+
+    /// @brief Load registry from a stream
+    ///
+    /// @param stream Input stream
+    /// @return registry Loaded registry
+    [[nodiscard]] auto load(std::istream& stream) const -> registry {
+        std::vector<char> bytes{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+        return load(std::as_bytes(std::span(bytes)));
+    }
+
+private:
+    static constexpr std::uint64_t magic = 0x50414e53474b564eULL; // "NVKGSNAP"
+
+    struct entry {
+        component_meta meta;
+        std::uint64_t hash;
+        bool raw;
+        void (*save)(snapshot_writer&, const std::byte*, std::size_t);
+        void (*load)(snapshot_reader&, std::byte*, std::size_t);
+        void (*save_sparse)(snapshot_writer&, const sparse_storage_base&);
+        void (*load_sparse)(snapshot_reader&, registry&);
+    };
+
+    template<component T>
+    void register_component() {
+        static_assert(std::is_trivially_copyable_v<T> || serializable<T>,
+            "Component is not trivially copyable, specialize ecs::serializer for it");
+
+        const auto meta = component_meta::of<T>();
+        _entries[component_id::hash<T>] = entry{
+            meta,
+            component_id::hash<T>,
+            !serializable<T>,
+            &save_column<T>,
+            &load_column<T>,
+            sparse_component<T> ? &save_sparse<T> : nullptr,
+            sparse_component<T> ? &load_sparse<T> : nullptr,
+        };
+        _hashes[meta.id] = component_id::hash<T>;
+    }
+
+    template<component T>
+    static void save_column(snapshot_writer& writer, const std::byte* first, std::size_t count) {
+        const auto* values = reinterpret_cast<const T*>(first);
+        if constexpr (serializable<T>) {
+            for (std::size_t i = 0; i < count; i++) {
+                serializer<T>::save(writer, values[i]);
+            }
+        } else {
+            writer.write(values, count * sizeof(T));
+        }
+    }
+
+    template<component T>
+    static void load_column(snapshot_reader& reader, std::byte* first, std::size_t count) {
+        auto* values = reinterpret_cast<T*>(first);
+        if constexpr (serializable<T>) {
+            std::size_t i = 0;
+            try {
+                for (; i < count; i++) {
+                    std::construct_at(values + i, serializer<T>::load(reader));
+                }
+            } catch (...) {
+                std::destroy_n(values, i);
+                throw;
+            }
+        } else {
+            reader.read(values, count * sizeof(T));
+        }
+    }
+
+    template<component T>
+    static void save_sparse(snapshot_writer& writer, const sparse_storage_base& base) {
+        if constexpr (sparse_component<T>) {
+            const auto& storage = static_cast<const sparse_storage<T>&>(base);
+            writer.write(static_cast<std::uint64_t>(storage.size()));
+            writer.write(storage.entities().data(), storage.entities().size_bytes());
+            save_column<T>(writer, reinterpret_cast<const std::byte*>(storage.values().data()), storage.size());
+        }
+    }
+
+    template<component T>
+    static void load_sparse(snapshot_reader& reader, registry& registry) {
+        if constexpr (sparse_component<T>) {
+            std::vector<entity> entities;
+            read_vector(reader, entities);
+
+            auto& storage = registry.ensure_sparse_storage<T>();
+            for (const auto ent : entities) {
+                if (!registry.alive(ent)) [[unlikely]] {
+                    throw snapshot_error{ "entity " + std::to_string(ent.id()) + " is not alive" };
+                }
+                if (storage.contains(ent.id())) [[unlikely]] {
+                    throw snapshot_error{ "entity " + std::to_string(ent.id()) + " is listed twice" };
+                }
+                if constexpr (serializable<T>) {
+                    storage.emplace_or_assign(ent, serializer<T>::load(reader));
+                } else {
+                    storage.emplace_or_assign(ent, reader.read<T>());
+                }
+            }
+        }
+    }
+
+    [[nodiscard]] auto find_entry(component_id_t id, const type_meta* type) const -> const entry& {
+        auto iter = _hashes.find(id);
+        if (iter == _hashes.end()) [[unlikely]] {
+            throw snapshot_error{ "component \"" + std::string(type->name) + "\" is not registered" };
+        }
+        return _entries.at(iter->second);
+    }
+
+    template<typename T>
+    static void write_vector(snapshot_writer& writer, const std::vector<T>& values) {
+        writer.write(static_cast<std::uint64_t>(values.size()));
+        writer.write(values.data(), values.size() * sizeof(T));
+    }
+
+    template<typename T>
+    static void read_vector(snapshot_reader& reader, std::vector<T>& values) {
+        const auto size = reader.read<std::uint64_t>();
+        if (size > reader.remaining() / sizeof(T)) [[unlikely]] {
+            throw snapshot_error{ "unexpected end of data" };
+        }
+        values.resize(size);
+        reader.read(values.data(), size * sizeof(T));
+    }
+
+    static auto entity_count(const archetype& archetype) noexcept -> std::size_t {
+        std::size_t count = 0;
+        for (const auto& chunk : archetype.chunks()) {
+            count += chunk.size();
+        }
+        return count;
+    }
+
+    void save(const registry& registry, snapshot_writer& writer) const {
+        const auto& archetypes = registry.get_archetypes();
+
+        writer.write(magic);
+        writer.write(version);
+        writer.write(static_cast<std::uint64_t>(registry.chunk_bytes()));
+
+        writer.write(registry._entity_pool._next_id);
+        write_vector(writer, registry._entity_pool._generations);
+        write_vector(writer, registry._entity_pool._free_ids);
+
+        // Archetypes in creation order, so saving the same registry twice gives the same bytes
+        std::vector<const archetype*> saved;
+        std::vector<const entry*> components;
+        detail::hash_map<component_id_t, std::uint32_t> component_index;
+        auto add_component = [&](component_id_t id, const type_meta* type) {
+            if (!component_index.contains(id)) {
+                component_index[id] = static_cast<std::uint32_t>(components.size());
+                components.push_back(&find_entry(id, type));
+            }
+        };
+        for (const auto* archetype : archetypes.created_since(0)) {
+            if (entity_count(*archetype) == 0) {
+                continue;
+            }
+            saved.push_back(archetype);
+            for (const auto& block : archetype->blocks()) {
+                add_component(block.meta.id, block.meta.type);
+            }
+        }
+
+        std::vector<component_id_t> sparse;
+        for (component_id_t id = 0; id < registry._sparse_storages.size(); id++) {
+            const auto& storage = registry._sparse_storages[id];
+            if (storage && storage->size() > 0) {
+                sparse.push_back(id);
+                add_component(id, storage->type());
+            }
+        }
+
+        writer.write(static_cast<std::uint32_t>(components.size()));
+        for (const auto* component : components) {
+            writer.write(component->hash);
+            writer.write(static_cast<std::uint64_t>(component->meta.type->size));
+            writer.write(static_cast<std::uint64_t>(component->meta.type->align));
+            writer.write(static_cast<std::uint8_t>(component->raw));
+            writer.write_string(component->meta.type->name);
+        }
+
+        writer.write(static_cast<std::uint32_t>(saved.size()));
+        for (const auto* archetype : saved) {
+            // Blocks in chunk order, the entity block first and components in the order of the archetype set, loading
+            // them in this order gives the same chunk layout
+            writer.write(static_cast<std::uint32_t>(archetype->blocks().size()));
+            for (const auto& block : archetype->blocks()) {
+                writer.write(component_index.at(block.meta.id));
+            }
+
+            const auto non_empty = std::ranges::count_if(archetype->chunks(), [](const auto& c) { return !c.empty(); });
+            writer.write(static_cast<std::uint32_t>(non_empty));
+            for (const auto& chunk : archetype->chunks()) {
+                if (chunk.empty()) {
+                    continue;
+                }
+                writer.write(static_cast<std::uint32_t>(chunk.size()));
+                for (std::size_t i = 0; i < archetype->blocks().size(); i++) {
+                    const auto& block = archetype->blocks()[i];
+                    const auto* first = chunk.ptr_at_offset<std::byte>(block.offset, 0);
+                    components[component_index.at(block.meta.id)]->save(writer, first, chunk.size());
+                }
+            }
+        }
+
+        writer.write(static_cast<std::uint32_t>(sparse.size()));
+        for (const auto id : sparse) {
+            const auto index = component_index.at(id);
+            writer.write(index);
+            components[index]->save_sparse(writer, *registry._sparse_storages[id]);
+        }
+    }
+
+    auto load(snapshot_reader& reader) const -> registry {
+        if (reader.read<std::uint64_t>() != magic) [[unlikely]] {
+            throw snapshot_error{ "data is not a registry snapshot" };
+        }
+        if (const auto data_version = reader.read<std::uint32_t>(); data_version != version) [[unlikely]] {
+            throw snapshot_error{ "unsupported version " + std::to_string(data_version) };
+        }
+
+        registry registry(static_cast<std::size_t>(reader.read<std::uint64_t>()));
+
+        auto& pool = registry._entity_pool;
+        pool._next_id = reader.read<entity_id_t>();
+        read_vector(reader, pool._generations);
+        read_vector(reader, pool._free_ids);
+
+        std::vector<const entry*> components(reader.read<std::uint32_t>());
+        for (auto& component : components) {
+            const auto hash = reader.read<std::uint64_t>();
+            const auto size = reader.read<std::uint64_t>();
+            const auto align = reader.read<std::uint64_t>();
+            const auto raw = reader.read<std::uint8_t>() != 0;
+            const auto name = reader.read_string();
+
+            auto iter = _entries.find(hash);
+            if (iter == _entries.end()) [[unlikely]] {
+                throw snapshot_error{ "component \"" + name + "\" is not registered" };
+            }
+            component = &iter->second;
+            if (component->meta.type->size != size || component->meta.type->align != align || component->raw != raw)
+                [[unlikely]] {
+                throw snapshot_error{ "layout of component \"" + name + "\" has changed" };
+            }
+        }
+
+        // every entity has exactly one location, an entity listed twice would leave a stale copy behind
+        std::vector<bool> loaded(pool._generations.size());
+
+        const auto archetype_count = reader.read<std::uint32_t>();
+        for (std::uint32_t a = 0; a < archetype_count; a++) {
+            const auto block_count = reader.read<std::uint32_t>();
+            component_meta_set components_meta;
+            for (std::uint32_t b = 0; b < block_count; b++) {
+                const auto index = reader.read<std::uint32_t>();
+                if (index >= components.size()) [[unlikely]] {
+                    throw snapshot_error{ "component index out of range" };
+                }
+                const auto& meta = components[index]->meta;
+                if ((b == 0) != (meta.id == component_id::value<entity>)) [[unlikely]] {
+                    throw snapshot_error{ "archetype does not start with the entity block" };
+                }
+                if (b != 0) {
+                    components_meta.insert(meta);
+                }
+            }
+
+            auto* archetype = registry._archetypes.ensure_archetype(components_meta);
+            if (archetype->blocks().size() != block_count) [[unlikely]] {
+                throw snapshot_error{ "archetype has duplicate components" };
+            }
+
+            const auto chunk_count = reader.read<std::uint32_t>();
+            for (std::uint32_t c = 0; c < chunk_count; c++) {
+                const auto size = reader.read<std::uint32_t>();
+                if (size == 0 || size > archetype->max_size()) [[unlikely]] {
+                    throw snapshot_error{ "chunk size out of range" };
+                }
+
+                auto location = archetype->emplace_back_blocks(size, [&](const block_metadata& block, std::byte* first) {
+                    find_entry(block.meta.id, block.meta.type).load(reader, first, size);
+                });
+
+                const auto entities = archetype->chunks()[location.chunk_index].entities();
+                for (auto index = location.entry_index; index < entities.size(); index++) {
+                    const auto ent = entities[index];
+                    if (!pool.alive(ent)) [[unlikely]] {
+                        throw snapshot_error{ "entity " + std::to_string(ent.id()) + " is not alive" };
+                    }
+                    if (loaded[ent.id()]) [[unlikely]] {
+                        throw snapshot_error{ "entity " + std::to_string(ent.id()) + " is listed twice" };
+                    }
+                    loaded[ent.id()] = true;
+                    location.entry_index = index;
+                    registry.set_location(ent.id(), location);
+                }
+            }
+        }
+
+        const auto sparse_count = reader.read<std::uint32_t>();
+        for (std::uint32_t s = 0; s < sparse_count; s++) {
+            const auto index = reader.read<std::uint32_t>();
+            if (index >= components.size() || components[index]->load_sparse == nullptr) [[unlikely]] {
+                throw snapshot_error{ "sparse component index out of range" };
+            }
+            components[index]->load_sparse(reader, registry);
+        }
+
+        return registry;
+    }
+
+    detail::hash_map<std::uint64_t, entry> _entries{};
+    detail::hash_map<component_id_t, std::uint64_t> _hashes{};
+};
+
+} // namespace ecs
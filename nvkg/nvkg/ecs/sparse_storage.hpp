@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <nvkg/ecs/detail/paged_table.hpp>
+#include <nvkg/ecs/entity.hpp>
+#include <nvkg/ecs/entity_location.hpp>
+#include <nvkg/ecs/exceptions.hpp>
+
+namespace ecs {
+
+/// @brief Sparse set of entities. Entity IDs index a paged table holding positions in a dense entity array, so
+/// insertion, removal and lookup are O(1) and entities in the set can be iterated packed.
+///
+/// Base of sparse_storage, holds everything that does not depend on the component type so the registry can remove
+/// destroyed entities and views can pick the smallest set without knowing component types.
+class sparse_storage_base {
+public:
+    /// @brief Default constructor
+    sparse_storage_base() = default;
+
+    /// @brief Deleted copy constructor
+    ///
+    /// @param rhs Another storage
+    sparse_storage_base(const sparse_storage_base& rhs) = delete;
+
+    /// @brief Deleted copy assignment operator
+    ///
+    /// @param rhs Another storage
+    auto operator=(const sparse_storage_base& rhs) -> sparse_storage_base& = delete;
+
+    /// @brief Destructor
+    virtual ~sparse_storage_base() = default;
+
+    /// @brief Check if entity ID is in the set
+    ///
+    /// @param entity_id Entity ID
+    /// @return true If entity is in the set
+    /// @return false Otherwise
+    [[nodiscard]] auto contains(entity_id_t entity_id) const noexcept -> bool {
+        return _index.contains(entity_id) && _index[entity_id] != 0;
+    }
+
+    /// @brief Return entities in the set, packed
+    ///
+    /// @return std::span<const entity> Entities
+    [[nodiscard]] auto entities() const noexcept -> std::span<const entity> {
+        return _entities;
+    }
+
+    /// @brief Return the number of entities in the set
+    ///
+    /// @return std::size_t
+    [[nodiscard]] auto size() const noexcept -> std::size_t {
+        return _entities.size();
+    }
+
+    /// @brief Remove entity ID and its component from the set, nothing is done when it is not in the set. Throws only
+    /// when moving the last component into the erased one throws, the set is left unchanged then
+    ///
+    /// @param entity_id Entity ID
+    void erase(entity_id_t entity_id) {
+        erase_component(entity_id);
+    }
+
+    /// @brief Return type metadata of the stored component
+    ///
+    /// @return const type_meta* Type metadata
+    [[nodiscard]] virtual auto type() const noexcept -> const type_meta* = 0;
+
+protected:
+    // Type erased erase(), sparse_storage<T> hides erase() with a version that is noexcept when moving T is
+    virtual void erase_component(entity_id_t entity_id) = 0;
+
+    // Return dense position of entity, it has to be in the set
+    [[nodiscard]] auto position(entity_id_t entity_id) const noexcept -> std::size_t {
+        assert(contains(entity_id) && "Entity is not in the sparse set");
+        return _index[entity_id] - 1;
+    }
+
+    // Append entity and return its dense position, the set is left unchanged when allocating throws
+    auto push(entity ent) -> std::size_t {
+        auto& slot = _index.ensure(ent.id());
+        _entities.push_back(ent);
+        slot = static_cast<std::uint32_t>(_entities.size());
+        return _entities.size() - 1;
+    }
+
+    // Move the last entity into the position of the erased one and return the erased position
+    auto swap_erase(entity_id_t entity_id) noexcept -> std::size_t {
+        const auto pos = position(entity_id);
+        const auto last = _entities.back();
+        _entities[pos] = last;
+        _index[last.id()] = static_cast<std::uint32_t>(pos + 1);
+        _index[entity_id] = 0;
+        _entities.pop_back();
+        return pos;
+    }
+
+private:
+    // Dense position + 1 of every entity ID, 0 for entities that are not in the set
+    detail::paged_table<std::uint32_t, entity_location_page_size> _index{};
+    std::vector<entity> _entities{};
+};
+
+/// @brief Sparse storage keeps components of type T packed in the order of the entities of the set. Adding or removing
+/// a component only touches this storage, entities stay in their archetype chunks.
+///
+/// @tparam T Component type
+template<component T>
+class sparse_storage final : public sparse_storage_base {
+public:
+    /// @brief Construct component from args for entity or assign it when the entity has one already
+    ///
+    /// @tparam Args Parameter pack, argument types to construct T from
+    /// @param ent Entity
+    /// @param args Arguments to construct T from
+    /// @return T& Component
+    template<typename... Args>
+    auto emplace_or_assign(entity ent, Args&&... args) -> T& {
+        if (contains(ent.id())) {
+            auto& value = _values[position(ent.id())];
+            value = T{ std::forward<Args>(args)... };
+            return value;
+        }
+        // entity first, so a throwing constructor leaves the set as it was
+        push(ent);
+        try {
+            return _values.emplace_back(std::forward<Args>(args)...);
+        } catch (...) {
+            swap_erase(ent.id());
+            throw;
+        }
+    }
+
+    /// @brief Get component of entity ID
+    ///
+    /// @param entity_id Entity ID
+    /// @return T& Component
+    [[nodiscard]] auto get(entity_id_t entity_id) -> T& {
+        return get_impl(*this, entity_id);
+    }
+
+    /// @brief Get component of entity ID
+    ///
+    /// @param entity_id Entity ID
+    /// @return const T& Component
+    [[nodiscard]] auto get(entity_id_t entity_id) const -> const T& {
+        return get_impl(*this, entity_id);
+    }
+
+    /// @brief Return components in the order of entities()
+    ///
+    /// @return std::span<T> Components
+    [[nodiscard]] auto values() noexcept -> std::span<T> {
+        return _values;
+    }
+
+    /// @brief Return components in the order of entities()
+    ///
+    /// @return std::span<const T> Components
+    [[nodiscard]] auto values() const noexcept -> std::span<const T> {
+        return _values;
+    }
+
+    /// @brief Remove entity ID and its component from the set, nothing is done when it is not in the set
+    ///
+    /// @param entity_id Entity ID
+    void erase(entity_id_t entity_id) noexcept(std::is_nothrow_move_assignable_v<T>) {
+        if (!contains(entity_id)) {
+            return;
+        }
+        // move the component before touching the entities, so a throwing move leaves the set unchanged
+        const auto pos = position(entity_id);
+        if (pos != _values.size() - 1) {
+            _values[pos] = std::move(_values.back());
+        }
+        swap_erase(entity_id);
+        _values.pop_back();
+    }
+
+    /// @brief Return type metadata of T
+    ///
+    /// @return const type_meta* Type metadata
+    [[nodiscard]] auto type() const noexcept -> const type_meta* override {
+        return type_meta::of<T>();
+    }
+
+private:
+    void erase_component(entity_id_t entity_id) override {
+        erase(entity_id);
+    }
+
+    static auto get_impl(auto&& self, entity_id_t entity_id) -> decltype(auto) {
+        if (!self.contains(entity_id)) [[unlikely]] {
+            throw component_not_found{ type_meta::of<T>() };
+        }
+        return (self._values[self.position(entity_id)]);
+    }
+
+    std::vector<T> _values{};
+};
+
+} // namespace ecs
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nvkg/ecs/detail/parallel.hpp>
+#include <nvkg/ecs/view.hpp>
+
+namespace ecs {
+
+/// @brief System scheduler runs a set of systems over a registry every frame. A system is a callable whose arguments
+/// are component references, the same kind of callable registry::each() accepts, so its const and mutable component
+/// accesses are known from its signature.
+///
+/// Two systems conflict when one of them writes a component the other one reads or writes. Conflicting systems run in
+/// the order they were added, every other pair may run concurrently. The scheduler builds a dependency graph from
+/// conflicts and groups systems into levels, where a system's level is one past the highest level of the systems it
+/// depends on. Systems of the same level never conflict and run in parallel on the thread pool, levels run one after
+/// another.
+///
+/// Systems must not change the registry structure while running, record structural changes into a command_buffer and
+/// flush it after run() instead.
+///
+/// @code {.cpp}
+/// ecs::system_scheduler systems;
+/// systems.add("integrate", [](position& p, const velocity& v) { p.x += v.x; });
+/// systems.add("gravity", [](velocity& v, const mass& m) { v.y -= m.value * g; });
+/// systems.add("count", [&](const health& h) { alive += h.value > 0; });
+/// systems.run(registry, pool);
+/// @endcode
+class system_scheduler {
+public:
+    /// @brief Add a system, systems are ordered by the time they were added
+    ///
+    /// @tparam F System callable type
+    /// @param name Name of the system
+    /// @param func System callable, called for every entity matching its arguments
+    /// @return std::size_t Index of the system
+    template<typename F>
+    auto add(std::string name, F&& func) -> std::size_t {
+        _systems.push_back(std::make_unique<system<std::decay_t<F>>>(std::move(name), std::forward<F>(func)));
+        _dirty = true;
+        return _systems.size() - 1;
+    }
+
+    /// @brief Run all systems once, non-conflicting systems concurrently on pool. Blocks until all systems are done
+    ///
+    /// @param registry Registry to run systems on
+    /// @param pool Thread pool to run systems on
+    void run(registry& registry, auto& pool) {
+        build();
+
+        // Views share cached queries, create and refresh them on this thread so systems only read them. Systems without
+        // matching entities are skipped
+        for (auto& sys : _systems) {
+            sys->prepare(registry);
+        }
+
+        for (const auto& level : _levels) {
+            if (level.size() == 1) {
+                _systems[level.front()]->run(registry);
+                continue;
+            }
+
+            detail::parallel_for(
+                pool,
+                level.size(),
+                [this, &level, &registry](std::size_t first, std::size_t last) {
+                    for (std::size_t i = first; i < last; i++) {
+                        _systems[level[i]]->run(registry);
+                    }
+                },
+                1);
+        }
+    }
+
+    /// @brief Return number of systems
+    ///
+    /// @return std::size_t
+    [[nodiscard]] auto size() const noexcept -> std::size_t {
+        return _systems.size();
+    }
+
+    /// @brief Return name of the system at index
+    ///
+    /// @param index System index
+    /// @return const std::string& Name
+    [[nodiscard]] auto name(std::size_t index) const -> const std::string& {
+        return _systems[index]->name;
+    }
+
+    /// @brief Return indices of the systems the system at index has to run after
+    ///
+    /// @param index System index
+    /// @return const std::vector<std::size_t>& Dependencies
+    [[nodiscard]] auto dependencies(std::size_t index) -> const std::vector<std::size_t>& {
+        build();
+        return _dependencies[index];
+    }
+
+    /// @brief Return system indices grouped by levels, systems within a level run concurrently
+    ///
+    /// @return const std::vector<std::vector<std::size_t>>& Levels
+    [[nodiscard]] auto levels() -> const std::vector<std::vector<std::size_t>>& {
+        build();
+        return _levels;
+    }
+
+private:
+    struct system_base {
+        explicit system_base(std::string name) : name(std::move(name)) {
+        }
+
+        system_base(const system_base&) = delete;
+        auto operator=(const system_base&) -> system_base& = delete;
+        virtual ~system_base() = default;
+
+        virtual void prepare(registry& registry) = 0;
+        virtual void run(registry& registry) = 0;
+
+        std::string name;
+        std::vector<component_id_t> reads{};
+        std::vector<component_id_t> writes{};
+        bool has_work{};
+    };
+
+    template<typename F>
+    struct system : system_base {
+        using view_t = typename detail::func_decomposer<F>::view_t;
+        using view_arguments_t = typename detail::func_decomposer<F>::view_converter_t::view_arguments_t;
+
+        system(std::string name, F func) : system_base(std::move(name)), func(std::move(func)) {
+            view_arguments_t::collect_access(reads, writes);
+            std::ranges::sort(reads);
+            std::ranges::sort(writes);
+        }
+
+        void prepare(registry& registry) override {
+            // refreshes the cached query as well
+            has_work = !view_t{ registry }.empty();
+        }
+
+        void run(registry& registry) override {
+            if (has_work) {
+                view_t{ registry }.each(func);
+            }
+        }
+
+        F func;
+    };
+
+    static auto intersects(const std::vector<component_id_t>& lhs, const std::vector<component_id_t>& rhs) noexcept
+        -> bool {
+        auto lhs_iter = lhs.begin();
+        auto rhs_iter = rhs.begin();
+        while (lhs_iter != lhs.end() && rhs_iter != rhs.end()) {
+            if (*lhs_iter < *rhs_iter) {
+                ++lhs_iter;
+            } else if (*rhs_iter < *lhs_iter) {
+                ++rhs_iter;
+            } else {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static auto conflicts(const system_base& lhs, const system_base& rhs) noexcept -> bool {
+        return intersects(lhs.writes, rhs.writes) || intersects(lhs.writes, rhs.reads)
+               || intersects(lhs.reads, rhs.writes);
+    }
+
+    // Build the dependency graph and levels when systems were added since the last build
+    void build() {
+        if (!_dirty) {
+            return;
+        }
+
+        const auto count = _systems.size();
+        _dependencies.assign(count, {});
+        std::vector<std::size_t> level_of(count, 0);
+        std::size_t level_count = 0;
+
+        for (std::size_t j = 0; j < count; j++) {
+            for (std::size_t i = 0; i < j; i++) {
+                if (conflicts(*_systems[i], *_systems[j])) {
+                    _dependencies[j].push_back(i);
+                    level_of[j] = std::max(level_of[j], level_of[i] + 1);
+                }
+            }
+            level_count = std::max(level_count, level_of[j] + 1);
+        }
+
+        _levels.assign(level_count, {});
+        for (std::size_t i = 0; i < count; i++) {
+            _levels[level_of[i]].push_back(i);
+        }
+        _dirty = false;
+    }
+
+    std::vector<std::unique_ptr<system_base>> _systems{};
+    std::vector<std::vector<std::size_t>> _dependencies{};
+    std::vector<std::vector<std::size_t>> _levels{};
+    bool _dirty{};
+};
+
+} // namespace ecs
@@ -2,11 +2,32 @@
 
 #include <nvkg/ecs/detail/macro.hpp>
 
+#include <cstdint>
 #include <memory>
 #include <string_view>
 
 namespace ecs {
 
+namespace detail {
+
+/// @brief 64 bit FNV-1a hash of a string, usable at compile time
+///
+/// @param value String
+/// @return std::uint64_t Hash value
+constexpr auto fnv1a(std::string_view value) noexcept -> std::uint64_t {
+    constexpr std::uint64_t offset_basis = 14695981039346656037ULL;
+    constexpr std::uint64_t prime = 1099511628211ULL;
+
+    std::uint64_t hash = offset_basis;
+    for (auto c : value) {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= prime;
+    }
+    return hash;
+}
+
+} // namespace detail
+
 /// @brief Utility to get type name at compile type
 ///
 /// @tparam T Type to get name for
@@ -25,6 +46,15 @@ constexpr static auto type_name() noexcept -> std::string_view {
 #endif
 }
 
+/// @brief Hash of the type name, computed at compile time when the compiler provides a pretty function name
+///
+/// @tparam T Type to get hash for
+/// @return std::uint64_t Type name hash
+template<typename T>
+constexpr auto type_hash() noexcept -> std::uint64_t {
+    return detail::fnv1a(type_name<T>());
+}
+
 /// @brief Type meta information
 struct type_meta {
     /// @brief Move constructor callback for type T
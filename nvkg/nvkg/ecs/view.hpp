@@ -1,8 +1,11 @@
 #pragma once
 
+#include <nvkg/ecs/detail/parallel.hpp>
 #include <nvkg/ecs/registry.hpp>
 
+#include <algorithm>
 #include <type_traits>
+#include <vector>
 
 namespace ecs {
 
@@ -23,6 +26,9 @@ inline auto all(Args... args) -> bool {
 ///
 /// A view isn't invalidated when there are changes made to the registry which lets a create one an re-use over time.
 ///
+/// Views over sparse components, see component_storage, iterate the entities of the smallest sparse storage among Args
+/// and look up the rest of the components per entity instead of iterating chunks.
+///
 /// @tparam Args Component references types
 template<component_reference... Args>
 class view {
@@ -30,6 +36,9 @@ public:
     /// @brief Const when all component references are const
     static constexpr bool is_const = view_arguments<Args...>::is_const;
 
+    /// @brief True when any component in Args uses sparse storage
+    static constexpr bool has_sparse = (sparse_component<decay_component_t<Args>> || ...);
+
     /// @brief Iteration value type
     using value_type = std::tuple<Args...>;
 
@@ -39,7 +48,8 @@ public:
     /// @brief Construct a new view object
     ///
     /// @param registry Reference to the registry
-    explicit view(registry_type registry) noexcept : _registry(registry) {
+    explicit view(registry_type registry) :
+        _registry(registry), _query(&registry.template get_query<Args...>()) {
     }
 
     /// @brief Returns an iterator that yields a std::tuple<Args...>
@@ -47,7 +57,11 @@ public:
     /// @return decltype(auto) Iterator
     auto each() -> decltype(auto)
         requires(!is_const) {
-        return chunk_views(_registry.get_archetypes()) | std::views::join; // join all chunks together
+        if constexpr (has_sparse) {
+            return sparse_entries();
+        } else {
+            return chunk_views() | std::views::join; // join all chunks together
+        }
     }
 
     /// @brief Returns an iterator that yields a std::tuple<Args...>
@@ -55,7 +69,11 @@ public:
     /// @return decltype(auto) Iterator
     auto each() const -> decltype(auto)
         requires(is_const) {
-        return chunk_views(_registry.get_archetypes()) | std::views::join; // join all chunks together
+        if constexpr (has_sparse) {
+            return sparse_entries();
+        } else {
+            return chunk_views() | std::views::join; // join all chunks together
+        }
     }
 
     /// @brief Run func on every entity that matches the Args requirement
@@ -63,11 +81,7 @@ public:
     /// @param func A callable to run on entity components
     void each(auto&& func)
         requires(!is_const) {
-        for (auto chunk : chunk_views(_registry.get_archetypes())) {
-            for (auto entry : chunk) {
-                std::apply(func, entry);
-            }
-        }
+        each_impl(func);
     }
 
     /// @brief Run func on every entity that matches the Args requirement. Constant version
@@ -77,13 +91,73 @@ public:
     /// @param func A callable to run on entity components
     void each(auto&& func) const
         requires(is_const) {
-        for (auto chunk : chunk_views(_registry.get_archetypes())) {
-            for (auto entry : chunk) {
-                std::apply(func, entry);
-            }
+        each_impl(func);
+    }
+
+    /// @brief Run func on every chunk that matches the Args requirement. func receives a span over the chunk entities
+    /// followed by one contiguous span per component in Args, e.g. std::span<position> for position& and
+    /// std::span<const velocity> for const velocity&. Unlike each(), this lets the compiler vectorize loops over
+    /// component arrays. Not available for views over sparse components
+    ///
+    /// @code {.cpp}
+    /// registry.view<position&, const velocity&>().each_chunk(
+    ///     [](std::span<const ecs::entity> entities, std::span<position> p, std::span<const velocity> v) {
+    ///         for (std::size_t i = 0; i < entities.size(); i++) {
+    ///             p[i].x += v[i].x;
+    ///         }
+    ///     });
+    /// @endcode
+    ///
+    /// @param func A callable to run on chunk spans
+    void each_chunk(auto&& func)
+        requires(!is_const && !has_sparse) {
+        for (auto chunk : chunk_views()) {
+            std::apply(func, chunk.spans());
         }
     }
 
+    /// @brief Run func on every chunk that matches the Args requirement. Constant version
+    ///
+    /// NOTE: See the note on non-const each_chunk()
+    ///
+    /// @param func A callable to run on chunk spans
+    void each_chunk(auto&& func) const
+        requires(is_const && !has_sparse) {
+        for (auto chunk : chunk_views()) {
+            std::apply(func, chunk.spans());
+        }
+    }
+
+    /// @brief Run func on every entity that matches the Args requirement, distributing matching chunks across the
+    /// workers of a thread pool. Chunks are partitioned into tasks of at most grain_size chunks each, the calling thread
+    /// blocks until all tasks are finished. Since func is called concurrently, mutable iteration requires func to be
+    /// marked with ecs::parallel_safe(). Views over sparse components distribute matching entities instead, grain_size
+    /// then counts entities
+    ///
+    /// @param pool Thread pool to run tasks on
+    /// @param func A callable to run on entity components
+    /// @param grain_size Maximum number of chunks processed by a single task
+    template<typename F>
+    void par_each(auto& pool, F&& func, std::size_t grain_size = default_grain_size)
+        requires(!is_const) {
+        static_assert(is_parallel_safe_v<F>,
+            "Mutable parallel iteration requires func to be marked with ecs::parallel_safe()");
+        par_each_impl(pool, func, grain_size);
+    }
+
+    /// @brief Run func on every entity that matches the Args requirement in parallel. Constant version
+    ///
+    /// NOTE: See the note on non-const par_each()
+    ///
+    /// @param pool Thread pool to run tasks on
+    /// @param func A callable to run on entity components
+    /// @param grain_size Maximum number of chunks processed by a single task
+    template<typename F>
+    void par_each(auto& pool, F&& func, std::size_t grain_size = default_grain_size) const
+        requires(is_const) {
+        par_each_impl(pool, func, grain_size);
+    }
+
     /// @brief Get components for a single entity
     ///
     /// @param ent Entity to query
@@ -102,44 +176,256 @@ public:
         return _registry.template get<Args...>(ent);
     }
 
-    const auto count() const noexcept -> std::size_t {
+    /// @brief Return a copy of this view that only yields chunks where any of the blocks of Args changed after tick,
+    /// chunks that were not touched since then are skipped entirely. Mutable iteration stamps every visited chunk, so
+    /// a filtered mutable view only sees its own changes in the next tick. Sparse components have no change ticks, so
+    /// views over them cannot be filtered
+    ///
+    /// @code {.cpp}
+    /// registry.view<const transform_3d&>().changed_since(last_upload).each_chunk(
+    ///     [](std::span<const ecs::entity> entities, std::span<const transform_3d> transforms) {
+    ///         // re-upload only the transforms of this chunk
+    ///     });
+    /// @endcode
+    ///
+    /// @param tick Tick to compare change ticks against, see registry::tick()
+    /// @return view Filtered view
+    [[nodiscard]] auto changed_since(change_tick_t tick) const -> view
+        requires(!has_sparse)
+    {
+        auto filtered = *this;
+        filtered._since = tick;
+        return filtered;
+    }
+
+    /// @brief Return the number of entities matching the view. Not noexcept, the cached query picks up archetypes
+    /// created since the last use of the view first, which may allocate
+    ///
+    /// @return std::size_t Number of matching entities
+    auto count() const -> std::size_t {
         std::size_t s = 0;
-        for(const auto& c : chunks(_registry.get_archetypes())) {
-            s += c.size();
+        if constexpr (has_sparse) {
+            for (const auto& ent : sparse_candidates(_registry)) {
+                s += matches(_registry, ent);
+            }
+        } else {
+            for(const auto& c : chunks()) {
+                s += c.size();
+            }
         }
         return s;
     }
 
+    /// @brief Check whether no entity matches the view, stops at the first match instead of counting all of them. Like
+    /// count(), it refreshes the cached query first
+    ///
+    /// @return true If no entity matches
+    /// @return false Otherwise
+    [[nodiscard]] auto empty() const -> bool {
+        if constexpr (has_sparse) {
+            return std::ranges::none_of(
+                sparse_candidates(_registry), [this](const entity& ent) { return matches(_registry, ent); });
+        } else {
+            return std::ranges::all_of(chunks(), [](const chunk& c) { return c.empty(); });
+        }
+    }
+
 private:
+    void each_impl(auto& func) const {
+        if constexpr (has_sparse) {
+            for (auto entry : sparse_entries()) {
+                std::apply(func, entry);
+            }
+        } else {
+            for (auto chunk : chunk_views()) {
+                for (auto entry : chunk) {
+                    std::apply(func, entry);
+                }
+            }
+        }
+    }
+
+    void par_each_impl(auto& pool, auto& func, std::size_t grain_size) const {
+        if constexpr (has_sparse) {
+            // components are fetched on the calling thread, fetching mutable chunk components stamps their chunk
+            // and workers must not write the shared change ticks
+            std::vector<value_type> entries;
+            for (const auto& ent : sparse_candidates(_registry)) {
+                if (matches(_registry, ent)) {
+                    entries.push_back(fetch(_registry, ent));
+                }
+            }
+
+            auto run_entries = [&entries, &func](std::size_t first, std::size_t last) {
+                for (std::size_t i = first; i < last; i++) {
+                    std::apply(func, entries[i]);
+                }
+            };
+            detail::parallel_for(pool, entries.size(), run_entries, grain_size);
+        } else {
+            par_each_impl(pool, collect_chunks(), func, grain_size);
+        }
+    }
+
+    /// @brief Return the entities of the smallest sparse storage among Args, every entity matching the view is one of
+    /// them. Empty when any of the sparse storages does not exist yet
+    ///
+    /// @param registry Registry
+    /// @return std::span<const entity> Candidate entities
+    static auto sparse_candidates(registry_type registry) noexcept -> std::span<const entity> {
+        std::span<const entity> candidates;
+        bool found = false;
+        bool missing = false;
+        auto visit = [&]<typename C>() {
+            if constexpr (sparse_component<C>) {
+                const auto* storage = ecs::registry::find_sparse_storage<C>(std::as_const(registry));
+                if (storage == nullptr) {
+                    missing = true;
+                } else if (!found || storage->size() < candidates.size()) {
+                    candidates = storage->entities();
+                    found = true;
+                }
+            }
+        };
+        (..., visit.template operator()<decay_component_t<Args>>());
+        return missing ? std::span<const entity>{} : candidates;
+    }
+
+    /// @brief Check whether an entity has all components of Args
+    ///
+    /// @param registry Registry
+    /// @param ent Entity
+    /// @return true If entity matches the view
+    /// @return false Otherwise
+    static auto matches(registry_type registry, entity ent) noexcept -> bool {
+        const auto& location = registry.get_location(ent.id());
+        auto has = [&]<typename C>() {
+            if constexpr (sparse_component<C>) {
+                return ecs::registry::find_sparse_storage<C>(std::as_const(registry))->contains(ent.id());
+            } else {
+                return location.archetype->template contains<C>();
+            }
+        };
+        return (... && has.template operator()<decay_component_t<Args>>());
+    }
+
+    /// @brief Fetch components of Args for an entity matching the view
+    ///
+    /// @param registry Registry
+    /// @param ent Entity
+    /// @return value_type Components tuple
+    static auto fetch(registry_type registry, entity ent) -> value_type {
+        const auto& location = registry.get_location(ent.id());
+        return value_type(ecs::registry::template fetch<Args>(registry, ent, location)...);
+    }
 
-    /// @brief Return a range of chunk views that match given component set in Args
+    /// @brief Return a range over components of entities in sparse storages matching the view
     ///
-    /// @param archetypes Archetypes
     /// @return decltype(auto)
-    static auto chunk_views(auto&& archetypes) -> decltype(auto) {
-        auto as_typed_chunk = [](auto& chunk) -> decltype(auto) { return chunk_view<Args...>(chunk); };
+    auto sparse_entries() const -> decltype(auto) {
+        auto* registry = &_registry;
+        return sparse_candidates(_registry)
+               | std::views::filter([registry](const entity& ent) { return matches(*registry, ent); })
+               | std::views::transform([registry](const entity& ent) { return fetch(*registry, ent); });
+    }
 
-        return chunks(archetypes) | std::views::transform(as_typed_chunk); // each chunk casted to a typed chunk view range-like type
+    /// @brief Run func over chunk views, splitting them into blocks of at most grain_size chunks that are submitted to the pool
+    ///
+    /// @param pool Thread pool to run tasks on
+    /// @param chunks Chunk views to iterate
+    /// @param func A callable to run on entity components
+    /// @param grain_size Maximum number of chunks processed by a single task
+    static void par_each_impl(auto& pool, const auto& chunks, auto& func, std::size_t grain_size) {
+        const std::size_t count = chunks.size();
+        auto run_chunks = [&chunks, &func](std::size_t first, std::size_t last) {
+            for (std::size_t i = first; i < last; i++) {
+                for (auto entry : chunk_view<Args...>(chunks[i])) {
+                    std::apply(func, entry);
+                }
+            }
+        };
+
+        detail::parallel_for(pool, count, run_chunks, grain_size);
+    }
+
+    /// @brief Collect typed views of all chunks that match given component set in Args
+    ///
+    /// @return std::vector of chunk views
+    auto collect_chunks() const -> decltype(auto) {
+        std::vector<chunk_view<Args...>> result;
+        for (auto c : chunk_views()) {
+            result.push_back(c);
+        }
+        return result;
+    }
+
+    /// @brief Return a range of chunk views that match given component set in Args. Views are created with block
+    /// offsets resolved by the query, so iterating them does not look up any blocks
+    ///
+    /// @return decltype(auto)
+    auto chunk_views() const -> decltype(auto) {
+        auto into_chunk_views = [since = _since](const archetype_query::match& match) -> decltype(auto) {
+            auto as_typed_chunk = [&match](auto& chunk) -> decltype(auto) {
+                mark_changed(chunk, match.blocks.data());
+                return chunk_view<Args...>(chunk, match.offsets.data());
+            };
+            return match.archetype->chunks()                          // every chunk of the archetype
+                   | std::views::filter(changed_since(match, since)) // skipping chunks not changed since the tick
+                   | std::views::transform(as_typed_chunk);
+        };
+
+        return _query->matching(_registry.get_archetypes()) // for each cached archetype matching requested components
+               | std::views::transform(into_chunk_views)    // each chunk casted to a typed chunk view range-like type
+               | std::views::join;                          // join chunk views together
     }
 
     /// @brief Return a range of chunks that match given component set in Args
     ///
-    /// @param archetypes Archetypes
     /// @return decltype(auto)
-    static auto chunks(auto&& archetypes) -> decltype(auto) {
-        auto filter_archetypes = [](auto& archetype) -> bool {
-            return detail::all(archetype->template contains<decay_component_t<Args>>()...);
+    auto chunks() const -> decltype(auto) {
+        auto into_chunks = [since = _since](const archetype_query::match& match) -> decltype(auto) {
+            return match.archetype->chunks() | std::views::filter(changed_since(match, since));
         };
-        auto into_chunks = [](auto& archetype) -> decltype(auto) { return archetype->chunks(); };
 
-        return archetypes                               // for each archetype entry in archetype map
-               | std::views::values                     // for each value, a pointer to archetype
-               | std::views::filter(filter_archetypes)  // filter archetype by requested components
-               | std::views::transform(into_chunks)     // fetch chunks vector
-               | std::views::join;                      // join chunks together
+        return _query->matching(_registry.get_archetypes()) // for each cached archetype matching requested components
+               | std::views::transform(into_chunks)         // fetch chunks vector
+               | std::views::join;                          // join chunks together
+    }
+
+    /// @brief Return a predicate checking whether any block of Args in a chunk of match changed after tick
+    ///
+    /// @param match Archetype match
+    /// @param tick Tick to compare against, 0 accepts every chunk
+    /// @return Predicate
+    static auto changed_since(const archetype_query::match& match, change_tick_t tick) noexcept {
+        return [blocks = match.blocks.data(), tick](const chunk& chunk) {
+            if (tick == 0) {
+                return true;
+            }
+            for (std::size_t i = 0; i < sizeof...(Args); i++) {
+                if (chunk.change_tick(blocks[i]) > tick) {
+                    return true;
+                }
+            }
+            return false;
+        };
+    }
+
+    /// @brief Stamp blocks of mutable component references in Args with the current tick
+    ///
+    /// @param chunk Chunk that is going to be iterated
+    /// @param blocks Block indices in order of Args
+    static void mark_changed(auto& chunk, const std::size_t* blocks) noexcept {
+        if constexpr (!is_const) {
+            [&]<std::size_t... I>(std::index_sequence<I...> /*unused*/) {
+                (..., (mutable_component_reference_v<Args> ? chunk.mark_changed(blocks[I]) : void()));
+            }(std::index_sequence_for<Args...>{});
+        }
     }
 
     registry_type _registry;
+    archetype_query* _query;
+    change_tick_t _since{};
 };
 
 // Implement registry methods after we have view class defined
@@ -172,4 +458,20 @@ void registry::each(F&& func) const
     view_t{ *this }.each(std::forward<F>(func));
 }
 
+template<typename F>
+void registry::par_each(auto& pool, F&& func, std::size_t grain_size)
+    requires(!detail::func_decomposer<F>::is_const)
+{
+    using view_t = typename detail::func_decomposer<F>::view_t;
+    view_t{ *this }.par_each(pool, std::forward<F>(func), grain_size);
+}
+
+template<typename F>
+void registry::par_each(auto& pool, F&& func, std::size_t grain_size) const
+    requires(detail::func_decomposer<F>::is_const)
+{
+    using view_t = typename detail::func_decomposer<F>::view_t;
+    view_t{ *this }.par_each(pool, std::forward<F>(func), grain_size);
+}
+
 } // namespace ecs
\ No newline at end of file
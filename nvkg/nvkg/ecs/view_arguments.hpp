@@ -2,6 +2,8 @@
 
 #include <nvkg/ecs/component.hpp>
 
+#include <vector>
+
 namespace ecs {
 
 // Forward declaration of a view class
@@ -13,8 +15,66 @@ template<component_reference... Args>
 struct view_arguments {
     /// @brief Const when all component references are const
     static constexpr bool is_const = const_component_references_v<Args...>;
+
+    /// @brief Append IDs of components referenced as const to reads and of the mutably referenced ones to writes
+    ///
+    /// @param reads Components read
+    /// @param writes Components written
+    static void collect_access(std::vector<component_id_t>& reads, std::vector<component_id_t>& writes) {
+        (...,
+            (const_component_reference_v<Args> ? reads : writes)
+                .push_back(component_id::value<decay_component_t<Args>>));
+    }
 };
 
+/// @brief Default minimum amount of chunks processed by a single task during parallel iteration
+constexpr std::size_t default_grain_size = 1;
+
+/// @brief Wrapper marking a callable as safe to run concurrently on disjoint chunks. Mutable component access from a
+/// parallel iteration is only allowed through a callable wrapped with ecs::parallel_safe(), the wrapper states that the
+/// callable does not touch any shared state besides the components it receives.
+///
+/// @tparam F Callable type
+template<typename F>
+struct parallel_safe_func : F {
+    using F::operator();
+};
+
+/// @brief Mark callable as safe for parallel iteration with mutable component access
+///
+/// @code {.cpp}
+/// registry.par_each(pool, ecs::parallel_safe([](position& p, const velocity& v) {
+///     p.x += v.x;
+///     p.y += v.y;
+/// }));
+/// @endcode
+///
+/// @tparam F Callable type
+/// @param func Callable
+/// @return parallel_safe_func<F> Wrapped callable
+template<typename F>
+auto parallel_safe(F&& func) -> parallel_safe_func<std::decay_t<F>> {
+    return parallel_safe_func<std::decay_t<F>>{ std::forward<F>(func) };
+}
+
+/// @brief Check whether callable was marked with ecs::parallel_safe()
+///
+/// @tparam F Callable type
+template<typename F>
+struct is_parallel_safe : std::false_type {};
+
+/// @brief Specialization for callables marked with ecs::parallel_safe()
+///
+/// @tparam F Callable type
+template<typename F>
+struct is_parallel_safe<parallel_safe_func<F>> : std::true_type {};
+
+/// @brief Returns true when callable was marked with ecs::parallel_safe()
+///
+/// @tparam F Callable type
+template<typename F>
+constexpr bool is_parallel_safe_v = is_parallel_safe<std::remove_cvref_t<F>>::value;
+
 namespace detail {
 
 // Help to convert std::tuple<Args...> into view<Args...>
@@ -13,15 +13,19 @@
 #include <vector>
 #include <chrono>
 #include <cmath>
+#include <string>
 
 static const constexpr int WIDTH = 1280;
 static const constexpr int HEIGHT = 720;
 
-int main() {
-    logger::debug() << alloc_calls_ << ", " << dealloc_calls_ << ", " << used_memory_;
+int main(int argc, char** argv) {
     nvkg::Window window("NVKG", WIDTH, HEIGHT);
 
-    nvkg::Context context(window);
+    // draws are recorded into secondary command buffers by this many threads, 0 records them on the main thread
+    const uint32_t record_threads = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 4;
+    // exit after this many frames, 0 runs until the window is closed. Used by `make smoke`
+    const uint64_t frame_limit = argc > 2 ? std::stoull(argv[2]) : 0;
+    nvkg::Context context(window, record_threads);
     ecs::registry& registry = context.get_registry();
 
     std::shared_ptr<nvkg::CameraNew> camera = std::make_shared<nvkg::CameraNew>();
@@ -46,6 +50,13 @@ int main() {
 
     nvkg::render_mesh& mem_usage_render_mesh = registry.get<nvkg::render_mesh>(mem_usage);
 
+    auto chunk_usage = registry.create<nvkg::sdf_text_outline, nvkg::render_mesh>(
+        { .55f, false, .75f, {-0.99, -0.91}, {.02f, .04f}, 0.f },
+        { .model_ = nvkg::sdf_text::generate_text("ECS Chunks: 00000 / 00000 KB") }
+    );
+
+    nvkg::render_mesh& chunk_usage_render_mesh = registry.get<nvkg::render_mesh>(chunk_usage);
+
     // Generating models from .obj files
     //nvkg::Model cubeObjModel("assets/models/cube.obj");
 
@@ -60,14 +71,16 @@ int main() {
         .instance_data = { true, sizeof(nvkg::Vertex), sizeof(nvkg::transform_3d) },
     };
 
-    auto instanced_entity = registry.create<nvkg::shared_render_mesh, nvkg::instance_data>({ 
+    // world_bounds lets CPU culling skip the entity as a whole, the renderer keeps it enclosing all instances
+    auto instanced_entity = registry.create<nvkg::shared_render_mesh, nvkg::instance_data, nvkg::world_bounds>({ 
             .model_ = std::make_shared<nvkg::Model>("assets/models/cube.obj"),
             .material_ = nvkg::MaterialManager::create(instanced_config)
-        }, {}
+        }, {}, {}
     );
 
     auto instance_data_generator = []() -> std::vector<nvkg::transform_3d> {
         std::vector<nvkg::transform_3d> instances;
+        instances.reserve(10 * 10 * 10);
         for(int i = -5; i < 5; i++) {
             for(int j = -5; j < 5; j++) {
                 for(int k = -5; k < 5; k++) {
@@ -84,28 +97,43 @@ int main() {
     instance_data.instance_data_ = instance_data_generator();
     instance_data.instance_count_ = instance_data.instance_data_.size();
 
-    instance_data.instance_data_buffer_.init_staging_buffer(sizeof(nvkg::transform_3d) * instance_data.instance_count_);
-    instance_data.instance_data_buffer_.create_buffer(instance_data.instance_data_.data(), sizeof(nvkg::transform_3d) * instance_data.instance_count_);
+    // cull instances on the GPU and draw them indirectly, falls back to CPU culling on unsupported devices
+    context.get_renderer().set_gpu_driven(true);
 
     /////
 
-    logger::debug() << alloc_calls_ << ", " << dealloc_calls_ << ", " << used_memory_;
+    // without NVKG_MEM_PROFILER nothing is tracked and every statistic reads zero
+    if(nvkg::mem_profiler::enabled()) {
+        const auto startup_allocs = nvkg::mem_profiler::totals().total();
+        logger::debug() << "Startup allocations: " << startup_allocs.alloc_calls_ << " allocs, "
+                        << startup_allocs.dealloc_calls_ << " frees, " << startup_allocs.live_bytes() << " bytes live";
+    }
 
     float time_1s = 0.f;
+    uint64_t frames = 0;
 
-    while(!window.window_should_close()) {
+    while(!window.window_should_close() && (frame_limit == 0 || frames < frame_limit)) {
         
         float frameTime = context.get_frame_time();
         time_1s += frameTime;
 
         if(time_1s > 1) {
-            std::stringstream sstm, sstm_m;
+            std::stringstream sstm, sstm_m, sstm_c;
             sstm << "Frame Time: " << floorf(frameTime * 100000000) / 100 << " us";
 
-            sstm_m << "Memory Usage: " << used_memory_ / 1000000 << " MB";
+            if(nvkg::mem_profiler::enabled()) {
+                sstm_m << "Memory Usage: " << nvkg::mem_profiler::totals().total().live_bytes() / 1000000 << " MB";
+            } else {
+                sstm_m << "Memory Usage: n/a";
+            }
+
+            auto chunk_stats = ecs::chunk_allocator::instance(registry.chunk_bytes()).stats();
+            sstm_c << "ECS Chunks: " << chunk_stats.used_bytes / 1024 << " / "
+                   << chunk_stats.reserved_bytes / 1024 << " KB";
 
             nvkg::sdf_text::update_model_mesh(sstm.str(), frame_time_render_mesh.model_);
             nvkg::sdf_text::update_model_mesh(sstm_m.str(), mem_usage_render_mesh.model_);
+            nvkg::sdf_text::update_model_mesh(sstm_c.str(), chunk_usage_render_mesh.model_);
 
             time_1s -= 1;
         }
@@ -113,9 +141,14 @@ int main() {
         window.update();
 
         context.render();
+        frames++;
     }
 
     context.clear_device_queue();
 
+    if(frame_limit > 0) {
+        logger::debug() << "Rendered " << frames << " frames recorded on " << record_threads << " threads";
+    }
+
     return 0;
 }
@@ -0,0 +1,147 @@
+// Checks that create_n() and create_bulk() create entities that are alive and iterable, and that an exception thrown by
+// the generator or by a component copy rolls the whole batch back: no entity, component or ID of the batch survives.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+    constexpr std::size_t existing = 100;
+
+    // Counts live instances, copying one whose value is "boom" throws
+    struct tracked {
+        static inline int live = 0;
+
+        explicit tracked(std::size_t v) : value("tracked value " + std::to_string(v)) {
+            live++;
+        }
+
+        tracked(const tracked& other) : value(other.value) {
+            if (other.value == "boom") {
+                throw std::runtime_error("copy");
+            }
+            live++;
+        }
+
+        tracked(tracked&& other) noexcept : value(std::move(other.value)) {
+            live++;
+        }
+
+        ~tracked() {
+            live--;
+        }
+
+        tracked& operator=(const tracked&) = default;
+        tracked& operator=(tracked&&) noexcept = default;
+
+        std::string value;
+    };
+
+    struct position {
+        std::size_t x;
+    };
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    auto generate(std::size_t i) {
+        return std::make_tuple(position{ i }, tracked(i));
+    }
+
+    void create_n_rolls_back() {
+        ecs::registry registry;
+        registry.create_n<position, tracked>(existing, generate);
+
+        // first entity, one in the first chunk, one at a chunk boundary and the last one
+        for (std::size_t fail : { std::size_t{ 0 }, std::size_t{ 50 }, std::size_t{ 999 }, std::size_t{ 2999 } }) {
+            bool caught = false;
+            try {
+                registry.create_n<position, tracked>(3000, [fail](std::size_t i) {
+                    if (i == fail) {
+                        throw std::runtime_error("generator");
+                    }
+                    return generate(i);
+                });
+            } catch (const std::runtime_error&) {
+                caught = true;
+            }
+            check(caught, "create_n rethrows the exception of the generator");
+            check(registry.view<const position&>().count() == existing, "create_n rollback removes created entities");
+            check(tracked::live == static_cast<int>(existing), "create_n rollback destroys created components");
+        }
+
+        const auto created = registry.create_n<position, tracked>(3000, generate);
+        check(created.size() == 3000, "create_n returns every entity");
+        check(registry.view<const position&>().count() == existing + 3000, "create_n after a rollback");
+        check(created.front().id() < existing + 3000 && created.back().id() < existing + 3000, "rollback recycles IDs");
+
+        bool same = true;
+        for (std::size_t i = 0; i < created.size(); i++) {
+            same = same && registry.alive(created[i]) && registry.get<position>(created[i]).x == i;
+            same = same && registry.get<tracked>(created[i]).value == "tracked value " + std::to_string(i);
+        }
+        check(same, "create_n constructs components from the generator");
+
+        std::size_t alive = 0;
+        registry.each([&](const ecs::entity& ent, const position&) { alive += registry.alive(ent); });
+        check(alive == existing + 3000, "iteration visits created entities only");
+    }
+
+    void create_bulk_rolls_back() {
+        ecs::registry registry;
+        registry.create_n<position, tracked>(existing, generate);
+
+        std::vector<position> positions;
+        std::vector<tracked> values;
+        for (std::size_t i = 0; i < 2000; i++) {
+            positions.push_back({ i });
+            values.emplace_back(i);
+        }
+        values[1500].value = "boom";
+        const auto live = tracked::live;
+
+        bool caught = false;
+        try {
+            registry.create_bulk<position, tracked>(positions, values);
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        check(caught, "create_bulk rethrows the exception of a copy");
+        check(registry.view<const position&>().count() == existing, "create_bulk rollback removes created entities");
+        check(tracked::live == live, "create_bulk rollback destroys copied components");
+
+        values[1500].value = "fine";
+        const auto created = registry.create_bulk<position, tracked>(positions, values);
+        bool same = created.size() == 2000;
+        for (std::size_t i = 0; i < created.size(); i++) {
+            same = same && registry.get<position>(created[i]).x == i
+                   && registry.get<tracked>(created[i]).value == values[i].value;
+        }
+        check(same, "create_bulk copies components from the ranges");
+    }
+
+}
+
+int main() {
+    create_n_rolls_back();
+    create_bulk_rolls_back();
+    check(tracked::live == 0, "registries destroy every component");
+
+    if (failures == 0) {
+        std::printf("bulk_create_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+// Checks change ticks: view::changed_since() yields exactly the chunks where a block of the view was accessed mutably
+// or where entities were added or removed after the given tick, and const access never stamps a chunk.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <span>
+#include <vector>
+
+namespace {
+
+    constexpr std::size_t count = 5000;
+
+    struct position {
+        float x, y, z;
+    };
+
+    struct velocity {
+        float x, y, z;
+    };
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    // Return the first entity of every chunk the view yields
+    template<typename View>
+    auto changed_chunks(const View& view) -> std::vector<ecs::entity> {
+        std::vector<ecs::entity> firsts;
+        view.each_chunk([&](std::span<const ecs::entity> entities, auto&&...) { firsts.push_back(entities.front()); });
+        return firsts;
+    }
+
+    auto contains(const std::vector<ecs::entity>& entities, ecs::entity ent) -> bool {
+        return std::ranges::find(entities, ent) != entities.end();
+    }
+
+    void changed_since() {
+        ecs::registry registry;
+        std::vector<ecs::entity> entities;
+        for (std::size_t i = 0; i < count; i++) {
+            entities.push_back(registry.create<position, velocity>({}, {}));
+        }
+        const ecs::registry& const_registry = registry;
+        const auto positions = const_registry.view<const position&>();
+        const auto velocities = const_registry.view<const velocity&>();
+
+        const auto all = changed_chunks(positions);
+        check(all.size() > 2, "entities span several chunks");
+        const auto first_chunk_size = static_cast<std::size_t>(std::ranges::find(entities, all[1]) - entities.begin());
+        check(changed_chunks(positions.changed_since(0)).size() == all.size(), "tick 0 accepts every chunk");
+
+        auto last = registry.tick();
+        check(registry.advance_tick() == last + 1, "advance_tick returns the new tick");
+        check(changed_chunks(positions.changed_since(last)).empty(), "no chunk changed after advancing");
+
+        // const access does not stamp
+        [[maybe_unused]] const auto& read = const_registry.get<position>(entities[0]);
+        const_registry.each([](const position&, const velocity&) {});
+        check(changed_chunks(positions.changed_since(last)).empty(), "const access does not stamp chunks");
+
+        // mutable get stamps the block of its chunk only
+        registry.get<position>(all[1]).x = 1.0f;
+        auto changed = changed_chunks(positions.changed_since(last));
+        check(changed.size() == 1 && changed.front() == all[1], "mutable get stamps its chunk");
+        check(changed_chunks(velocities.changed_since(last)).empty(), "mutable get stamps its component block only");
+        check(changed_chunks(const_registry.view<const position&, const velocity&>().changed_since(last)).size() == 1,
+            "view over several components yields chunks where any block changed");
+
+        // mutable iteration stamps every visited chunk
+        last = registry.tick();
+        registry.advance_tick();
+        registry.each([](velocity& v) { v.x += 1.0f; });
+        check(changed_chunks(velocities.changed_since(last)).size() == all.size(), "mutable iteration stamps every chunk");
+        check(changed_chunks(positions.changed_since(last)).empty(), "mutable iteration stamps its components only");
+
+        // the filter itself skips unchanged chunks of a mutable view
+        last = registry.tick();
+        registry.advance_tick();
+        registry.get<velocity>(all[0]).x = 2.0f;
+        std::size_t visited = 0;
+        registry.view<velocity&>().changed_since(last).each([&](velocity&) { visited++; });
+        check(visited == first_chunk_size, "filtered mutable view visits changed chunks only");
+        check(changed_chunks(velocities.changed_since(last)).size() == 1, "filtered mutable view stamps only visited chunks");
+
+        // adding and removing entities stamps the chunks they touch
+        last = registry.tick();
+        registry.advance_tick();
+        const auto created = registry.create<position, velocity>({}, {});
+        changed = changed_chunks(positions.changed_since(last));
+        check(changed.size() == 1 && changed.front() == all.back(), "create stamps the last chunk");
+
+        last = registry.tick();
+        registry.advance_tick();
+        registry.destroy(all[0]);
+        changed = changed_chunks(positions.changed_since(last));
+        check(changed.size() == 2 && changed.front() == created, "destroy stamps the chunk of the hole and the last chunk");
+        check(!contains(changed_chunks(positions.changed_since(last)), all[1]), "destroy leaves other chunks alone");
+    }
+
+}
+
+int main() {
+    changed_since();
+
+    if (failures == 0) {
+        std::printf("change_ticks_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+// Checks that command_buffer applies commands recorded from many threads and that a flush which throws destroys the
+// payloads it did not apply and leaves the buffer empty and reusable, by failing every allocation of a flush in turn.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+#include <nvkg/ecs/command_buffer.hpp>
+#include <nvkg/Utils/task_scheduler.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+    struct value {
+        int v;
+    };
+
+    struct tag {};
+
+    // Counts live instances, including payloads waiting in a command buffer
+    struct tracked {
+        static inline int live = 0;
+        int v;
+
+        tracked(int v) : v(v) { live++; }
+        tracked(const tracked& rhs) : v(rhs.v) { live++; }
+        tracked(tracked&& rhs) noexcept : v(rhs.v) { live++; }
+        tracked& operator=(const tracked&) = default;
+        tracked& operator=(tracked&&) noexcept = default;
+        ~tracked() { live--; }
+    };
+
+    // Number of allocations left before operator new throws, negative never throws
+    long allocations_left = -1;
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    void applies_commands_from_many_threads() {
+        constexpr int count = 10000;
+
+        ecs::registry registry;
+        std::vector<ecs::entity> entities;
+        for (int i = 0; i < count; i++) {
+            entities.push_back(registry.create<value>({ i }));
+        }
+
+        nvkg::task_scheduler scheduler(4);
+        ecs::command_buffer commands;
+        scheduler.parallel_for(std::size_t{0}, entities.size(), [&](std::size_t first, std::size_t last) {
+            for (auto i = first; i < last; i++) {
+                switch (i % 4) {
+                case 0: commands.destroy(entities[i]); break;
+                case 1: commands.set<tag>(entities[i]); break;
+                case 2: commands.create<value, tag>({ -1 }, {}); break;
+                default: break;
+                }
+            }
+        }, 64);
+        check(commands.size() == 3 * count / 4, "size counts the commands of every thread");
+
+        commands.flush(registry);
+        check(commands.empty(), "flush empties the buffer");
+        check(registry.view<const value&>().count() == count - count / 4 + count / 4, "destroys and creates are applied");
+        check(registry.view<const value&, const tag&>().count() == count / 2, "sets and creates with tag are applied");
+
+        std::size_t created = 0;
+        registry.each([&](const value& v) { created += v.v == -1; });
+        check(created == count / 4, "created entities carry their components");
+    }
+
+    // Fails the n-th allocation of a flush for every n until the flush gets through
+    void throwing_flush_drops_the_rest() {
+        bool completed = false;
+        for (long fail_at = 0; !completed; fail_at++) {
+            ecs::registry registry;
+            std::vector<ecs::entity> entities;
+            for (int i = 0; i < 100; i++) {
+                entities.push_back(registry.create<value>({ i }));
+            }
+
+            ecs::command_buffer commands;
+            for (int i = 0; i < 100; i++) {
+                commands.set<tracked>(entities[i], i);
+                commands.create<value, tracked>({ i }, tracked{ i });
+                if (i % 10 == 0) {
+                    commands.destroy(entities[i]);
+                }
+            }
+
+            allocations_left = fail_at;
+            try {
+                commands.flush(registry);
+                completed = true;
+            } catch (const std::bad_alloc&) {
+            }
+            allocations_left = -1;
+
+            check(commands.empty(), "flush empties the buffer, also when it throws");
+            check(tracked::live == static_cast<int>(registry.view<const tracked&>().count()),
+                "payloads that were not applied are destroyed");
+            check(registry.view<const value&>().count() >= 100 - 10, "entities are only destroyed by destroy commands");
+
+            commands.set<tracked>(entities[1], -1);
+            commands.flush(registry);
+            check(registry.get<tracked>(entities[1]).v == -1, "the buffer is usable after a throwing flush");
+        }
+        check(tracked::live == 0, "no tracked instances outlive their registries");
+    }
+
+}
+
+void* operator new(std::size_t size) {
+    if (allocations_left == 0) {
+        throw std::bad_alloc();
+    }
+    if (allocations_left > 0) {
+        allocations_left--;
+    }
+    if (auto* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+int main() {
+    applies_commands_from_many_threads();
+    throwing_flush_drops_the_rest();
+
+    if (failures == 0) {
+        std::printf("command_buffer_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
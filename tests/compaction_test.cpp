@@ -0,0 +1,207 @@
+// Checks that registry::compact() merges partially filled chunks and releases chunks of empty archetypes while every
+// surviving entity keeps its components and a valid location, and that a budgeted pass resumes where it stopped.
+//
+// Swap erase keeps chunks dense, partially filled chunks come from block-wise emplacement when loading a snapshot. The
+// test saves a registry and splits its chunk records into records of a little over half a chunk, which don't fit together
+// in one chunk, so loading leaves every chunk partially filled.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace {
+
+    constexpr std::size_t count = 6000;
+
+    // both components have the same size, so their block order in a chunk record does not matter for splitting
+    struct position {
+        float x, y, z;
+    };
+
+    struct velocity {
+        float x, y, z;
+    };
+
+    struct selected {
+        int order;
+    };
+
+    struct tag {
+        int value;
+    };
+
+}
+
+template<>
+struct ecs::component_storage<selected> : std::integral_constant<ecs::storage_policy, ecs::storage_policy::sparse> {};
+
+namespace {
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    template<typename T>
+    void append(std::vector<std::byte>& bytes, const T& value) {
+        const auto raw = std::as_bytes(std::span(&value, 1));
+        bytes.insert(bytes.end(), raw.begin(), raw.end());
+    }
+
+    // Rewrite the chunk records of the only archetype in bytes into records of a little over half a chunk. The records start
+    // with the chunk count followed by the size of the first chunk, right before the handle of the first entity
+    auto split_chunks(const std::vector<std::byte>& bytes, const ecs::registry& registry, std::span<const ecs::entity> entities)
+        -> std::vector<std::byte> {
+        const auto pattern = std::as_bytes(entities.first(2));
+        const auto first = std::search(bytes.begin(), bytes.end(), pattern.begin(), pattern.end());
+        if (first == bytes.end()) {
+            return {};
+        }
+        const auto records = static_cast<std::size_t>(first - bytes.begin()) - 2 * sizeof(std::uint32_t);
+
+        std::vector<std::size_t> sizes;
+        registry.view<const position&>().each_chunk(
+            [&](std::span<const ecs::entity> chunk, std::span<const position>) { sizes.push_back(chunk.size()); });
+        // the first chunk is full
+        const auto split_size = sizes.front() / 2 + 1;
+
+        std::vector<std::byte> split(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(records));
+        // gather the entity block and the two component blocks of all chunks
+        const std::array<std::size_t, 3> elements{ sizeof(ecs::entity), sizeof(position), sizeof(velocity) };
+        std::array<std::vector<std::byte>, 3> columns;
+        auto offset = records + sizeof(std::uint32_t);
+        for (const auto size : sizes) {
+            offset += sizeof(std::uint32_t);
+            for (std::size_t b = 0; b < columns.size(); b++) {
+                const auto* block = bytes.data() + offset;
+                columns[b].insert(columns[b].end(), block, block + size * elements[b]);
+                offset += size * elements[b];
+            }
+        }
+
+        append(split, static_cast<std::uint32_t>((count + split_size - 1) / split_size));
+        for (std::size_t begin = 0; begin < count; begin += split_size) {
+            const auto part = std::min(split_size, count - begin);
+            append(split, static_cast<std::uint32_t>(part));
+            for (std::size_t b = 0; b < columns.size(); b++) {
+                const auto* block = columns[b].data() + begin * elements[b];
+                split.insert(split.end(), block, block + part * elements[b]);
+            }
+        }
+        split.insert(split.end(), bytes.begin() + static_cast<std::ptrdiff_t>(offset), bytes.end());
+        return split;
+    }
+
+    auto intact(const ecs::registry& registry, std::span<const ecs::entity> entities) -> bool {
+        bool same = true;
+        for (std::size_t i = 0; i < entities.size(); i++) {
+            const auto f = static_cast<float>(i);
+            const auto& p = registry.get<position>(entities[i]);
+            const auto& v = registry.get<velocity>(entities[i]);
+            same = same && registry.alive(entities[i]) && p.x == f && p.y == f + 1 && v.z == -f;
+            same = same && registry.has<selected>(entities[i]) == (i % 7 == 0);
+            if (i % 7 == 0) {
+                same = same && registry.get<selected>(entities[i]).order == static_cast<int>(i);
+            }
+        }
+        return same;
+    }
+
+    void compact_fragmented_registry() {
+        ecs::registry source;
+        std::vector<ecs::entity> entities;
+        for (std::size_t i = 0; i < count; i++) {
+            const auto f = static_cast<float>(i);
+            entities.push_back(source.create<position, velocity>({ f, f + 1, f + 2 }, { 0, 0, -f }));
+            if (i % 7 == 0) {
+                source.set<selected>(entities.back(), static_cast<int>(i));
+            }
+        }
+
+        ecs::snapshot snapshot;
+        snapshot.register_components<position, velocity, selected>();
+        const auto bytes = split_chunks(snapshot.save(source), source, entities);
+        std::size_t max_size = 0;
+        source.view<const position&>().each_chunk(
+            [&](std::span<const ecs::entity> chunk, std::span<const position>) { max_size = std::max(max_size, chunk.size()); });
+        check(!bytes.empty(), "chunk records found");
+        if (bytes.empty()) {
+            return;
+        }
+        auto registry = snapshot.load(bytes);
+
+        // an archetype without entities still holds a chunk
+        std::vector<ecs::entity> tagged;
+        for (int i = 0; i < 100; i++) {
+            tagged.push_back(registry.create<tag>({ i }));
+        }
+        for (const auto ent : tagged) {
+            registry.destroy(ent);
+        }
+
+        const auto before = registry.fragmentation();
+        check(before.fragmented_chunks > 0, "split snapshot loads into partially filled chunks");
+        check(before.empty_archetypes == 1, "archetype without entities is reported");
+        check(intact(registry, entities), "entities are intact after loading");
+
+        const auto first = registry.compact(100);
+        check(first.moved_entities == 100, "budgeted pass moves budget entities");
+        check(!first.done, "budgeted pass is not done");
+        check(intact(registry, entities), "entities are intact after a budgeted pass");
+
+        std::size_t passes = 1;
+        auto stats = first;
+        std::size_t released = first.released_chunks;
+        while (!stats.done && passes < 1000) {
+            stats = registry.compact(100);
+            released += stats.released_chunks;
+            passes++;
+        }
+        check(stats.done, "repeated budgeted passes finish");
+        check(intact(registry, entities), "entities are intact after compaction");
+
+        const auto after = registry.fragmentation();
+        check(after.fragmented_chunks == 0, "no fragmented chunks after compaction");
+        check(after.empty_archetypes == 0, "no archetype without entities keeps a chunk");
+        check(after.entities == count, "compaction keeps the entity count");
+        check(before.chunks - after.chunks == released, "released chunks are reported");
+        check(after.chunks == (count + max_size - 1) / max_size, "compacted archetype uses the fewest chunks");
+        check(registry.compact().moved_entities == 0, "compacting a compact registry moves nothing");
+
+        // moved locations have to stay usable for structural changes and iteration
+        for (std::size_t i = 0; i < count; i += 2) {
+            registry.remove<velocity>(entities[i]);
+        }
+        std::size_t visited = 0;
+        bool same = true;
+        registry.each([&](const ecs::entity& ent, const position& p) {
+            visited++;
+            same = same && registry.has<velocity>(ent) == (static_cast<std::size_t>(p.x) % 2 == 1);
+        });
+        check(visited == count && same, "moved entities can change archetype and are iterated once");
+
+        const auto created = registry.create<tag>({ 42 });
+        check(registry.get<tag>(created).value == 42, "archetype without chunks creates a new one");
+    }
+
+}
+
+int main() {
+    compact_fragmented_registry();
+
+    if (failures == 0) {
+        std::printf("compaction_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
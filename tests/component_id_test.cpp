@@ -0,0 +1,144 @@
+// Checks component IDs: compile time IDs are constant expressions, runtime IDs are dense and start after the reserved
+// range, type name hashes are FNV-1a, and two types claiming the same ID or name hash are reported.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    struct position {
+        float x, y, z;
+    };
+
+    struct velocity {
+        float x, y, z;
+    };
+
+    struct health {
+        int value;
+    };
+
+    struct mass {
+        float value;
+    };
+
+    // claims the ID of position
+    struct impostor {
+        int value;
+    };
+
+    struct collision_family;
+
+}
+
+template<>
+struct ecs::static_component_id<position> : std::integral_constant<ecs::component_id_t, 1> {};
+
+template<>
+struct ecs::static_component_id<velocity> : std::integral_constant<ecs::component_id_t, 2> {};
+
+template<>
+struct ecs::static_component_id<impostor> : std::integral_constant<ecs::component_id_t, 1> {};
+
+// compile time IDs fold to constants
+static_assert(ecs::component_id::value<ecs::entity> == 0);
+static_assert(ecs::component_id::value<position> == 1);
+static_assert(ecs::component_id::value<velocity> == 2);
+static_assert(ecs::component_id::hash<position> == ecs::detail::fnv1a(ecs::type_name<position>()));
+
+// reference values of 64 bit FNV-1a
+static_assert(ecs::detail::fnv1a("") == 0xcbf29ce484222325ULL);
+static_assert(ecs::detail::fnv1a("a") == 0xaf63dc4c8601ec8cULL);
+static_assert(ecs::detail::fnv1a("foobar") == 0x85944171f73967e8ULL);
+
+namespace {
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    void runtime_ids() {
+        const std::vector<ecs::component_id_t> ids{ ecs::component_id::value<health>, ecs::component_id::value<mass> };
+        check(std::ranges::all_of(ids, [](auto id) { return id >= ecs::static_component_id_count; }),
+            "runtime IDs start after the reserved range");
+        check(ids[0] != ids[1], "runtime IDs are unique");
+
+        // every ID between the reserved range and the next free one belongs to a registered type
+        std::vector<ecs::component_id_t> registered;
+        for (const auto& [hash, entry] : ecs::detail::component_registry::get_id_map()) {
+            if (entry.id >= ecs::static_component_id_count) {
+                registered.push_back(entry.id);
+            }
+        }
+        std::ranges::sort(registered);
+        bool dense = true;
+        for (std::size_t i = 0; i < registered.size(); i++) {
+            dense = dense && registered[i] == ecs::static_component_id_count + i;
+        }
+        check(dense && ecs::detail::component_registry::get_next_id() == ecs::static_component_id_count + registered.size(),
+            "runtime IDs are dense");
+        check(ecs::component_id::value<health> == ids[0], "runtime ID is stable");
+    }
+
+    void registry_with_static_ids() {
+        ecs::registry registry;
+        const auto ent = registry.create<position, velocity, health>({ 1, 2, 3 }, { 4, 5, 6 }, { 7 });
+        registry.set<mass>(ent, 8.0f);
+        check(registry.get<position>(ent).y == 2 && registry.get<velocity>(ent).z == 6, "static ID components");
+        check(registry.get<health>(ent).value == 7 && registry.get<mass>(ent).value == 8, "runtime ID components");
+        check(registry.view<const position&, const mass&>().count() == 1, "views mix static and runtime IDs");
+        registry.remove<velocity>(ent);
+        check(!registry.has<velocity>(ent) && registry.get<position>(ent).x == 1, "removing a static ID component");
+    }
+
+    // runs after position was used in an archetype, which claimed ID 1 for it
+    void claimed_twice() {
+        ecs::registry registry;
+        bool caught = false;
+        try {
+            registry.create<impostor>({ 1 });
+        } catch (const std::logic_error&) {
+            caught = true;
+        }
+        check(caught, "two types claiming the same ID are reported");
+    }
+
+    void hash_collision() {
+        using registry_type = ecs::detail::type_registry<collision_family, std::uint32_t>;
+        const auto first = registry_type::id(42, "first");
+        check(registry_type::id(42, "first") == first, "registering a type twice gives the same ID");
+        check(registry_type::id(43, "second") == first + 1, "registry hands out sequential IDs");
+
+        bool caught = false;
+        try {
+            registry_type::id(42, "third");
+        } catch (const std::logic_error&) {
+            caught = true;
+        }
+        check(caught, "a different name with the same hash is reported");
+    }
+
+}
+
+int main() {
+    runtime_ids();
+    registry_with_static_ids();
+    claimed_twice();
+    hash_collision();
+
+    if (failures == 0) {
+        std::printf("component_id_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+// Checks component sets and the dynamic bitset behind them: bits past the inline blocks spill and are trimmed again,
+// equal sets compare and hash equal no matter how they were built, subset and intersection tests cover spilled
+// blocks, and the hash tells apart and spreads sets that only differ in symmetric bit patterns.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+    using bitset = ecs::detail::dynamic_bitset<>;
+
+    constexpr std::size_t inline_bits = bitset::inline_bits;
+
+    struct position {
+        float x, y, z;
+    };
+
+    struct velocity {
+        float x, y, z;
+    };
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    auto make(std::initializer_list<std::size_t> bits) -> bitset {
+        bitset set;
+        for (const auto bit : bits) {
+            set.set(bit);
+        }
+        return set;
+    }
+
+    void set_and_spill() {
+        const std::vector<std::size_t> bits{ 0, 63, 64, inline_bits - 1, inline_bits, inline_bits + 100 };
+        bitset set;
+        check(set.none(), "new bitset is empty");
+        for (const auto bit : bits) {
+            set.set(bit);
+        }
+        bool same = true;
+        for (std::size_t bit = 0; bit < inline_bits + 200; bit++) {
+            same = same && set.test(bit) == (std::ranges::find(bits, bit) != bits.end());
+        }
+        check(same, "test() sees inline and spilled bits");
+        check(!set.test(inline_bits * 8), "bits past the storage are unset");
+
+        // setting and clearing a spilled bit leaves no trailing blocks behind
+        auto spilled = make({ 1, 2 });
+        spilled.set(inline_bits * 4);
+        spilled.set(inline_bits * 4, false);
+        check(spilled == make({ 1, 2 }), "clearing a spilled bit trims spilled blocks");
+        check(spilled.hash() == make({ 1, 2 }).hash(), "trimmed bitsets hash equal");
+        check(std::hash<bitset>{}(spilled) == make({ 1, 2 }).hash(), "std::hash forwards to hash()");
+
+        set.clear();
+        check(set.none() && !set.test(inline_bits), "clear() drops inline and spilled bits");
+    }
+
+    void subset_and_intersection() {
+        const auto small = make({ 3, inline_bits + 5 });
+        const auto large = make({ 1, 3, 70, inline_bits + 5, inline_bits + 300 });
+        const auto other = make({ 2, inline_bits + 6 });
+        check(small.is_subset_of(large), "subset with spilled bits");
+        check(!large.is_subset_of(small), "superset is not a subset");
+        check(!make({ inline_bits + 300 }).is_subset_of(small), "longer spilled storage is not a subset");
+        check(bitset{}.is_subset_of(small), "empty set is a subset of everything");
+        check(small.intersects(large) && !small.intersects(other), "intersection with spilled bits");
+        check(make({ inline_bits + 5 }).intersects(large), "intersection in spilled bits only");
+        check(!bitset{}.intersects(large), "empty set intersects nothing");
+    }
+
+    void hash_quality() {
+        // every pair of bits below inline_bits, including pairs XOR folding maps to the same value
+        std::vector<std::uint64_t> hashes;
+        for (std::size_t i = 0; i < inline_bits; i++) {
+            for (std::size_t j = i + 1; j < inline_bits; j++) {
+                hashes.push_back(make({ i, j }).hash());
+            }
+        }
+        check(make({ 0, 65 }).hash() != make({ 1, 64 }).hash(), "symmetric bit patterns hash differently");
+
+        // low bits pick hash table buckets, they have to spread as well
+        constexpr std::size_t buckets = 1024;
+        std::vector<std::size_t> per_bucket(buckets);
+        for (const auto hash : hashes) {
+            per_bucket[hash % buckets]++;
+        }
+        const auto average = hashes.size() / buckets;
+        check(std::ranges::max(per_bucket) < 2 * average, "low hash bits spread over buckets");
+
+        std::ranges::sort(hashes);
+        check(std::ranges::adjacent_find(hashes) == hashes.end(), "pairs of bits hash without collisions");
+    }
+
+    void component_sets() {
+        auto set = ecs::component_set::create<position, velocity>();
+        const auto same = ecs::component_set::create<velocity, position>();
+        check(set == same, "component sets do not depend on insertion order");
+        check(ecs::component_set_hasher{}(set) == ecs::component_set_hasher{}(same), "equal component sets hash equal");
+        check(set.contains<position>() && set.contains<velocity>(), "component set contains its components");
+
+        const auto positions = ecs::component_set::create<position>();
+        check(positions.is_subset_of(set) && !set.is_subset_of(positions), "component set subset");
+        set.erase<velocity>();
+        check(set == positions, "erasing a component");
+        check(ecs::component_set_hasher{}(set) == ecs::component_set_hasher{}(positions), "erased set hashes equal");
+    }
+
+}
+
+int main() {
+    set_and_spill();
+    subset_and_intersection();
+    hash_quality();
+    component_sets();
+
+    if (failures == 0) {
+        std::printf("component_set_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+// Checks entity locations: the paged table allocates pages on first write and keeps references stable while growing,
+// and the registry keeps every location right across pages while entities are destroyed, recycled and moved between
+// archetypes.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+    constexpr std::size_t count = 3 * ecs::entity_location_page_size + 100;
+
+    struct position {
+        std::size_t index;
+    };
+
+    struct velocity {
+        std::size_t index;
+    };
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    void paged_table() {
+        ecs::detail::paged_table<int, 16> table;
+        check(!table.contains(0) && table.page_count() == 0, "new table has no pages");
+
+        auto& first = table.ensure(3);
+        first = 42;
+        check(table.contains(0) && table.contains(15) && !table.contains(16), "ensure allocates the page of the key");
+        check(table[4] == 0, "values of a new page are default constructed");
+
+        table.ensure(16 * 100 + 1) = 7;
+        check(table.page_count() == 2, "pages between written keys stay unallocated");
+        check(!table.contains(16 * 50), "key on an unallocated page is not contained");
+        check(&first == &table[3] && first == 42, "references stay valid while the table grows");
+        check(table[16 * 100 + 1] == 7, "value on a later page");
+
+        table.clear();
+        check(table.page_count() == 0 && !table.contains(3), "clear releases all pages");
+    }
+
+    void registry_locations() {
+        ecs::registry registry;
+        std::vector<ecs::entity> entities;
+        for (std::size_t i = 0; i < count; i++) {
+            entities.push_back(registry.create<position>({ i }));
+        }
+
+        // entities spread over pages, destroying and moving some patches the locations of swapped entities
+        std::mt19937 random{ 42 };
+        std::vector<bool> alive(count, true);
+        for (std::size_t i = 0; i < count / 3; i++) {
+            const auto index = random() % count;
+            if (alive[index]) {
+                registry.destroy(entities[index]);
+                alive[index] = false;
+            }
+        }
+        for (std::size_t i = 0; i < count; i += 5) {
+            if (alive[i]) {
+                registry.set<velocity>(entities[i], velocity{ i });
+            }
+        }
+
+        // recycled IDs reuse slots on existing pages
+        std::vector<ecs::entity> recycled;
+        for (std::size_t i = 0; i < 1000; i++) {
+            recycled.push_back(registry.create<position, velocity>({ count + i }, { count + i }));
+        }
+
+        bool same = true;
+        for (std::size_t i = 0; i < count; i++) {
+            same = same && registry.alive(entities[i]) == alive[i];
+            if (alive[i]) {
+                same = same && registry.get<position>(entities[i]).index == i;
+                same = same && registry.has<velocity>(entities[i]) == (i % 5 == 0);
+            }
+        }
+        check(same, "every live entity finds its components");
+
+        same = true;
+        for (std::size_t i = 0; i < recycled.size(); i++) {
+            same = same && recycled[i].id() < count && registry.get<position>(recycled[i]).index == count + i;
+            same = same && registry.get<velocity>(recycled[i]).index == count + i;
+        }
+        check(same, "recycled entities find their components");
+
+        for (std::size_t i = 0; i < count; i += 5) {
+            if (alive[i]) {
+                registry.remove<velocity>(entities[i]);
+            }
+        }
+        same = true;
+        for (std::size_t i = 0; i < count; i++) {
+            if (alive[i]) {
+                same = same && registry.get<position>(entities[i]).index == i && !registry.has<velocity>(entities[i]);
+            }
+        }
+        check(same, "entities moved back find their components");
+    }
+
+}
+
+int main() {
+    paged_table();
+    registry_locations();
+
+    if (failures == 0) {
+        std::printf("entity_location_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
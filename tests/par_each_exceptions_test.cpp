@@ -0,0 +1,97 @@
+// Checks that an exception thrown by a par_each callback is rethrown on the calling thread, for the work stealing
+// scheduler and for BS::thread_pool, and that the scheduler stays usable afterwards.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+#include <nvkg/Utils/task_scheduler.hpp>
+#include <nvkg/Utils/threadpool.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    struct value {
+        std::size_t v;
+    };
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    template<typename Pool>
+    void throwing_par_each_rethrows(Pool& pool, const ecs::registry& registry, std::size_t throw_at) {
+        bool caught = false;
+        try {
+            registry.par_each(pool, [throw_at](const value& v) {
+                if (v.v == throw_at) {
+                    throw std::runtime_error("value " + std::to_string(v.v));
+                }
+            }, 1);
+        } catch (const std::runtime_error& e) {
+            caught = std::string(e.what()) == "value " + std::to_string(throw_at);
+        }
+        check(caught, "par_each rethrows the exception of the callback on the caller");
+    }
+
+}
+
+int main() {
+    constexpr std::size_t count = 200000;
+
+    ecs::registry registry;
+    for (std::size_t i = 0; i < count; i++) {
+        registry.create<value>({i});
+    }
+
+    nvkg::task_scheduler scheduler(4);
+    BS::thread_pool pool(4);
+
+    for (int run = 0; run < 20; run++) {
+        // first entity, one in the middle and the last one, so the throwing block runs on the caller and on workers
+        for (std::size_t throw_at : {std::size_t{0}, count / 2, count - 1}) {
+            throwing_par_each_rethrows(scheduler, registry, throw_at);
+            throwing_par_each_rethrows(pool, registry, throw_at);
+        }
+    }
+
+    // every block throws
+    bool caught = false;
+    try {
+        registry.par_each(scheduler, [](const value&) { throw std::logic_error("all"); }, 1);
+    } catch (const std::logic_error&) {
+        caught = true;
+    }
+    check(caught, "par_each rethrows when every block throws");
+
+    std::atomic<std::size_t> visited{0};
+    registry.par_each(scheduler, [&visited](const value&) { visited.fetch_add(1, std::memory_order_relaxed); }, 1);
+    check(visited.load() == count, "scheduler visits every entity after an exception");
+
+    caught = false;
+    try {
+        nvkg::task_scheduler::task_group group(scheduler);
+        for (int i = 0; i < 64; i++) {
+            group.run([i] {
+                if (i == 31) throw std::runtime_error("task");
+            });
+        }
+        group.wait();
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    check(caught, "task_group::wait rethrows the exception of a task");
+
+    if (failures == 0) {
+        std::printf("par_each_exceptions_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+// Checks that a snapshot round trip restores trivially copyable components, components with serializer hooks, sparse
+// components and entity handles, and that truncated or corrupt data makes loading throw snapshot_error.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace {
+
+    struct position {
+        float x, y, z;
+    };
+
+    struct name {
+        std::string value;
+    };
+
+    struct selected {
+        int order;
+    };
+
+    struct label {
+        std::string value;
+    };
+
+}
+
+template<>
+struct ecs::serializer<name> {
+    static void save(ecs::snapshot_writer& writer, const name& value) {
+        writer.write_string(value.value);
+    }
+
+    static auto load(ecs::snapshot_reader& reader) -> name {
+        return name{ reader.read_string() };
+    }
+};
+
+template<>
+struct ecs::serializer<label> {
+    static void save(ecs::snapshot_writer& writer, const label& value) {
+        writer.write_string(value.value);
+    }
+
+    static auto load(ecs::snapshot_reader& reader) -> label {
+        return label{ reader.read_string() };
+    }
+};
+
+template<>
+struct ecs::component_storage<selected> : std::integral_constant<ecs::storage_policy, ecs::storage_policy::sparse> {};
+
+template<>
+struct ecs::component_storage<label> : std::integral_constant<ecs::storage_policy, ecs::storage_policy::sparse> {};
+
+namespace {
+
+    constexpr std::size_t count = 3000;
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    auto make_snapshot() -> ecs::snapshot {
+        ecs::snapshot snapshot;
+        snapshot.register_components<position, name, selected, label>();
+        return snapshot;
+    }
+
+    auto throws_snapshot_error(const ecs::snapshot& snapshot, std::span<const std::byte> bytes) -> bool {
+        try {
+            [[maybe_unused]] auto loaded = snapshot.load(bytes);
+        } catch (const ecs::snapshot_error&) {
+            return true;
+        }
+        return false;
+    }
+
+    // Replace the first occurrence of the handles pattern by replacement, returns false if pattern was not found
+    auto replace(std::vector<std::byte>& bytes, std::span<const ecs::entity> pattern, std::span<const ecs::entity> replacement) -> bool {
+        const auto from = std::as_bytes(pattern);
+        const auto iter = std::search(bytes.begin(), bytes.end(), from.begin(), from.end());
+        if (iter == bytes.end()) {
+            return false;
+        }
+        std::memcpy(&*iter, replacement.data(), replacement.size_bytes());
+        return true;
+    }
+
+    void round_trip() {
+        ecs::registry registry;
+        std::vector<ecs::entity> entities;
+        for (std::size_t i = 0; i < count; i++) {
+            const auto f = static_cast<float>(i);
+            if (i % 3 == 0) {
+                entities.push_back(registry.create<position>({ f, f + 1, f + 2 }));
+            } else {
+                entities.push_back(registry.create<position, name>({ f, f + 1, f + 2 }, { "entity " + std::to_string(i) }));
+            }
+            if (i % 7 == 0) {
+                registry.set<selected>(entities.back(), static_cast<int>(i));
+            }
+            if (i % 11 == 0) {
+                registry.set<label>(entities.back(), "label " + std::to_string(i));
+            }
+        }
+        // recycled IDs and stale handles have to survive the round trip
+        for (std::size_t i = 0; i < count; i += 5) {
+            registry.destroy(entities[i]);
+        }
+
+        const auto snapshot = make_snapshot();
+        const auto bytes = snapshot.save(registry);
+        auto loaded = snapshot.load(bytes);
+
+        bool same = true;
+        for (std::size_t i = 0; i < count; i++) {
+            const auto ent = entities[i];
+            if (i % 5 == 0) {
+                same = same && !loaded.alive(ent);
+                continue;
+            }
+            const auto f = static_cast<float>(i);
+            const auto& p = loaded.get<position>(ent);
+            same = same && loaded.alive(ent) && p.x == f && p.y == f + 1 && p.z == f + 2;
+            same = same && loaded.has<name>(ent) == (i % 3 != 0);
+            if (i % 3 != 0) {
+                same = same && loaded.get<name>(ent).value == "entity " + std::to_string(i);
+            }
+            same = same && loaded.has<selected>(ent) == (i % 7 == 0);
+            if (i % 7 == 0) {
+                same = same && loaded.get<selected>(ent).order == static_cast<int>(i);
+            }
+            same = same && loaded.has<label>(ent) == (i % 11 == 0);
+            if (i % 11 == 0) {
+                same = same && loaded.get<label>(ent).value == "label " + std::to_string(i);
+            }
+        }
+        check(same, "round trip restores components, sparse components and dead handles");
+        check(snapshot.save(loaded) == bytes, "saving a loaded registry gives the same bytes");
+
+        const auto created = loaded.create<position>({ 0, 0, 0 });
+        check(created.id() == entities[count - 5].id(), "loaded registry recycles IDs in the same order");
+    }
+
+    void truncated_and_corrupt_data() {
+        ecs::registry registry;
+        std::vector<ecs::entity> entities;
+        for (std::size_t i = 0; i < count; i++) {
+            entities.push_back(registry.create<position, name>({ 1, 2, 3 }, { "n" }));
+            if (i % 2 == 0) {
+                registry.set<selected>(entities.back(), 1);
+            }
+        }
+
+        const auto snapshot = make_snapshot();
+        const auto bytes = snapshot.save(registry);
+
+        bool all_throw = true;
+        for (std::size_t size = 0; size < bytes.size(); size += 1 + size / 64) {
+            all_throw = all_throw && throws_snapshot_error(snapshot, std::span(bytes).first(size));
+        }
+        check(all_throw, "truncated data throws snapshot_error");
+
+        auto corrupt = bytes;
+        corrupt[0] ^= std::byte{ 0xff };
+        check(throws_snapshot_error(snapshot, corrupt), "wrong magic throws snapshot_error");
+
+        ecs::snapshot unregistered;
+        unregistered.register_components<position>();
+        check(throws_snapshot_error(unregistered, bytes), "unregistered component throws snapshot_error");
+
+        // archetype entity column lists entities[100] twice
+        corrupt = bytes;
+        const std::array<ecs::entity, 2> pair{ entities[100], entities[101] };
+        const std::array<ecs::entity, 2> twice{ entities[100], entities[100] };
+        check(replace(corrupt, pair, twice), "entity column found");
+        check(throws_snapshot_error(snapshot, corrupt), "an entity listed twice in archetypes throws snapshot_error");
+
+        // sparse entity column lists entities[100] twice, archetype columns stay intact
+        corrupt = bytes;
+        const std::array<ecs::entity, 2> sparse_pair{ entities[100], entities[102] };
+        check(replace(corrupt, sparse_pair, twice), "sparse entity column found");
+        check(throws_snapshot_error(snapshot, corrupt), "an entity listed twice in a sparse storage throws snapshot_error");
+    }
+
+}
+
+int main() {
+    round_trip();
+    truncated_and_corrupt_data();
+
+    if (failures == 0) {
+        std::printf("snapshot_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
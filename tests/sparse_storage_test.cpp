@@ -0,0 +1,174 @@
+// Checks sparse components: setting and removing them while iterating an archetype view keeps entities in place, views
+// mixing dense and sparse components match exactly the entities holding both, par_each over such a view visits each of
+// them once, a throwing constructor leaves the storage unchanged and destroy erases an entity from every storage.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+#include <nvkg/Utils/task_scheduler.hpp>
+
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    constexpr std::size_t count = 20000;
+
+    struct position {
+        int x;
+    };
+
+    struct selected {
+        int order;
+    };
+
+    struct hovered {
+        int order;
+    };
+
+    struct throwing {
+        explicit throwing(int value) : value(value) {
+            if (value < 0) {
+                throw std::runtime_error("negative value");
+            }
+        }
+
+        int value;
+    };
+
+}
+
+template<>
+struct ecs::component_storage<selected> : std::integral_constant<ecs::storage_policy, ecs::storage_policy::sparse> {};
+
+template<>
+struct ecs::component_storage<hovered> : std::integral_constant<ecs::storage_policy, ecs::storage_policy::sparse> {};
+
+template<>
+struct ecs::component_storage<throwing> : std::integral_constant<ecs::storage_policy, ecs::storage_policy::sparse> {};
+
+namespace {
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    auto create_entities(ecs::registry& registry) -> std::vector<ecs::entity> {
+        std::vector<ecs::entity> entities;
+        for (std::size_t i = 0; i < count; i++) {
+            entities.push_back(registry.create<position>({ static_cast<int>(i) }));
+        }
+        return entities;
+    }
+
+    void toggle_during_iteration() {
+        ecs::registry registry;
+        const auto entities = create_entities(registry);
+        for (std::size_t i = 0; i < count; i += 2) {
+            registry.set<selected>(entities[i], static_cast<int>(i));
+        }
+
+        // sparse components never move rows, so toggling them is fine while iterating the archetype
+        std::size_t visited = 0;
+        registry.each([&](const ecs::entity& ent, const position& p) {
+            visited++;
+            if (p.x % 3 == 0) {
+                registry.set<hovered>(ent, p.x);
+            }
+            if (p.x % 4 == 0) {
+                registry.remove<selected>(ent);
+            }
+        });
+        check(visited == count, "toggling sparse components during iteration visits every entity once");
+
+        bool same = true;
+        std::size_t both = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            const bool is_selected = i % 2 == 0 && i % 4 != 0;
+            const bool is_hovered = i % 3 == 0;
+            same = same && registry.get<position>(entities[i]).x == static_cast<int>(i);
+            same = same && registry.has<selected>(entities[i]) == is_selected;
+            same = same && registry.has<hovered>(entities[i]) == is_hovered;
+            if (is_selected) {
+                same = same && registry.get<selected>(entities[i]).order == static_cast<int>(i);
+            }
+            both += is_selected && is_hovered;
+        }
+        check(same, "sparse components match what was set and removed");
+
+        std::size_t matched = 0;
+        registry.each([&](const position& p, const selected& s, const hovered& h) {
+            matched++;
+            same = same && s.order == p.x && h.order == p.x;
+        });
+        check(same && matched == both, "view over dense and sparse components matches entities holding all of them");
+        check(registry.view<const selected&, const hovered&>().count() == both, "count() of a sparse view");
+    }
+
+    void sparse_par_each() {
+        ecs::registry registry;
+        const auto entities = create_entities(registry);
+        for (std::size_t i = 0; i < count; i += 3) {
+            registry.set<selected>(entities[i], static_cast<int>(i));
+        }
+
+        nvkg::task_scheduler scheduler(4);
+        registry.view<position&, const selected&>().par_each(
+            scheduler, ecs::parallel_safe([](position& p, const selected& s) { p.x += s.order; }), 16);
+
+        bool same = true;
+        for (std::size_t i = 0; i < count; i++) {
+            const auto expected = static_cast<int>(i % 3 == 0 ? 2 * i : i);
+            same = same && registry.get<position>(entities[i]).x == expected;
+        }
+        check(same, "par_each over a sparse view visits every member once");
+    }
+
+    void throwing_set_and_destroy() {
+        ecs::registry registry;
+        const auto entities = create_entities(registry);
+        registry.set<throwing>(entities[0], 1);
+        registry.set<selected>(entities[0], 0);
+        registry.set<selected>(entities[1], 1);
+
+        bool caught = false;
+        try {
+            registry.set<throwing>(entities[5], -1);
+        } catch (const std::runtime_error&) {
+            caught = true;
+        }
+        check(caught, "set rethrows the exception of the constructor");
+        check(!registry.has<throwing>(entities[5]), "throwing set does not add the component");
+        check(registry.view<const throwing&>().count() == 1, "throwing set leaves the storage unchanged");
+        check(registry.get<throwing>(entities[0]).value == 1, "throwing set keeps other members");
+
+        registry.destroy(entities[0]);
+        check(registry.view<const throwing&>().count() == 0, "destroy erases the entity from every storage");
+        check(registry.view<const throwing&>().empty() && !registry.view<const selected&>().empty(), "sparse view::empty()");
+        check(registry.view<const selected&>().count() == 1, "destroy keeps other members");
+        check(registry.get<selected>(entities[1]).order == 1, "destroy keeps components of other members");
+
+        // the recycled ID must not inherit sparse components
+        const auto recycled = registry.create<position>({ 0 });
+        check(recycled.id() == entities[0].id(), "destroyed ID is recycled");
+        check(!registry.has<selected>(recycled) && !registry.has<throwing>(recycled), "recycled ID has no sparse components");
+    }
+
+}
+
+int main() {
+    toggle_during_iteration();
+    sparse_par_each();
+    throwing_set_and_destroy();
+
+    if (failures == 0) {
+        std::printf("sparse_storage_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+// Checks the system scheduler: dependencies and levels follow read/write conflicts in the order systems were added,
+// conflicting systems observe each other's writes in that order when run on a thread pool, and adding a system
+// rebuilds the graph.
+//
+// Build and run with `make tests`.
+
+#include <nvkg/ecs/ecs.hpp>
+#include <nvkg/Utils/task_scheduler.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+    constexpr std::size_t count = 20000;
+
+    struct position {
+        float x;
+    };
+
+    struct velocity {
+        float x;
+    };
+
+    struct health {
+        int value;
+    };
+
+    struct mass {
+        float value;
+    };
+
+    int failures = 0;
+
+    void check(bool condition, const char* what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    using levels_t = std::vector<std::vector<std::size_t>>;
+    using dependencies_t = std::vector<std::size_t>;
+
+    void levels_and_order() {
+        ecs::registry registry;
+        for (std::size_t i = 0; i < count; i++) {
+            registry.create<position, velocity, health>({ 0 }, { 1 }, { 1 });
+        }
+        // entities the readers of health skip
+        for (std::size_t i = 0; i < count / 2; i++) {
+            registry.create<position, velocity>({ 0 }, { 1 });
+        }
+
+        std::atomic<std::size_t> healthy{ 0 };
+        ecs::system_scheduler systems;
+        systems.add("accelerate", [](velocity& v) { v.x += 1; });
+        systems.add("count", [&healthy](const health& h) { healthy.fetch_add(h.value > 0, std::memory_order_relaxed); });
+        systems.add("integrate", [](position& p, const velocity& v) { p.x += v.x; });
+        systems.add("damp", [](velocity& v) { v.x -= 1; });
+        systems.add("scale", [](position& p) { p.x *= 10; });
+        systems.add("heal", [](health& h) { h.value += 1; });
+
+        check(systems.size() == 6 && systems.name(2) == "integrate", "systems keep their names in order");
+        check(systems.levels() == levels_t{ { 0, 1 }, { 2, 5 }, { 3, 4 } }, "levels group non-conflicting systems");
+        check(systems.dependencies(0).empty() && systems.dependencies(1).empty(), "first level has no dependencies");
+        check(systems.dependencies(2) == dependencies_t{ 0 }, "reader of a written component depends on the writer");
+        check(systems.dependencies(3) == dependencies_t{ 0, 2 }, "writer depends on earlier writers and readers");
+        check(systems.dependencies(4) == dependencies_t{ 2 }, "writers of the same component conflict");
+        check(systems.dependencies(5) == dependencies_t{ 1 }, "writer after a reader depends on the reader");
+
+        nvkg::task_scheduler scheduler(4);
+        constexpr int frames = 5;
+        float expected = 0;
+        for (int frame = 0; frame < frames; frame++) {
+            systems.run(registry, scheduler);
+            // accelerate, integrate, damp, then scale, in the order they were added
+            expected = (expected + 2) * 10;
+        }
+
+        bool same = true;
+        std::size_t visited = 0;
+        registry.each([&](const position& p, const velocity& v) {
+            visited++;
+            same = same && p.x == expected && v.x == 1;
+        });
+        check(same && visited == count + count / 2, "conflicting systems run in the order they were added");
+        check(healthy.load() == count * frames, "readers run once per frame");
+        registry.each([&](const health& h) { same = same && h.value == 1 + frames; });
+        check(same, "writers run once per frame");
+
+        // a system added later joins the graph on the next run
+        systems.add("reset", [](const velocity&, health& h) { h.value = 0; });
+        check(systems.dependencies(6) == dependencies_t{ 0, 1, 3, 5 }, "added system depends on conflicting systems");
+        check(systems.levels().size() == 4 && systems.levels().back() == dependencies_t{ 6 }, "added system gets a level");
+        systems.run(registry, scheduler);
+        registry.each([&](const health& h) { same = same && h.value == 0; });
+        check(same, "added system runs");
+
+        // systems without matching entities are skipped
+        std::size_t weighed = 0;
+        systems.add("weigh", [&weighed](const mass&) { weighed++; });
+        check(registry.view<const mass&>().empty() && !registry.view<const health&>().empty(), "view::empty()");
+        systems.run(registry, scheduler);
+        check(weighed == 0, "system without matching entities does not run");
+        const auto heavy = registry.create<mass>({ 1 });
+        systems.run(registry, scheduler);
+        check(weighed == 1 && !registry.view<const mass&>().empty(), "system runs once entities match");
+        registry.destroy(heavy);
+        check(registry.view<const mass&>().empty(), "view::empty() skips empty chunks");
+    }
+
+}
+
+int main() {
+    levels_and_order();
+
+    if (failures == 0) {
+        std::printf("system_scheduler_test: passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}